@@ -0,0 +1,524 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file bench_convergence.c
+ ** @brief Simulación de redes completas para medir la convergencia de la capa routing. Cada nodo
+ *         tiene su propio contexto de routing y la capa conn se reemplaza por una red simulada que
+ *         entrega los anuncios a los vecinos en el paso siguiente del handler. Para topologías en
+ *         línea, grilla, geométrica aleatoria y por clusters mide los pasos del handler, los msg de
+ *         control y los bytes necesarios para converger desde el arranque, luego de la caída de un
+ *         enlace, luego de la caída de un nodo y luego del reinicio de un nodo, con la tabla vacía
+ *         y restaurando una copia guardada antes del reinicio, con el modo periódico y con el
+ *         adaptativo. Los resultados se escriben en formato JSON por la salida estándar. Se compila
+ *         con `make bench`.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh.h"
+#include "mesh_app.h"
+#include "mesh_conn.h"
+#include "mesh_msg.h"
+#include "mesh_port.h"
+#include "mesh_routing.h"
+#include "math.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+/* === Macros definitions ====================================================================== */
+
+#define SIM_MAX_NODES  250  // nodos por red, las direcciones unicast son de 8 bits
+#define SIM_MAX_TICKS  4000 // pasos del handler antes de dar la red por no convergida
+#define SIM_OUTBOX_MAX (SIM_MAX_NODES * 64) // anuncios enviados en un mismo paso
+#define SIM_NO_DIST    0xFFFF               // nodo inalcanzable
+#define SIM_SEED       0x2545F491u          // semilla por defecto del generador de topologías
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Nodo simulado
+ *
+ */
+struct sim_node {
+  /** @brief Contexto de routing del nodo */
+  struct mesh_routing_ctx ctx;
+  /** @brief Arena de la tabla de rutas */
+  uint32_t arena[MESH_ROUTING_ARENA_SIZE(MESH_ROUTING_MAX_CAPACITY) / sizeof(uint32_t) + 1];
+  /** @brief false si el nodo se cayó */
+  bool alive;
+  /** @brief Cantidad de vecinos */
+  uint8_t degree;
+  /** @brief Vecinos con enlace activo */
+  uint8_t neighbors[SIM_MAX_NODES];
+};
+
+/**
+ * @brief Msg enviado por un nodo, pendiente de entrega a sus vecinos
+ *
+ */
+struct sim_frame {
+  uint8_t src;
+  uint8_t msg[MSG + MAX_SIZE_MSG];
+};
+
+/**
+ * @brief Costo de converger luego de un evento
+ *
+ */
+struct sim_result {
+  bool converged;
+  uint32_t ticks;
+  uint32_t msgs;
+  uint32_t bytes;
+};
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+static struct sim_node nodes[SIM_MAX_NODES];
+
+static uint16_t node_count = 0;
+
+static uint8_t current = 0; // nodo que está ejecutando el handler
+
+static struct sim_frame outbox[SIM_OUTBOX_MAX];
+
+static uint32_t outbox_count = 0;
+
+static uint32_t sent_msgs = 0;
+
+static uint32_t sent_bytes = 0;
+
+static uint16_t dist[SIM_MAX_NODES][SIM_MAX_NODES];
+
+static uint32_t rand_state = SIM_SEED;
+
+static bool first_result = true;
+
+static uint8_t snapshot[MESH_ROUTING_SNAPSHOT_MAX_SIZE(MESH_ROUTING_MAX_CAPACITY)];
+
+/* === Private function implementation ========================================================= */
+
+static uint32_t sim_rand() {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static double sim_rand_unit() {
+  return (sim_rand() & 0xFFFFFF) / (double)0x1000000;
+}
+
+static bool sim_linked(uint8_t a, uint8_t b) {
+  for (uint8_t i = 0; i < nodes[a].degree; i++) {
+    if (nodes[a].neighbors[i] == b) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void sim_link(uint8_t a, uint8_t b) {
+  if (a != b && !sim_linked(a, b)) {
+    nodes[a].neighbors[nodes[a].degree++] = b;
+    nodes[b].neighbors[nodes[b].degree++] = a;
+  }
+}
+
+static void sim_unlink_one(uint8_t a, uint8_t b) {
+  for (uint8_t i = 0; i < nodes[a].degree; i++) {
+    if (nodes[a].neighbors[i] == b) {
+      nodes[a].neighbors[i] = nodes[a].neighbors[--nodes[a].degree];
+      return;
+    }
+  }
+}
+
+static void sim_unlink(uint8_t a, uint8_t b) {
+  sim_unlink_one(a, b);
+  sim_unlink_one(b, a);
+}
+
+/**
+ * @brief Borra la red y deja count nodos sin enlaces
+ *
+ */
+static void sim_reset(uint16_t count) {
+  node_count = count;
+  for (uint16_t i = 0; i < count; i++) {
+    nodes[i].alive = true;
+    nodes[i].degree = 0;
+  }
+}
+
+/**
+ * @brief Calcula por BFS las distancias en saltos entre los nodos activos
+ *
+ */
+static void sim_compute_dist() {
+  uint8_t queue[SIM_MAX_NODES];
+
+  for (uint16_t src = 0; src < node_count; src++) {
+    for (uint16_t i = 0; i < node_count; i++) {
+      dist[src][i] = SIM_NO_DIST;
+    }
+    if (!nodes[src].alive) {
+      continue;
+    }
+    uint16_t head = 0, tail = 0;
+    dist[src][src] = 0;
+    queue[tail++] = src;
+    while (head < tail) {
+      uint8_t n = queue[head++];
+      for (uint8_t i = 0; i < nodes[n].degree; i++) {
+        uint8_t v = nodes[n].neighbors[i];
+        if (nodes[v].alive && dist[src][v] == SIM_NO_DIST) {
+          dist[src][v] = dist[src][n] + 1;
+          queue[tail++] = v;
+        }
+      }
+    }
+  }
+}
+
+static bool sim_connected() {
+  sim_compute_dist();
+  for (uint16_t i = 0; i < node_count; i++) {
+    if (dist[0][i] == SIM_NO_DIST) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief La red convergió si cada nodo activo tiene ruta de métrica mínima hacia cada nodo
+ * alcanzable, a través de un vecino que está más cerca del destino, y no tiene ruta hacia el resto
+ *
+ */
+static bool sim_converged() {
+  for (uint16_t a = 0; a < node_count; a++) {
+    if (!nodes[a].alive) {
+      continue;
+    }
+    for (uint16_t b = 0; b < node_count; b++) {
+      uint8_t next_hop, metric;
+      bool route = mesh_routing_get_route(&nodes[a].ctx, b, &next_hop, &metric);
+      if (dist[a][b] == SIM_NO_DIST) {
+        if (route) {
+          return false;
+        }
+      } else if (!route || metric != dist[a][b] ||
+                 (a != b && (!sim_linked(a, next_hop) || dist[next_hop][b] + 1 != dist[a][b]))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Un paso del handler en todos los nodos activos y entrega de lo enviado a los vecinos
+ *
+ */
+static void sim_tick() {
+  for (uint16_t n = 0; n < node_count; n++) {
+    if (nodes[n].alive) {
+      current = n;
+      mesh_routing_handler_time_out(&nodes[n].ctx);
+    }
+  }
+
+  for (uint32_t i = 0; i < outbox_count; i++) {
+    struct sim_frame * frame = &outbox[i];
+    for (uint8_t j = 0; j < nodes[frame->src].degree; j++) {
+      uint8_t v = nodes[frame->src].neighbors[j];
+      if (nodes[v].alive) {
+        uint8_t msg[MSG + MAX_SIZE_MSG];
+        memcpy(msg, frame->msg, sizeof(msg));
+        sent_msgs++;
+        sent_bytes = sent_bytes + MSG + msg[LENGHT];
+        current = v;
+        mesh_routing_send_msg(&nodes[v].ctx, msg);
+      }
+    }
+  }
+  outbox_count = 0;
+}
+
+/**
+ * @brief Ejecuta pasos hasta que la red converge o se llega a SIM_MAX_TICKS
+ *
+ */
+static struct sim_result sim_run() {
+  struct sim_result result = {false, 0, 0, 0};
+
+  sim_compute_dist();
+  sent_msgs = 0;
+  sent_bytes = 0;
+  while (result.ticks < SIM_MAX_TICKS) {
+    sim_tick();
+    result.ticks++;
+    if (sim_converged()) {
+      result.converged = true;
+      break;
+    }
+  }
+  result.msgs = sent_msgs;
+  result.bytes = sent_bytes;
+  return result;
+}
+
+static void sim_topology_line(uint16_t count) {
+  sim_reset(count);
+  for (uint16_t i = 1; i < count; i++) {
+    sim_link(i - 1, i);
+  }
+}
+
+static void sim_topology_grid(uint16_t width, uint16_t height) {
+  sim_reset(width * height);
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      if (x > 0) {
+        sim_link(y * width + x - 1, y * width + x);
+      }
+      if (y > 0) {
+        sim_link((y - 1) * width + x, y * width + x);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Nodos ubicados al azar en un cuadrado unitario, enlazados si están a menos de un radio
+ * elegido para un grado medio cercano a 6. Si la red no queda conexa se agranda el radio.
+ *
+ */
+static void sim_topology_geometric(uint16_t count) {
+  double x[SIM_MAX_NODES], y[SIM_MAX_NODES];
+  double radius = sqrt(6.0 / (M_PI * count));
+
+  for (uint16_t i = 0; i < count; i++) {
+    x[i] = sim_rand_unit();
+    y[i] = sim_rand_unit();
+  }
+  do {
+    sim_reset(count);
+    for (uint16_t i = 0; i < count; i++) {
+      for (uint16_t j = i + 1; j < count; j++) {
+        if (hypot(x[i] - x[j], y[i] - y[j]) < radius) {
+          sim_link(i, j);
+        }
+      }
+    }
+    radius = radius * 1.1;
+  } while (!sim_connected());
+}
+
+/**
+ * @brief Grupos densos de nodos unidos en anillo por un único enlace entre grupos consecutivos
+ *
+ */
+static void sim_topology_clustered(uint16_t clusters, uint16_t size) {
+  sim_reset(clusters * size);
+  for (uint16_t c = 0; c < clusters; c++) {
+    uint16_t base = c * size;
+    for (uint16_t i = 0; i < size; i++) {
+      sim_link(base + i, base + (i + 1) % size);
+      for (uint16_t j = i + 2; j < size; j++) {
+        if (sim_rand() % 10 < 2) {
+          sim_link(base + i, base + j);
+        }
+      }
+    }
+    uint16_t next = ((c + 1) % clusters) * size;
+    sim_link(base + sim_rand() % size, next + sim_rand() % size);
+  }
+}
+
+static void sim_print_result(const char * topology, const char * mode, const char * event,
+                             struct sim_result result) {
+  uint16_t links = 0;
+  uint8_t max_degree = 0;
+
+  for (uint16_t i = 0; i < node_count; i++) {
+    links = links + nodes[i].degree;
+    if (nodes[i].degree > max_degree) {
+      max_degree = nodes[i].degree;
+    }
+  }
+  printf("%s\n  {\"topology\": \"%s\", \"nodes\": %u, \"links\": %u, \"max_degree\": %u, "
+         "\"mode\": \"%s\", \"event\": \"%s\", \"converged\": %s, \"ticks\": %u, "
+         "\"msgs\": %u, \"bytes\": %u}",
+         first_result ? "" : ",", topology, node_count, links / 2, max_degree, mode, event,
+         result.converged ? "true" : "false", result.ticks, result.msgs, result.bytes);
+  first_result = false;
+  fflush(stdout);
+}
+
+static int sim_snapshot_write(void * user, uint16_t offset, const uint8_t * data, uint16_t len) {
+  (void)user;
+  if (offset + len > sizeof(snapshot)) {
+    return -1;
+  }
+  memcpy(&snapshot[offset], data, len);
+  return 0;
+}
+
+static int sim_snapshot_read(void * user, uint16_t offset, uint8_t * data, uint16_t len) {
+  (void)user;
+  if (offset + len > sizeof(snapshot)) {
+    return -1;
+  }
+  memcpy(data, &snapshot[offset], len);
+  return 0;
+}
+
+/**
+ * @brief Reinicia un nodo, que vuelve con la tabla vacía o con la copia guardada antes del reinicio
+ *
+ */
+static void sim_reboot(uint8_t n, bool trickle, bool warm) {
+  const struct mesh_routing_storage storage = {sim_snapshot_write, sim_snapshot_read, NULL};
+
+  if (warm && mesh_routing_snapshot_save(&nodes[n].ctx, &storage) != 0) {
+    fprintf(stderr, "No se pudo guardar la tabla del nodo %u\n", n);
+    exit(1);
+  }
+  mesh_routing_init(&nodes[n].ctx, n, MESH_ROUTING_MAX_CAPACITY, nodes[n].arena,
+                    sizeof(nodes[n].arena));
+  if (trickle) {
+    mesh_routing_set_trickle(&nodes[n].ctx, true);
+  }
+  if (warm && mesh_routing_snapshot_restore(&nodes[n].ctx, &storage) != 0) {
+    fprintf(stderr, "No se pudo restaurar la tabla del nodo %u\n", n);
+    exit(1);
+  }
+}
+
+/**
+ * @brief Arranca todos los nodos de la red generada, espera la convergencia y luego tira un
+ * enlace al azar y un nodo al azar y reinicia otro nodo al azar, primero con la tabla vacía y
+ * luego con la copia, esperando la convergencia después de cada evento
+ *
+ */
+static void sim_scenarios(const char * topology, bool trickle) {
+  const char * mode = trickle ? "trickle" : "periodic";
+
+  for (uint16_t i = 0; i < node_count; i++) {
+    if (mesh_routing_init(&nodes[i].ctx, i, MESH_ROUTING_MAX_CAPACITY, nodes[i].arena,
+                          sizeof(nodes[i].arena)) != 0) {
+      fprintf(stderr, "No se pudo inicializar el nodo %u\n", i);
+      exit(1);
+    }
+    if (trickle) {
+      mesh_routing_set_trickle(&nodes[i].ctx, true);
+    }
+  }
+  sim_print_result(topology, mode, "cold_start", sim_run());
+
+  uint8_t a;
+  do {
+    a = sim_rand() % node_count;
+  } while (nodes[a].degree == 0);
+  sim_unlink(a, nodes[a].neighbors[sim_rand() % nodes[a].degree]);
+  sim_print_result(topology, mode, "link_failure", sim_run());
+
+  nodes[sim_rand() % node_count].alive = false;
+  sim_print_result(topology, mode, "node_failure", sim_run());
+
+  do {
+    a = sim_rand() % node_count;
+  } while (!nodes[a].alive);
+  sim_reboot(a, trickle, false);
+  sim_print_result(topology, mode, "cold_reboot", sim_run());
+  sim_reboot(a, trickle, true);
+  sim_print_result(topology, mode, "warm_reboot", sim_run());
+}
+
+/* === Public function implementation ========================================================== */
+
+void mesh_conn_send_msg(uint8_t id_mesh, uint8_t * msg) {
+  (void)id_mesh;
+  if (outbox_count < SIM_OUTBOX_MAX) {
+    outbox[outbox_count].src = current;
+    memcpy(outbox[outbox_count].msg, msg, MSG + msg[LENGHT]);
+    outbox_count++;
+  }
+}
+
+void mesh_conn_send_msgs(uint8_t ** msgs, uint8_t count) {
+  (void)msgs;
+  (void)count;
+}
+
+void mesh_app_process_msg(uint8_t * data) {
+  (void)data;
+}
+
+void mesh_print(uint8_t * msg) {
+  (void)msg;
+}
+
+void mesh_port_routing_lock() {
+}
+
+void mesh_port_routing_unlock() {
+}
+
+uint32_t mesh_port_cycles() {
+  return 0;
+}
+
+int main(int argc, char * argv[]) {
+  uint32_t seed = SIM_SEED;
+
+  if (argc > 1) {
+    seed = strtoul(argv[1], NULL, 0) | 1;
+  }
+  mesh_msg_init();
+
+  printf("[");
+  for (int trickle = 0; trickle < 2; trickle++) {
+    rand_state = seed; // las mismas redes y fallas en los dos modos
+    sim_topology_line(100);
+    sim_scenarios("line", trickle);
+    sim_topology_grid(15, 15);
+    sim_scenarios("grid", trickle);
+    sim_topology_geometric(SIM_MAX_NODES);
+    sim_scenarios("geometric", trickle);
+    sim_topology_clustered(10, SIM_MAX_NODES / 10);
+    sim_scenarios("clustered", trickle);
+  }
+  printf("\n]\n");
+  return 0;
+}
+
+/* === End of documentation ==================================================================== */
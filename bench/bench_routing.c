@@ -0,0 +1,342 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file bench_routing.c
+ ** @brief Microbenchmarks de los caminos críticos de la capa routing. Mide ns por operación y msg
+ *         tomados del pool (más llamadas a malloc) por operación para tablas de distintos tamaños
+ *         y escribe los resultados en formato JSON por la salida estándar, para comparar entre
+ *         versiones antes de actualizar el firmware de los nodos. Se compila con `make bench`.
+ *         Incluye mesh_routing.c para poder medir las funciones privadas; las capas vecinas se
+ *         reemplazan por funciones vacías.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "../src/mesh_routing.c"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+
+/* === Macros definitions ====================================================================== */
+
+#define BENCH_NODE_ID     252 // id del nodo medido, fuera del rango de destinos de la tabla
+#define BENCH_NEIGHBORS   4   // vecinos por los que se aprenden las rutas
+#define BENCH_NEIGHBOR(k) (240 + (k) % BENCH_NEIGHBORS)
+#define BENCH_MIN_NS      100000000.0 // tiempo mínimo medido por benchmark
+#define BENCH_WARMUP      1000        // operaciones previas a la medición
+#define BENCH_FRAGMENT_ROUTES ((MAX_SIZE_MSG - ADV_HEADER_SIZE) / ADV_ROUTE_SIZE) // formato plano
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Descripción de un benchmark. Las operaciones se miden en tandas de batch operaciones;
+ * antes de cada tanda se llama a reset, fuera de la medición.
+ *
+ */
+struct bench {
+  const char * name;
+  void (*reset)(uint8_t entries);
+  void (*op)(uint8_t entries, uint32_t i);
+  uint32_t (*batch)(uint8_t entries);
+};
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+uint8_t * __real_mesh_msg_alloc();
+
+void * __real_malloc(size_t size);
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+static struct mesh_routing_ctx bench_ctx;
+
+static uint32_t
+    bench_arena[MESH_ROUTING_ARENA_SIZE(MESH_ROUTING_MAX_CAPACITY) / sizeof(uint32_t) + 1];
+
+static uint8_t bench_msg[MSG + MAX_SIZE_MSG];
+
+static unsigned long bench_allocs = 0;
+
+static volatile uint8_t bench_sink = 0;
+
+static bool bench_first_result = true;
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Arma en bench_msg un fragmento del anuncio de un vecino, en formato plano, con hasta
+ * BENCH_FRAGMENT_ROUTES rutas consecutivas a partir de first
+ *
+ * @param entries tamaño de la tabla; los destinos van de 0 a entries - 2
+ * @param first primera ruta del fragmento
+ * @param metric métrica anunciada
+ * @return uint8_t cantidad de rutas del fragmento
+ */
+static uint8_t bench_build_fragment(uint8_t entries, uint32_t first, uint8_t metric) {
+  uint8_t routes = 0;
+
+  bench_msg[SRC] = BENCH_NEIGHBOR(first);
+  bench_msg[DST] = BROADCAST_DIR;
+  bench_msg[NEXT_HOP] = BROADCAST_DIR;
+  bench_msg[OPCODE] = RCV_NEIGHBOR_OPCODE;
+  bench_msg[MSG + ADV_FORMAT] = ADV_FORMAT_PLAIN;
+  bench_msg[MSG + ADV_FRAGMENT_INDEX] = 0;
+  bench_msg[MSG + ADV_FRAGMENT_COUNT] = 1;
+
+  for (uint32_t dst = first; dst < first + BENCH_FRAGMENT_ROUTES && dst < entries - 1u;
+       dst++) {
+    uint8_t * route = &bench_msg[MSG + ADV_HEADER_SIZE + routes * ADV_ROUTE_SIZE];
+    route[0] = dst;
+    route[1] = BENCH_NEIGHBOR(dst);
+    route[2] = metric;
+    route[3] = 0; // número de secuencia del destino
+    routes++;
+  }
+  bench_msg[LENGHT] = ADV_HEADER_SIZE + routes * ADV_ROUTE_SIZE;
+  return routes;
+}
+
+/**
+ * @brief Inicializa el nodo con la tabla vacía
+ *
+ * @param entries capacidad de la tabla
+ */
+static void bench_reset_empty(uint8_t entries) {
+  if (mesh_routing_init(&bench_ctx, BENCH_NODE_ID, entries, bench_arena, sizeof(bench_arena)) !=
+      0) {
+    fprintf(stderr, "No se pudo inicializar la tabla de %u rutas\n", entries);
+    exit(1);
+  }
+}
+
+/**
+ * @brief Inicializa el nodo con la tabla llena y sin rutas pendientes de anunciar
+ *
+ * @param entries capacidad de la tabla
+ */
+static void bench_reset_full(uint8_t entries) {
+  bench_reset_empty(entries);
+  for (uint32_t first = 0; first < entries - 1u; first = first + BENCH_FRAGMENT_ROUTES) {
+    bench_build_fragment(entries, first, 3);
+    mesh_routing_send_msg(&bench_ctx, bench_msg);
+  }
+  mesh_routing_send_neighbor(&bench_ctx, true, false);
+}
+
+/**
+ * @brief Inicializa el nodo con la tabla llena y el registro de trazas activo
+ *
+ * @param entries capacidad de la tabla
+ */
+static void bench_reset_full_traced(uint8_t entries) {
+  bench_reset_full(entries);
+  mesh_routing_set_trace(&bench_ctx, true);
+}
+
+static uint32_t bench_batch_unlimited(uint8_t entries) {
+  (void)entries;
+  return UINT32_MAX;
+}
+
+static uint32_t bench_batch_fill(uint8_t entries) {
+  return (entries - 1u + BENCH_FRAGMENT_ROUTES - 1) / BENCH_FRAGMENT_ROUTES;
+}
+
+/**
+ * @brief Reenvío de un msg de aplicación hacia un destino de la tabla
+ *
+ */
+static void bench_op_forward(uint8_t entries, uint32_t i) {
+  bench_msg[SRC] = BENCH_NEIGHBOR(i);
+  bench_msg[DST] = i % (entries - 1u);
+  bench_msg[OPCODE] = OPCODE_APP_MIN;
+  bench_msg[LENGHT] = 1;
+  bench_msg[TTL] = MESH_ROUTING_DEFAULT_TTL;
+  mesh_routing_send_msg(&bench_ctx, bench_msg);
+}
+
+/**
+ * @brief Fragmento de anuncio con rutas nuevas; una tanda llena la tabla vacía
+ *
+ */
+static void bench_op_insert(uint8_t entries, uint32_t i) {
+  bench_build_fragment(entries, (i % bench_batch_fill(entries)) * BENCH_FRAGMENT_ROUTES, 3);
+  mesh_routing_send_msg(&bench_ctx, bench_msg);
+}
+
+/**
+ * @brief Fragmento de anuncio que cambia la métrica de rutas existentes
+ *
+ */
+static void bench_op_update(uint8_t entries, uint32_t i) {
+  uint32_t fragment = i % bench_batch_fill(entries);
+  uint8_t metric = 3 + (i / bench_batch_fill(entries)) % 2;
+  bench_build_fragment(entries, fragment * BENCH_FRAGMENT_ROUTES, metric);
+  mesh_routing_send_msg(&bench_ctx, bench_msg);
+}
+
+/**
+ * @brief Paso de time out en el que todas las rutas siguen vigentes: se refrescan con el anuncio de
+ * cada vecino y avanza la rueda de tiempos
+ *
+ */
+static void bench_op_aging(uint8_t entries, uint32_t i) {
+  (void)entries;
+  (void)i;
+  for (uint8_t k = 0; k < BENCH_NEIGHBORS; k++) {
+    mesh_routing_refresh_next_hop(&bench_ctx, BENCH_NEIGHBOR(k));
+  }
+  mesh_routing_timer_tick(&bench_ctx);
+}
+
+/**
+ * @brief Armado del anuncio completo de la tabla
+ *
+ */
+static void bench_op_advertisement(uint8_t entries, uint32_t i) {
+  (void)entries;
+  (void)i;
+  mesh_routing_send_neighbor(&bench_ctx, true, false);
+}
+
+static double bench_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/**
+ * @brief Ejecuta un benchmark duplicando la cantidad de operaciones hasta medir al menos
+ * BENCH_MIN_NS y escribe el resultado
+ *
+ * @param bench benchmark
+ * @param entries tamaño de la tabla
+ */
+static void bench_run(const struct bench * bench, uint8_t entries) {
+  uint32_t batch = bench->batch(entries);
+  uint64_t iterations = BENCH_WARMUP;
+  double elapsed;
+
+  bench->reset(entries);
+  for (uint32_t i = 0; i < BENCH_WARMUP; i++) {
+    if (i % batch == 0) {
+      bench->reset(entries);
+    }
+    bench->op(entries, i);
+  }
+
+  for (;;) {
+    elapsed = 0;
+    bench_allocs = 0;
+    for (uint64_t done = 0; done < iterations; done = done + batch) {
+      uint64_t count = iterations - done < batch ? iterations - done : batch;
+      if (batch != UINT32_MAX) {
+        bench->reset(entries);
+      }
+      unsigned long allocs = bench_allocs;
+      double start = bench_now_ns();
+      for (uint32_t i = 0; i < count; i++) {
+        bench->op(entries, i);
+      }
+      elapsed = elapsed + bench_now_ns() - start;
+      if (batch != UINT32_MAX) {
+        bench_allocs = allocs; // reset no cuenta
+      }
+    }
+    if (elapsed >= BENCH_MIN_NS || iterations >= (1ull << 32)) {
+      break;
+    }
+    iterations = iterations * 2;
+  }
+
+  printf("%s\n  {\"benchmark\": \"%s\", \"entries\": %u, \"iterations\": %llu, "
+         "\"ns_per_op\": %.2f, \"allocs_per_op\": %.3f}",
+         bench_first_result ? "" : ",", bench->name, entries, (unsigned long long)iterations,
+         elapsed / iterations, (double)bench_allocs / iterations);
+  bench_first_result = false;
+}
+
+/* === Public function implementation ========================================================== */
+
+uint8_t * __wrap_mesh_msg_alloc() {
+  bench_allocs++;
+  return __real_mesh_msg_alloc();
+}
+
+void * __wrap_malloc(size_t size) {
+  bench_allocs++;
+  return __real_malloc(size);
+}
+
+void mesh_conn_send_msg(uint8_t id_mesh, uint8_t * msg) {
+  bench_sink ^= id_mesh ^ msg[LENGHT];
+}
+
+void mesh_conn_send_msgs(uint8_t ** msgs, uint8_t count) {
+  bench_sink ^= msgs[0][NEXT_HOP] ^ count;
+}
+
+void mesh_app_process_msg(uint8_t * data) {
+  bench_sink ^= data[OPCODE];
+}
+
+void mesh_print(uint8_t * msg) {
+  bench_sink ^= msg[0];
+}
+
+void mesh_port_routing_lock() {
+}
+
+void mesh_port_routing_unlock() {
+}
+
+uint32_t mesh_port_cycles() {
+  return 0;
+}
+
+int main() {
+  static const struct bench benches[] = {
+      {"forward", bench_reset_full, bench_op_forward, bench_batch_unlimited},
+      {"forward_traced", bench_reset_full_traced, bench_op_forward, bench_batch_unlimited},
+      {"route_insert", bench_reset_empty, bench_op_insert, bench_batch_fill},
+      {"route_update", bench_reset_full, bench_op_update, bench_batch_unlimited},
+      {"aging", bench_reset_full, bench_op_aging, bench_batch_unlimited},
+      {"advertisement", bench_reset_full, bench_op_advertisement, bench_batch_unlimited},
+  };
+  static const uint8_t sizes[] = {20, 64, 250};
+
+  mesh_msg_init();
+  printf("[");
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    for (size_t j = 0; j < sizeof(sizes); j++) {
+      bench_run(&benches[i], sizes[j]);
+    }
+  }
+  printf("\n]\n");
+  return 0;
+}
+
+/* === End of documentation ==================================================================== */
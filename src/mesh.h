@@ -39,10 +39,12 @@ SPDX-License-Identifier: MIT
 #define NEXT_HOP              2
 #define OPCODE                3
 #define LENGHT                4
-#define MSG                   5
+#define SEQ                   5 // número de secuencia del origen, identifica los broadcast
+#define TTL                   6 // saltos que le quedan al msg, cada reenvío lo decrementa
+#define MSG                   7
 
 #define MAX_SIZE_MSG          20
-#define SRC_DIR               10
+#define SRC_DIR               10 // id por defecto del nodo, ver mesh_routing_init()
 
 #define BROADCAST_DIR         0xFD
 #define NULL_DIR              0xFE
@@ -54,6 +56,7 @@ SPDX-License-Identifier: MIT
 #define OPCODE_ROUTING_MAX    30
 #define OPCODE_APP_MIN        31
 #define OPCODE_APP_MAX        100
+#define OPCODE_TRANSPORT      101 // fragmento de un datagrama de aplicación, ver mesh_transport
 
 /* === Public data type declarations =========================================================== */
 struct msg {
@@ -62,6 +65,8 @@ struct msg {
   uint8_t next_hop;
   uint8_t opcode;
   uint8_t lenght;
+  uint8_t seq;
+  uint8_t ttl;
   uint8_t msg[MAX_SIZE_MSG];
 };
 
@@ -0,0 +1,248 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file mesh_app.c
+ ** @brief Esta capa entrega los msg de aplicación a las funciones suscriptas a su opcode. Cada
+ *         opcode de aplicación indexa directamente una lista de suscripciones, por lo que el costo
+ *         de despachar un msg no depende de la cantidad de opcodes registrados. Las suscripciones
+ *         se toman de un arreglo compartido de MESH_APP_MAX_SUBSCRIBERS elementos y se enlazan por
+ *         índice, así un opcode puede tener varias funciones suscriptas sin reservar lugar para
+ *         todas en cada opcode. Los fragmentos de OPCODE_TRANSPORT pasan por mesh_transport,
+ *         que vuelve a llamar a mesh_app_process_msg() con el datagrama rearmado.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh_app.h"
+#include "mesh.h"
+#include "mesh_routing.h"
+#include "mesh_transport.h"
+
+/* === Macros definitions ====================================================================== */
+
+#define OPCODE_APP_COUNT  (OPCODE_APP_MAX - OPCODE_APP_MIN + 1)
+
+#define SUBSCRIBER_NONE   0xFF // fin de la lista de suscripciones
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Suscripción de una función a un opcode
+ *
+ */
+struct subscriber_list {
+  int (*p_func)(uint8_t * msg, int len);
+  uint8_t next;
+};
+
+_Static_assert(MESH_APP_MAX_SUBSCRIBERS < SUBSCRIBER_NONE, "MESH_APP_MAX_SUBSCRIBERS muy grande");
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+/**
+ * @brief Suscripciones, las libres están enlazadas a partir de free_subscriber
+ *
+ */
+static struct subscriber_list subscribers[MESH_APP_MAX_SUBSCRIBERS];
+
+/**
+ * @brief Primera suscripción de cada opcode, indexado por opcode - OPCODE_APP_MIN
+ *
+ */
+static uint8_t opcode_table[OPCODE_APP_COUNT];
+
+/**
+ * @brief Primera suscripción libre
+ *
+ */
+static uint8_t free_subscriber = SUBSCRIBER_NONE;
+
+/**
+ * @brief Despachos de msg en curso, mayor a uno si una función suscripta entrega otro msg
+ *
+ */
+static uint8_t dispatching = 0;
+
+/**
+ * @brief Indica si se eliminaron suscripciones durante un despacho que todavía están enlazadas
+ *
+ */
+static bool pending_removal = false;
+
+/**
+ * @brief Nodo de la capa routing por el que se envían los msg de aplicación
+ *
+ */
+static struct mesh_routing_ctx * routing_ctx = NULL;
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Indica si un opcode es de aplicación
+ *
+ * @param opcode opcode a revisar
+ * @return true si está entre OPCODE_APP_MIN y OPCODE_APP_MAX
+ */
+static bool mesh_app_valid_opcode(uint8_t opcode) {
+  return opcode >= OPCODE_APP_MIN && opcode <= OPCODE_APP_MAX;
+}
+
+/**
+ * @brief Desenlaza y libera las suscripciones eliminadas durante un despacho. Mientras se despacha
+ * un msg, mesh_app_remove_opcode() sólo borra la función, para que el recorrido de la lista no
+ * siga un índice que ya volvió a la lista de libres.
+ *
+ */
+static void mesh_app_release_removed(void) {
+  for (int opcode = 0; opcode < OPCODE_APP_COUNT; opcode++) {
+    uint8_t * p_next = &opcode_table[opcode];
+    while (*p_next != SUBSCRIBER_NONE) {
+      uint8_t i = *p_next;
+      if (subscribers[i].p_func != NULL) {
+        p_next = &subscribers[i].next;
+        continue;
+      }
+      *p_next = subscribers[i].next;
+      subscribers[i].next = free_subscriber;
+      free_subscriber = i;
+    }
+  }
+  pending_removal = false;
+}
+
+/* === Public function implementation ========================================================== */
+
+void mesh_app_init(struct mesh_routing_ctx * routing) {
+  routing_ctx = routing;
+  for (int i = 0; i < OPCODE_APP_COUNT; i++) {
+    opcode_table[i] = SUBSCRIBER_NONE;
+  }
+  for (int i = 0; i < MESH_APP_MAX_SUBSCRIBERS; i++) {
+    subscribers[i].p_func = NULL;
+    subscribers[i].next = i + 1 < MESH_APP_MAX_SUBSCRIBERS ? i + 1 : SUBSCRIBER_NONE;
+  }
+  free_subscriber = 0;
+  dispatching = 0;
+  pending_removal = false;
+}
+
+void mesh_app_process_msg(uint8_t * data) {
+
+  if (data[OPCODE] == OPCODE_TRANSPORT) {
+    mesh_transport_process_msg(data); // entrega el datagrama cuando se completa
+    return;
+  }
+
+  if (mesh_app_valid_opcode(data[OPCODE]) == false) {
+    return;
+  }
+
+  dispatching++;
+  uint8_t i = opcode_table[data[OPCODE] - OPCODE_APP_MIN];
+  while (i != SUBSCRIBER_NONE) {
+    if (subscribers[i].p_func != NULL) { // eliminada por otra función durante este despacho
+      subscribers[i].p_func(&data[MSG], data[LENGHT]);
+    }
+    i = subscribers[i].next;
+  }
+  dispatching--;
+
+  if (dispatching == 0 && pending_removal) {
+    mesh_app_release_removed();
+  }
+}
+
+void ble_app_send(uint8_t * msg_send) {
+  msg_send[SRC] = mesh_routing_get_id(routing_ctx);
+  msg_send[SEQ] = 0; // la capa routing numera los broadcast que inunda
+  msg_send[TTL] = MESH_ROUTING_DEFAULT_TTL;
+  mesh_routing_send_msg(routing_ctx, msg_send);
+}
+
+int mesh_app_add_opcode(uint8_t opcode_number, int (*p_func)(uint8_t * msg, int len)) {
+
+  if (mesh_app_valid_opcode(opcode_number) == false || p_func == NULL ||
+      free_subscriber == SUBSCRIBER_NONE) {
+    return -1;
+  }
+
+  uint8_t * p_next = &opcode_table[opcode_number - OPCODE_APP_MIN];
+  while (*p_next != SUBSCRIBER_NONE) {
+    if (subscribers[*p_next].p_func == p_func) {
+      return -1; // ya suscripta
+    }
+    p_next = &subscribers[*p_next].next;
+  }
+
+  uint8_t i = free_subscriber;
+  free_subscriber = subscribers[i].next;
+  subscribers[i].p_func = p_func;
+  subscribers[i].next = SUBSCRIBER_NONE;
+  *p_next = i;
+  return 0;
+}
+
+int mesh_app_remove_opcode(uint8_t opcode_number, int (*p_func)(uint8_t * msg, int len)) {
+
+  if (mesh_app_valid_opcode(opcode_number) == false || p_func == NULL) {
+    return -1;
+  }
+
+  uint8_t * p_next = &opcode_table[opcode_number - OPCODE_APP_MIN];
+  while (*p_next != SUBSCRIBER_NONE) {
+    uint8_t i = *p_next;
+    if (subscribers[i].p_func == p_func) {
+      subscribers[i].p_func = NULL;
+      if (dispatching > 0) {
+        pending_removal = true; // se libera al terminar el despacho
+        return 0;
+      }
+      *p_next = subscribers[i].next;
+      subscribers[i].next = free_subscriber;
+      free_subscriber = i;
+      return 0;
+    }
+    p_next = &subscribers[i].next;
+  }
+  return -1;
+}
+
+uint8_t opcode_existe(uint8_t opcode) {
+  if (mesh_app_valid_opcode(opcode) == false) {
+    return 0;
+  }
+  for (uint8_t i = opcode_table[opcode - OPCODE_APP_MIN]; i != SUBSCRIBER_NONE;
+       i = subscribers[i].next) {
+    if (subscribers[i].p_func != NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* === End of documentation ==================================================================== */
@@ -35,20 +35,67 @@ SPDX-License-Identifier: MIT
 
 /* === Public macros definitions =============================================================== */
 
+#ifndef MESH_APP_MAX_SUBSCRIBERS
+#define MESH_APP_MAX_SUBSCRIBERS 16 // suscripciones a opcodes entre todas las aplicaciones
+#endif
+
 /* === Public data type declarations =========================================================== */
 
+struct mesh_routing_ctx;
+
 /* === Public variable declarations ============================================================ */
 
 /* === Public function declarations ============================================================ */
 
-void mesh_app_init();
-
+/**
+ * @brief Inicializa la capa de aplicación sin ninguna suscripción
+ *
+ * @param routing nodo de la capa routing por el que se envían los msg de aplicación
+ */
+void mesh_app_init(struct mesh_routing_ctx * routing);
+
+/**
+ * @brief Entrega un msg a todas las funciones suscriptas a su opcode. Todas reciben el mismo
+ * buffer, por lo que no deben modificarlo. Los fragmentos de OPCODE_TRANSPORT se rearman con
+ * mesh_transport_process_msg().
+ *
+ * @param data msg a procesar
+ */
 void mesh_app_process_msg(uint8_t * data);
 
+/**
+ * @brief Envía un msg de aplicación a la red
+ *
+ * @param msg_send msg a enviar, con DST, OPCODE, LENGHT y MSG completos
+ */
 void ble_app_send(uint8_t * msg_send);
 
-void mesh_app_add_opcode(uint8_t opcode_number, int (*p_func)(uint8_t * msg, int len));
+/**
+ * @brief Suscribe una función a un opcode de aplicación. Un mismo opcode puede tener varias
+ * funciones suscriptas, que se llaman en el orden en que se suscribieron.
+ *
+ * @param opcode_number opcode entre OPCODE_APP_MIN y OPCODE_APP_MAX
+ * @param p_func función que recibe el contenido del msg y su largo
+ * @return int 0 si se suscribió, -1 si el opcode es inválido, la función ya estaba suscripta o no
+ * quedan suscripciones libres
+ */
+int mesh_app_add_opcode(uint8_t opcode_number, int (*p_func)(uint8_t * msg, int len));
+
+/**
+ * @brief Elimina la suscripción de una función a un opcode
+ *
+ * @param opcode_number opcode de la suscripción
+ * @param p_func función suscripta
+ * @return int 0 si se eliminó, -1 si la función no estaba suscripta al opcode
+ */
+int mesh_app_remove_opcode(uint8_t opcode_number, int (*p_func)(uint8_t * msg, int len));
 
+/**
+ * @brief Indica si un opcode tiene alguna función suscripta
+ *
+ * @param opcode opcode a revisar
+ * @return uint8_t 1 si tiene suscripciones, 0 si no
+ */
 uint8_t opcode_existe(uint8_t opcode);
 
 /* === End of documentation ==================================================================== */
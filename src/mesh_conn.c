@@ -0,0 +1,632 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file mesh_conn.c
+ ** @brief Esta capa se encarga de asociar el id de cada nodo de la red mesh con la conexión ble por
+ *         la que se lo alcanza y de enviar y recibir los msg por ble. Cada conexión tiene una cola
+ *         de salida por clase de prioridad: los msg de las capas conn y routing salen siempre
+ *         antes que los de aplicación, así los anuncios de rutas no esperan detrás del tráfico de
+ *         aplicación. Los msg encolados hacia un mismo vecino se agrupan en una única trama ble
+ *         de hasta MESH_CONN_MTU bytes con el formato {cantidad de msg, msg...}. Las colas guardan
+ *         referencias a msg del pool, por lo que un broadcast ocupa un solo msg aunque se encole
+ *         en todas las conexiones.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh_conn.h"
+#include "mesh.h"
+#include "mesh_msg.h"
+#include "mesh_port.h"
+#include "mesh_routing.h"
+#include "string.h"
+
+/* === Macros definitions ====================================================================== */
+
+#define HELLO_OPCODE      11 // opcode del msg con el que un vecino se identifica
+
+#define FRAME_COUNT       0 // posición de la cantidad de msg en la trama
+#define FRAME_HEADER_SIZE 1 // bytes de encabezado de la trama
+
+#define TX_CLASS_CONTROL  0 // msg de las capas conn y routing
+#define TX_CLASS_APP      1 // msg de aplicación
+#define TX_CLASS_COUNT    2
+
+#define INDEX_EMPTY       0xFF // posición vacía en los índices hacia la tabla de conexiones
+
+#define CONN_HASH_SIZE    (2 * MESH_CONN_MAX_CONN) // posiciones del índice conexión ble -> conexión
+
+#define CONN_MIN_MTU      (FRAME_HEADER_SIZE + MSG + MAX_SIZE_MSG) // trama con un msg de largo máx.
+
+#define LAST_SEEN_MAX     UINT16_MAX
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Cola circular de msg pendientes de envío
+ *
+ */
+struct tx_queue {
+  uint8_t * msgs[MESH_CONN_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t count;
+};
+
+/**
+ * @brief Representación de una conexión ble con un vecino. El id del vecino es NULL_DIR hasta
+ * recibir su msg hello.
+ *
+ */
+struct conn_list {
+  bool used;
+  uint8_t * p_conn;
+  uint8_t id_mesh;
+  uint8_t mtu;
+  uint16_t last_seen;
+  uint16_t dropped;
+  struct tx_queue queues[TX_CLASS_COUNT];
+};
+
+_Static_assert(MESH_CONN_MAX_CONN < INDEX_EMPTY, "MESH_CONN_MAX_CONN muy grande");
+_Static_assert(MESH_CONN_MTU >= CONN_MIN_MTU, "MESH_CONN_MTU no alcanza para un msg");
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+/**
+ * @brief Tabla de conexiones
+ *
+ */
+static struct conn_list conn_list[MESH_CONN_MAX_CONN];
+
+/**
+ * @brief Índice conexión ble -> elemento de la tabla de conexiones. Tabla hash de direccionamiento
+ * abierto; al eliminar se corren los elementos siguientes en lugar de dejar marcas de borrado, por
+ * lo que la búsqueda no se degrada con las reconexiones.
+ *
+ */
+static uint8_t conn_hash[CONN_HASH_SIZE];
+
+/**
+ * @brief Índice id mesh -> elemento de la tabla de conexiones, INDEX_EMPTY si no hay conexión
+ *
+ */
+static uint8_t conn_index[UINT8_MAX + 1];
+
+/**
+ * @brief Pila de elementos libres de la tabla de conexiones
+ *
+ */
+static uint8_t free_conns[MESH_CONN_MAX_CONN];
+
+/**
+ * @brief Cantidad de elementos en free_conns
+ *
+ */
+static uint8_t free_conns_count = 0;
+
+/**
+ * @brief Nodo de la capa routing al que se entregan los msg recibidos
+ *
+ */
+static struct mesh_routing_ctx * routing_ctx = NULL;
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Posición inicial de una conexión ble en conn_hash
+ *
+ * @param p_conn id de la conexión ble
+ * @return uint8_t posición
+ */
+static uint8_t mesh_conn_hash(uint8_t * p_conn) {
+  uint32_t address = (uint32_t)(uintptr_t)p_conn;
+  return (uint8_t)(((address ^ (address >> 16)) * 2654435761u >> 16) % CONN_HASH_SIZE);
+}
+
+/**
+ * @brief Busca la posición de una conexión ble en conn_hash
+ *
+ * @param p_conn id de la conexión ble
+ * @return int posición, -1 si la conexión no existe
+ */
+static int mesh_conn_search_hash(uint8_t * p_conn) {
+  uint8_t position = mesh_conn_hash(p_conn);
+  while (conn_hash[position] != INDEX_EMPTY) {
+    if (conn_list[conn_hash[position]].p_conn == p_conn) {
+      return position;
+    }
+    position = (position + 1) % CONN_HASH_SIZE;
+  }
+  return -1;
+}
+
+/**
+ * @brief Elimina una posición de conn_hash corriendo hacia atrás los elementos que quedarían
+ * inalcanzables
+ *
+ * @param position posición a eliminar
+ */
+static void mesh_conn_remove_hash(uint8_t position) {
+  uint8_t hole = position;
+  uint8_t next = (hole + 1) % CONN_HASH_SIZE;
+
+  while (conn_hash[next] != INDEX_EMPTY) {
+    uint8_t home = mesh_conn_hash(conn_list[conn_hash[next]].p_conn);
+    if ((next - home + CONN_HASH_SIZE) % CONN_HASH_SIZE >=
+        (next - hole + CONN_HASH_SIZE) % CONN_HASH_SIZE) {
+      conn_hash[hole] = conn_hash[next];
+      hole = next;
+    }
+    next = (next + 1) % CONN_HASH_SIZE;
+  }
+  conn_hash[hole] = INDEX_EMPTY;
+}
+
+/**
+ * @brief Busca una conexión en base a su id de conexión ble
+ *
+ * @param p_conn id de la conexión ble
+ * @return struct conn_list* conexión, NULL si no existe
+ */
+static struct conn_list * mesh_conn_search_conn(uint8_t * p_conn) {
+  int position = mesh_conn_search_hash(p_conn);
+  if (position < 0) {
+    return NULL;
+  }
+  return &conn_list[conn_hash[position]];
+}
+
+/**
+ * @brief Asocia una conexión con el id mesh del vecino. Si el vecino se reconectó por otra conexión
+ * la conexión anterior deja de estar asociada.
+ *
+ * @param conn conexión
+ * @param id_mesh id del vecino
+ */
+static void mesh_conn_bind_id(struct conn_list * conn, uint8_t id_mesh) {
+  if (conn->id_mesh != NULL_DIR) {
+    conn_index[conn->id_mesh] = INDEX_EMPTY;
+  }
+  if (conn_index[id_mesh] != INDEX_EMPTY) {
+    conn_list[conn_index[id_mesh]].id_mesh = NULL_DIR;
+  }
+  conn->id_mesh = id_mesh;
+  conn_index[id_mesh] = conn - conn_list;
+}
+
+/**
+ * @brief Cantidad de msg encolados en una conexión
+ *
+ * @param conn conexión
+ * @return uint8_t msg encolados entre todas las clases
+ */
+static uint8_t mesh_conn_queue_depth(struct conn_list * conn) {
+  uint8_t depth = 0;
+  for (int i = 0; i < TX_CLASS_COUNT; i++) {
+    depth = depth + conn->queues[i].count;
+  }
+  return depth;
+}
+
+/**
+ * @brief Descarta todos los msg encolados en una conexión
+ *
+ * @param conn conexión a vaciar
+ */
+static void mesh_conn_clear_queues(struct conn_list * conn) {
+  for (int i = 0; i < TX_CLASS_COUNT; i++) {
+    struct tx_queue * queue = &conn->queues[i];
+    while (queue->count > 0) {
+      mesh_msg_release(queue->msgs[queue->head]);
+      queue->head = (queue->head + 1) % MESH_CONN_QUEUE_SIZE;
+      queue->count--;
+    }
+    queue->head = 0;
+  }
+}
+
+/**
+ * @brief Arma una trama con los msg encolados en una conexión, empezando por la clase de mayor
+ * prioridad. Un msg de menor prioridad nunca adelanta a uno de mayor prioridad que no entró en la
+ * trama.
+ *
+ * @param conn conexión de la que se toman los msg
+ * @param frame buffer de MESH_CONN_MTU bytes donde se arma la trama, que no supera el MTU de la
+ * conexión
+ * @return uint8_t largo de la trama, FRAME_HEADER_SIZE si no hay msg encolados
+ */
+static uint8_t mesh_conn_build_frame(struct conn_list * conn, uint8_t * frame) {
+
+  uint8_t len = FRAME_HEADER_SIZE;
+  frame[FRAME_COUNT] = 0;
+
+  for (int i = 0; i < TX_CLASS_COUNT; i++) {
+    struct tx_queue * queue = &conn->queues[i];
+
+    while (queue->count > 0) {
+      uint8_t * msg = queue->msgs[queue->head];
+      uint8_t size = MSG + msg[LENGHT];
+
+      if (len + size > conn->mtu) {
+        return len; // trama completa
+      }
+      memcpy(&frame[len], msg, size);
+      len = len + size;
+      frame[FRAME_COUNT]++;
+
+      mesh_msg_release(msg);
+      queue->head = (queue->head + 1) % MESH_CONN_QUEUE_SIZE;
+      queue->count--;
+    }
+  }
+  return len;
+}
+
+/**
+ * @brief Cuenta un msg que no se pudo encolar en una conexión
+ *
+ * @param conn conexión
+ */
+static void mesh_conn_count_drop(struct conn_list * conn) {
+  if (conn->dropped < UINT16_MAX) {
+    conn->dropped++;
+  }
+}
+
+/**
+ * @brief Encola un msg en la cola de la conexión que corresponde a su opcode, reteniendo una
+ * referencia. Si la cola está llena primero se envía una trama por la conexión para hacer lugar,
+ * así un anuncio de rutas más largo que la cola no pierde fragmentos. Se llama con la capa conn
+ * bloqueada, que se libera mientras se envía la trama.
+ *
+ * @param conn conexión por la que se envía el msg
+ * @param msg msg del pool a encolar
+ */
+static void mesh_conn_enqueue(struct conn_list * conn, uint8_t * msg) {
+
+  uint8_t tx_class = msg[OPCODE] <= OPCODE_ROUTING_MAX ? TX_CLASS_CONTROL : TX_CLASS_APP;
+  struct tx_queue * queue = &conn->queues[tx_class];
+
+  while (queue->count == MESH_CONN_QUEUE_SIZE) {
+    uint8_t frame[MESH_CONN_MTU];
+    uint8_t * p_conn = conn->p_conn;
+    uint8_t len = mesh_conn_build_frame(conn, frame);
+
+    mesh_port_conn_unlock();
+    mesh_send(p_conn, frame, len);
+    mesh_port_conn_lock();
+    if (conn->used == false || conn->p_conn != p_conn) {
+      return; // la conexión se eliminó mientras se enviaba la trama
+    }
+  }
+  queue->msgs[(queue->head + queue->count) % MESH_CONN_QUEUE_SIZE] = mesh_msg_hold(msg);
+  queue->count++;
+}
+
+/**
+ * @brief Procesa un msg de la capa conn
+ *
+ * @param conn conexión por la que llegó el msg, NULL si la conexión no existe
+ * @param msg msg a procesar
+ */
+static void mesh_conn_process_msg(struct conn_list * conn, uint8_t * msg) {
+
+  switch (msg[OPCODE]) {
+
+  case HELLO_OPCODE:
+    if (conn != NULL && msg[SRC] < BROADCAST_DIR) {
+      mesh_conn_bind_id(conn, msg[SRC]);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Devuelve el id del vecino de una conexión
+ *
+ * @param p_conn id de la conexión ble
+ * @return uint8_t id del vecino, NULL_DIR si la conexión no existe o no recibió el msg hello
+ */
+static uint8_t mesh_conn_get_id(uint8_t * p_conn) {
+  uint8_t id_mesh = NULL_DIR;
+
+  mesh_port_conn_lock();
+  struct conn_list * conn = mesh_conn_search_conn(p_conn);
+  if (conn != NULL) {
+    id_mesh = conn->id_mesh;
+  }
+  mesh_port_conn_unlock();
+  return id_mesh;
+}
+
+/* === Public function implementation ========================================================== */
+
+void mesh_conn_init(struct mesh_routing_ctx * routing) {
+  mesh_port_conn_lock();
+  routing_ctx = routing;
+  for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+    if (conn_list[i].used == true) {
+      mesh_conn_clear_queues(&conn_list[i]);
+    }
+    conn_list[i].used = false;
+    free_conns[i] = MESH_CONN_MAX_CONN - 1 - i;
+  }
+  free_conns_count = MESH_CONN_MAX_CONN;
+  memset(conn_hash, INDEX_EMPTY, sizeof(conn_hash));
+  memset(conn_index, INDEX_EMPTY, sizeof(conn_index));
+  mesh_port_conn_unlock();
+}
+
+int mesh_conn_add_per(uint8_t * conn) {
+  int result = -1;
+
+  mesh_port_conn_lock();
+  if (free_conns_count > 0 && mesh_conn_search_hash(conn) < 0) {
+    free_conns_count--;
+    uint8_t i = free_conns[free_conns_count];
+
+    memset(&conn_list[i], 0, sizeof(conn_list[i]));
+    conn_list[i].used = true;
+    conn_list[i].p_conn = conn;
+    conn_list[i].id_mesh = NULL_DIR;
+    conn_list[i].mtu = MESH_CONN_MTU;
+
+    uint8_t position = mesh_conn_hash(conn);
+    while (conn_hash[position] != INDEX_EMPTY) {
+      position = (position + 1) % CONN_HASH_SIZE;
+    }
+    conn_hash[position] = i;
+    result = 0;
+  }
+  mesh_port_conn_unlock();
+  return result;
+}
+
+int mesh_conn_delete_per(uint8_t * conn) {
+  int result = -1;
+
+  mesh_port_conn_lock();
+  int position = mesh_conn_search_hash(conn);
+  if (position >= 0) {
+    uint8_t i = conn_hash[position];
+    mesh_conn_remove_hash(position);
+    if (conn_list[i].id_mesh != NULL_DIR) {
+      conn_index[conn_list[i].id_mesh] = INDEX_EMPTY;
+    }
+    mesh_conn_clear_queues(&conn_list[i]);
+    conn_list[i].used = false;
+    free_conns[free_conns_count] = i;
+    free_conns_count++;
+    result = 0;
+  }
+  mesh_port_conn_unlock();
+  return result;
+}
+
+int mesh_conn_set_mtu(uint8_t * p_conn, uint8_t mtu) {
+  int result = -1;
+
+  mesh_port_conn_lock();
+  struct conn_list * conn = mesh_conn_search_conn(p_conn);
+  if (conn != NULL && mtu >= CONN_MIN_MTU) {
+    conn->mtu = mtu < MESH_CONN_MTU ? mtu : MESH_CONN_MTU;
+    result = 0;
+  }
+  mesh_port_conn_unlock();
+  return result;
+}
+
+int mesh_conn_get_state(uint8_t * p_conn, struct mesh_conn_state * state) {
+  int result = -1;
+
+  mesh_port_conn_lock();
+  struct conn_list * conn = mesh_conn_search_conn(p_conn);
+  if (conn != NULL) {
+    state->id_mesh = conn->id_mesh;
+    state->mtu = conn->mtu;
+    state->queue_depth = mesh_conn_queue_depth(conn);
+    state->last_seen = conn->last_seen;
+    state->dropped = conn->dropped;
+    result = 0;
+  }
+  mesh_port_conn_unlock();
+  return result;
+}
+
+uint8_t * mesh_conn_get_conn(uint8_t id_mesh) {
+  uint8_t * p_conn = NULL;
+
+  mesh_port_conn_lock();
+  if (conn_index[id_mesh] != INDEX_EMPTY) {
+    p_conn = conn_list[conn_index[id_mesh]].p_conn;
+  }
+  mesh_port_conn_unlock();
+  return p_conn;
+}
+
+void mesh_conn_handler_time_out() {
+  mesh_port_conn_lock();
+  for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+    if (conn_list[i].used == true && conn_list[i].last_seen < LAST_SEEN_MAX) {
+      conn_list[i].last_seen++;
+    }
+  }
+  mesh_port_conn_unlock();
+}
+
+void mesh_conn_rcv_ble_msg(uint8_t * p_conn, uint8_t * frame, uint8_t len) {
+
+  uint8_t * msgs[MESH_CONN_MTU / MSG];
+  uint8_t count = 0;
+
+  if (len < FRAME_HEADER_SIZE) {
+    return;
+  }
+
+  mesh_port_conn_lock();
+  struct conn_list * conn = mesh_conn_search_conn(p_conn);
+  if (conn != NULL) {
+    conn->last_seen = 0;
+  }
+  mesh_port_conn_unlock();
+
+  uint8_t position = FRAME_HEADER_SIZE;
+  for (uint8_t i = 0; i < frame[FRAME_COUNT]; i++) {
+    uint8_t * msg = &frame[position];
+
+    if (position + MSG > len || msg[LENGHT] > MAX_SIZE_MSG ||
+        position + MSG + msg[LENGHT] > len) {
+      break; // trama inválida, se descarta el resto
+    }
+    position = position + MSG + msg[LENGHT];
+
+    if (msg[OPCODE] >= OPCODE_CONNECTION_MIN && msg[OPCODE] <= OPCODE_CONNECTION_MAX) {
+      mesh_port_conn_lock();
+      mesh_conn_process_msg(mesh_conn_search_conn(p_conn), msg);
+      mesh_port_conn_unlock();
+    } else if (count < sizeof(msgs) / sizeof(msgs[0])) {
+      msgs[count] = msg;
+      count++;
+    }
+  }
+
+  if (count > 0) {
+    mesh_routing_send_msgs(routing_ctx, msgs, count);
+  }
+}
+
+int mesh_conn_link_tx(uint8_t * p_conn, bool acked) {
+  uint8_t id_mesh = mesh_conn_get_id(p_conn);
+
+  if (id_mesh == NULL_DIR) {
+    return -1;
+  }
+  mesh_routing_link_tx(routing_ctx, id_mesh, acked);
+  return 0;
+}
+
+int mesh_conn_link_rssi(uint8_t * p_conn, int8_t rssi) {
+  uint8_t id_mesh = mesh_conn_get_id(p_conn);
+
+  if (id_mesh == NULL_DIR) {
+    return -1;
+  }
+  mesh_routing_link_rssi(routing_ctx, id_mesh, rssi);
+  return 0;
+}
+
+void mesh_conn_send_msg(uint8_t id_mesh, uint8_t * msg) {
+
+  mesh_port_conn_lock();
+  uint8_t * msg_pool = mesh_msg_hold(msg); // una sola copia compartida por todas las conexiones
+  if (id_mesh != BROADCAST_DIR) {
+    if (conn_index[id_mesh] != INDEX_EMPTY) {
+      if (msg_pool != NULL) {
+        mesh_conn_enqueue(&conn_list[conn_index[id_mesh]], msg_pool);
+      } else {
+        mesh_conn_count_drop(&conn_list[conn_index[id_mesh]]);
+      }
+    }
+  } else {
+    for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+      if (conn_list[i].used == true && conn_list[i].id_mesh != NULL_DIR) {
+        if (msg_pool != NULL) {
+          mesh_conn_enqueue(&conn_list[i], msg_pool);
+        } else {
+          mesh_conn_count_drop(&conn_list[i]);
+        }
+      }
+    }
+  }
+  if (msg_pool != NULL) {
+    mesh_msg_release(msg_pool);
+  }
+  mesh_port_conn_unlock();
+}
+
+void mesh_conn_send_msgs(uint8_t ** msgs, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    mesh_conn_send_msg(msgs[i][NEXT_HOP], msgs[i]);
+  }
+  mesh_conn_flush();
+}
+
+void mesh_conn_flush() {
+
+  uint8_t frame[MESH_CONN_MTU];
+
+  for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+    uint8_t len;
+    do {
+      uint8_t * p_conn = NULL;
+
+      mesh_port_conn_lock();
+      len = FRAME_HEADER_SIZE;
+      if (conn_list[i].used == true) {
+        p_conn = conn_list[i].p_conn;
+        len = mesh_conn_build_frame(&conn_list[i], frame);
+      }
+      mesh_port_conn_unlock();
+
+      if (len > FRAME_HEADER_SIZE) {
+        mesh_send(p_conn, frame, len);
+      }
+    } while (len > FRAME_HEADER_SIZE);
+  }
+}
+
+void mesh_conn_send_hello() {
+
+  uint8_t * msg = mesh_msg_alloc();
+  if (msg == NULL) {
+    return;
+  }
+  msg[SRC] = mesh_routing_get_id(routing_ctx);
+  msg[DST] = BROADCAST_DIR;
+  msg[NEXT_HOP] = BROADCAST_DIR;
+  msg[OPCODE] = HELLO_OPCODE;
+  msg[LENGHT] = 0;
+  msg[SEQ] = 0;
+  msg[TTL] = 0;
+
+  mesh_port_conn_lock();
+  for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+    if (conn_list[i].used == true) {
+      mesh_conn_enqueue(&conn_list[i], msg);
+    }
+  }
+  mesh_port_conn_unlock();
+
+  mesh_msg_release(msg);
+  mesh_conn_flush();
+}
+
+/* === End of documentation ==================================================================== */
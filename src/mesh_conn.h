@@ -36,16 +36,43 @@ SPDX-License-Identifier: MIT
 
 /* === Public macros definitions =============================================================== */
 
+#ifndef MESH_CONN_MAX_CONN
+#define MESH_CONN_MAX_CONN   8 // conexiones ble simultáneas
+#endif
+
+#ifndef MESH_CONN_QUEUE_SIZE
+#define MESH_CONN_QUEUE_SIZE 8 // msg encolados por conexión y por clase de prioridad
+#endif
+
+#ifndef MESH_CONN_MTU
+#define MESH_CONN_MTU        244 // bytes de una escritura ble (ATT MTU 247)
+#endif
+
 /* === Public data type declarations =========================================================== */
 
+struct mesh_routing_ctx;
+
+/**
+ * @brief Estado de una conexión ble
+ *
+ */
+struct mesh_conn_state {
+  uint8_t id_mesh;     // id del vecino, NULL_DIR si todavía no envió su msg hello
+  uint8_t mtu;         // bytes máximos de una trama por esta conexión
+  uint8_t queue_depth; // msg encolados pendientes de envío
+  uint16_t last_seen;  // pasos del handler desde la última trama recibida
+  uint16_t dropped;    // msg que no se pudieron encolar por falta de msg libres en el pool
+};
+
 /* === Public variable declarations ============================================================ */
 
 /* === Public function declarations ============================================================ */
 /**
  * @brief Inicializa el modulo conn sin ninguna conexión
  *
+ * @param routing nodo de la capa routing al que se entregan los msg recibidos
  */
-void mesh_conn_init();
+void mesh_conn_init(struct mesh_routing_ctx * routing);
 
 /**
  * @brief Agrega una conexión
@@ -64,21 +91,108 @@ int mesh_conn_add_per(uint8_t * conn);
 int mesh_conn_delete_per(uint8_t * conn);
 
 /**
- * @brief Recive un msg desde la capa ble
+ * @brief Cambia el MTU de una conexión, por ejemplo luego de negociarlo con el vecino. El MTU se
+ * limita a MESH_CONN_MTU.
  *
  * @param p_conn id de la conexión ble
- * @param msg msg a procesar
+ * @param mtu bytes máximos de una trama
+ * @return int 0 si se cambió, -1 si la conexión no existe o el MTU no alcanza para un msg
+ */
+int mesh_conn_set_mtu(uint8_t * p_conn, uint8_t mtu);
+
+/**
+ * @brief Obtiene el estado de una conexión
+ *
+ * @param p_conn id de la conexión ble
+ * @param state estado de la conexión
+ * @return int 0 si la conexión existe, -1 si no
+ */
+int mesh_conn_get_state(uint8_t * p_conn, struct mesh_conn_state * state);
+
+/**
+ * @brief Busca la conexión ble por la que se alcanza un vecino
+ *
+ * @param id_mesh id del vecino
+ * @return uint8_t* id de la conexión ble, NULL si el vecino no está conectado
+ */
+uint8_t * mesh_conn_get_conn(uint8_t id_mesh);
+
+/**
+ * @brief Paso del handler de la capa conn, lleva la cuenta del tiempo desde la última trama
+ * recibida por cada conexión
+ *
+ */
+void mesh_conn_handler_time_out();
+
+/**
+ * @brief Recive una trama desde la capa ble. La trama tiene el formato {cantidad de msg, msg...} y
+ * cada msg se delimita con su campo LENGHT.
+ *
+ * @param p_conn id de la conexión ble
+ * @param frame trama a procesar
+ * @param len largo de la trama
+ */
+void mesh_conn_rcv_ble_msg(uint8_t * p_conn, uint8_t * frame, uint8_t len);
+
+/**
+ * @brief Informa el resultado de una trama enviada con mesh_send(), para medir la calidad del
+ * enlace con el vecino. El port lo llama cuando la capa ble confirma la escritura o la da por
+ * perdida.
+ *
+ * @param p_conn id de la conexión ble
+ * @param acked true si el vecino confirmó la trama
+ * @return int 0 si se registró, -1 si la conexión no existe o el vecino no envió su msg hello
+ */
+int mesh_conn_link_tx(uint8_t * p_conn, bool acked);
+
+/**
+ * @brief Informa el RSSI de una trama recibida, para medir la calidad del enlace con el vecino
+ *
+ * @param p_conn id de la conexión ble
+ * @param rssi RSSI en dBm
+ * @return int 0 si se registró, -1 si la conexión no existe o el vecino no envió su msg hello
  */
-void mesh_conn_rcv_ble_msg(uint8_t * p_conn, uint8_t * msg);
+int mesh_conn_link_rssi(uint8_t * p_conn, int8_t rssi);
 
 /**
- * @brief envia un msg a la capa conn
+ * @brief envia un msg a la capa conn. El msg solo se presta durante la llamada, si la capa conn lo
+ * necesita guardar (por ejemplo para encolarlo) lo retiene con mesh_msg_hold() y lo libera con
+ * mesh_msg_release() luego de enviarlo. Un msg a BROADCAST_DIR se retiene una vez por conexión.
+ * Si la cola de una conexión está llena se envía en el momento una trama por esa conexión para
+ * hacerle lugar, así los msg no se pierden aunque no se haya llamado a mesh_conn_flush(). Solo se
+ * descarta un msg prestado que no es del pool cuando no quedan msg libres para copiarlo, y se
+ * cuenta en el estado de la conexión.
  *
  * @param id_mesh id del nodo
  * @param msg msg a procesar
  */
 void mesh_conn_send_msg(uint8_t id_mesh, uint8_t * msg);
 
+/**
+ * @brief envia varios msg a la capa conn en una sola llamada. Cada msg ya tiene el id del próximo
+ * nodo en el campo NEXT_HOP y los msg llegan agrupados por próximo nodo. Los msg se prestan igual
+ * que en mesh_conn_send_msg().
+ *
+ * @param msgs arreglo de msg a procesar
+ * @param count cantidad de msg del arreglo
+ */
+void mesh_conn_send_msgs(uint8_t ** msgs, uint8_t count);
+
+/**
+ * @brief Envía por ble los msg encolados. Los msg hacia un mismo nodo se agrupan en tramas de
+ * hasta MESH_CONN_MTU bytes y los msg de las capas conn y routing salen antes que los de
+ * aplicación. Se llama cuando la capa ble puede aceptar nuevas escrituras.
+ *
+ */
+void mesh_conn_flush();
+
+/**
+ * @brief Envía un msg hello por todas las conexiones para que cada vecino asocie la conexión con
+ * el id de este nodo
+ *
+ */
+void mesh_conn_send_hello();
+
 /* === End of documentation ==================================================================== */
 
 #endif
@@ -0,0 +1,139 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file mesh_msg.c
+ ** @brief Pool de msg compartido por todas las capas. Los msg son struct msg de tamaño fijo, por lo
+ *         que la memoria usada para msg está acotada por MESH_MSG_POOL_SIZE. Cada msg tiene un
+ *         contador de referencias atómico, así un mismo msg puede reenviarse sin copiarse y un
+ *         broadcast puede quedar encolado en varias conexiones a la vez.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh_msg.h"
+#include "mesh.h"
+#include "string.h"
+#include "stdatomic.h"
+
+/* === Macros definitions ====================================================================== */
+
+/* === Private data type declarations ========================================================== */
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+/**
+ * @brief msg del pool
+ *
+ */
+static struct msg pool[MESH_MSG_POOL_SIZE];
+
+/**
+ * @brief Referencias de cada msg del pool, 0 es un msg libre
+ *
+ */
+static atomic_uchar pool_refs[MESH_MSG_POOL_SIZE];
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Busca la posición de un msg en el pool
+ *
+ * @param msg msg a buscar
+ * @return int posición del msg, -1 si no es del pool
+ */
+static int mesh_msg_search_in_pool(uint8_t * msg) {
+  uintptr_t address = (uintptr_t)msg;
+  uintptr_t first = (uintptr_t)&pool[0];
+
+  if (address < first || address >= first + sizeof(pool) ||
+      (address - first) % sizeof(struct msg) != 0) {
+    return -1;
+  }
+  return (address - first) / sizeof(struct msg);
+}
+
+/* === Public function implementation ========================================================== */
+
+void mesh_msg_init() {
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    atomic_store(&pool_refs[i], 0);
+  }
+}
+
+uint8_t * mesh_msg_alloc() {
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    unsigned char free_refs = 0;
+    if (atomic_compare_exchange_strong(&pool_refs[i], &free_refs, 1)) {
+      return (uint8_t *)&pool[i];
+    }
+  }
+  return NULL;
+}
+
+uint8_t * mesh_msg_hold(uint8_t * msg) {
+  int position = mesh_msg_search_in_pool(msg);
+
+  if (position >= 0) {
+    atomic_fetch_add(&pool_refs[position], 1);
+    return msg;
+  }
+
+  uint8_t * copy = mesh_msg_alloc();
+  if (copy != NULL) {
+    uint8_t len = msg[LENGHT] < MAX_SIZE_MSG ? msg[LENGHT] : MAX_SIZE_MSG;
+    memcpy(copy, msg, MSG + len);
+    copy[LENGHT] = len;
+  }
+  return copy;
+}
+
+void mesh_msg_release(uint8_t * msg) {
+  int position = mesh_msg_search_in_pool(msg);
+
+  if (position >= 0) {
+    unsigned char refs = atomic_load(&pool_refs[position]);
+    while (refs > 0 && !atomic_compare_exchange_weak(&pool_refs[position], &refs, refs - 1)) {
+    }
+  }
+}
+
+bool mesh_msg_is_pooled(uint8_t * msg) {
+  return mesh_msg_search_in_pool(msg) >= 0;
+}
+
+uint8_t mesh_msg_available() {
+  uint8_t available = 0;
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    if (atomic_load(&pool_refs[i]) == 0) {
+      available++;
+    }
+  }
+  return available;
+}
+
+/* === End of documentation ==================================================================== */
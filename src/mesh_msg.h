@@ -0,0 +1,96 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+#ifndef __mesh_msg_H
+#define __mesh_msg_H
+
+/** @file
+ ** @brief Pool de msg de tamaño fijo con contador de referencias. Un msg que una capa tiene que
+ * guardar más allá de la llamada en la que lo recibió se retiene con mesh_msg_hold() y se libera
+ * con mesh_msg_release() cuando ya no lo usa. El resto de las capas solo toman el msg prestado
+ * mientras dura la llamada.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+/* === Public macros definitions =============================================================== */
+
+#ifndef MESH_MSG_POOL_SIZE
+#define MESH_MSG_POOL_SIZE 8 // cantidad de msg del pool
+#endif
+
+/* === Public data type declarations =========================================================== */
+
+/* === Public variable declarations ============================================================ */
+
+/* === Public function declarations ============================================================ */
+/**
+ * @brief Inicializa el pool con todos los msg libres
+ *
+ */
+void mesh_msg_init();
+
+/**
+ * @brief Toma un msg libre del pool con una referencia
+ *
+ * @return uint8_t* msg, NULL si el pool está agotado
+ */
+uint8_t * mesh_msg_alloc();
+
+/**
+ * @brief Retiene un msg. Si el msg es del pool suma una referencia y devuelve el mismo msg, si no
+ * lo copia en un msg nuevo del pool.
+ *
+ * @param msg msg a retener
+ * @return uint8_t* msg retenido, NULL si hubo que copiarlo y el pool está agotado
+ */
+uint8_t * mesh_msg_hold(uint8_t * msg);
+
+/**
+ * @brief Libera una referencia de un msg del pool. Cuando no quedan referencias el msg vuelve a
+ * estar libre. Los msg que no son del pool se ignoran.
+ *
+ * @param msg msg a liberar
+ */
+void mesh_msg_release(uint8_t * msg);
+
+/**
+ * @brief Indica si un msg pertenece al pool
+ *
+ * @param msg msg a revisar
+ * @return true si es un msg del pool
+ */
+bool mesh_msg_is_pooled(uint8_t * msg);
+
+/**
+ * @brief Cantidad de msg libres del pool
+ *
+ * @return uint8_t msg libres
+ */
+uint8_t mesh_msg_available();
+
+/* === End of documentation ==================================================================== */
+
+#endif
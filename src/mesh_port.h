@@ -50,6 +50,26 @@ void mesh_thread_routing_timer_out();
 
 void mesh_thread_conn_hello_msg();
 
+void mesh_port_routing_lock();
+
+void mesh_port_routing_unlock();
+
+void mesh_port_conn_lock();
+
+void mesh_port_conn_unlock();
+
+void mesh_port_transport_lock();
+
+void mesh_port_transport_unlock();
+
+/**
+ * @brief Contador libre de ciclos del procesador, por ejemplo DWT->CYCCNT, que se usa para medir
+ * latencias. Puede desbordar; solo se usan diferencias entre dos lecturas.
+ *
+ * @return uint32_t ciclos
+ */
+uint32_t mesh_port_cycles();
+
 /* === End of documentation ==================================================================== */
 
 #endif
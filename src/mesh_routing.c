@@ -26,10 +26,17 @@ SPDX-License-Identifier: MIT
  *         destino de los msg e informar a los vecinos su tabla de ruta. Se comunica con las capas
  *         mesh_conn y mesh_app (mesh_conn capa encargada de guardar el estado de la conexión entre
  *         los nodos e identificarlos y mesh_app encargado de procesar el msg de aplicación). Para
- *         cada destino se almacenan dos posibles proximos saltos, para el enrutamiento se utiliza
- *         siempre el primero. En caso que la primera ruta no se pueda alcanzar más, el segundo
- *         camino pasará a ser el prinicipal. Las rutas se envían periódicamente  en caso de dejar
- *         de recivir una ruta se eliminara
+ *         cada destino se almacenan hasta MESH_ROUTING_MAX_PATHS próximos saltos ordenados por
+ *         métrica. El tráfico se reparte entre los caminos de igual (o casi igual) métrica según
+ *         un hash del flujo, por lo que los msg de un mismo flujo siguen siempre el mismo camino.
+ *         En caso que el mejor camino no se pueda alcanzar más, el siguiente pasará a ser el
+ *         prinicipal. Las rutas se envían periódicamente  en caso de dejar de recivir una ruta se
+ *         eliminara. Para evitar lazos, cada destino tiene un número de secuencia al estilo DSDV
+ *         y cada ruta se anuncia con el próximo salto de su mejor camino, de modo que ese vecino
+ *         no la use para volver a través de este nodo (horizonte dividido con envenenamiento).
+ *         La métrica de cada camino es la anunciada por el vecino más el costo del enlace con él,
+ *         que por defecto es 1 (cantidad de saltos) y se puede calcular a partir de la calidad
+ *         medida del enlace (ETX o RSSI).
  */
 
 /* === Headers files inclusions =============================================================== */
@@ -37,29 +44,138 @@ SPDX-License-Identifier: MIT
 #include "mesh.h"
 #include "mesh_app.h"
 #include "mesh_conn.h"
+#include "mesh_msg.h"
 #include "mesh_port.h"
 #include "stdio.h"
+#include "stdatomic.h"
+#include "string.h"
 
 /* === Macros definitions ====================================================================== */
 
 #define RCV_NEIGHBOR_OPCODE 21 // opcode para recivir vecinos
 
+#define INDEX_EMPTY         0xFF // posición vacía en el índice destino -> elemento de la tabla
+
+#define MAP_WORD_BITS       32 // posiciones de la tabla por palabra de los mapas de bits
+
+#define METRIC_INFINITY     0xFF // métrica de una ruta perdida
+
+#define ADV_FORMAT          0 // posición del formato en el msg de rutas
+#define ADV_FRAGMENT_INDEX  1 // posición del número de fragmento en el msg de rutas
+#define ADV_FRAGMENT_COUNT  2 // posición de la cantidad de fragmentos en el msg de rutas
+#define ADV_HEADER_SIZE     3 // bytes de encabezado de cada fragmento del msg de rutas
+
+#define ADV_FORMAT_PLAIN    1 // rutas de ADV_ROUTE_SIZE bytes
+#define ADV_FORMAT_COMPACT  2 // rutas agrupadas por próximo salto, destinos y métricas comprimidos
+#define ADV_ROUTE_SIZE      4 // bytes por ruta en formato plano: {dst, next_hop, metric, seq}
+#define ADV_GROUP_SIZE      2 // encabezado {via, cantidad} de un grupo en formato compacto
+#define ADV_VIA_DIRECT      NULL_DIR // via de un grupo cuyos destinos son su propio próximo salto
+#define ADV_DST_SHIFT       4    // posición de la diferencia de destino en el byte de una ruta
+#define ADV_SEQ_FLAG        0x08 // la ruta lleva su número de secuencia
+#define ADV_METRIC_MASK     0x07 // métrica de la ruta en formato compacto
+#define ADV_ROUTE_MAX_SIZE  4    // bytes máximos de una ruta en formato compacto
+
+#define SNAPSHOT_MAGIC_0     'M'    // primer byte de una copia de la tabla de rutas
+#define SNAPSHOT_MAGIC_1     'R'    // segundo byte de una copia de la tabla de rutas
+#define SNAPSHOT_VERSION     1      // versión del formato de la copia
+#define SNAPSHOT_HEADER_SIZE 6      // {magic, magic, versión, id, secuencia propia, cantidad}
+#define SNAPSHOT_ROUTE_SIZE  3      // {dst, seq, cantidad de caminos}, seguido de los caminos
+#define SNAPSHOT_PATH_SIZE   2      // {next_hop, metric}
+#define SNAPSHOT_CRC_SIZE    2      // CRC-16/CCITT de las rutas y el encabezado, byte alto primero
+#define SNAPSHOT_CRC_INIT    0xFFFF // valor inicial del CRC
+#define SNAPSHOT_CRC_POLY    0x1021 // polinomio del CRC
+#define SNAPSHOT_CHUNK_SIZE  64     // bytes de rutas que se arman con el lock tomado
+
+#define TRACE_MAGIC_0 'M' // primer byte de un volcado del registro de trazas
+#define TRACE_MAGIC_1 'T' // segundo byte de un volcado del registro de trazas
+#define TRACE_VERSION 1   // versión del formato del volcado
+
+#define TRICKLE_MAX_SUPPRESS    2 // intervalos seguidos que se puede suprimir el anuncio propio
+
+/**
+ * @brief Pasos del handler que dura un camino sin anunciarse en modo adaptativo. Un vecino anuncia
+ * al menos una vez cada TRICKLE_MAX_SUPPRESS + 1 intervalos, por lo que en este período siempre se
+ * recibe algún anuncio de cada vecino vigente.
+ */
+#define TRICKLE_ROUTE_LIFETIME  ((TRICKLE_MAX_SUPPRESS + 2) * MESH_ROUTING_TRICKLE_IMAX)
+
+#define WHEEL_SLOTS             MESH_ROUTING_WHEEL_SLOTS // posiciones de cada nivel de la rueda
+#define WHEEL_SPAN              (WHEEL_SLOTS * WHEEL_SLOTS) // pasos que abarcan los dos niveles
+
+#define FLOOD_SEQ_NONE          0 // secuencia de un broadcast que no se inunda
+
+#define LINK_DELIVERY_FULL      256 // proporción de envíos confirmados de un enlace sin pérdidas
+#define LINK_RSSI_SCALE         16  // fracciones de dBm del RSSI promedio de un enlace
+
 /* === Private data type declarations ========================================================== */
 
 /**
- * @brief Representación de un elemento de la tabla de rutas.
+ * @brief Representación de un camino hacia un destino.
  *
  */
-struct neighbor_list {
-  bool used;
-  uint8_t dst;
+struct route_path {
   uint8_t next_hop;
   uint8_t metric;
-  bool time_out;
-  bool second_used;
-  uint8_t second_next_hop;
-  uint8_t second_metric;
-  bool second_time_out;
+  uint16_t deadline; // paso del handler en el que vence el camino si no se vuelve a anunciar
+};
+
+/**
+ * @brief Representación de un elemento de la tabla de rutas. Los caminos se mantienen ordenados
+ * por métrica, el primero es el principal. Una ruta sin caminos es una ruta perdida, que se retiene
+ * hasta paths[0].deadline para seguir anunciándola y rechazar los anuncios viejos. Cada ruta está
+ * en la rueda de tiempos, en una posición que vence a más tardar con el primero de sus caminos o
+ * con el fin de la retención. Si la posición está ocupada, si la ruta se modificó desde el último
+ * anuncio, si está en la rueda y si se restauró de una copia sin confirmarse se guardan aparte, en
+ * los mapas de bits del contexto.
+ *
+ */
+struct neighbor_list {
+  uint8_t dst;
+  uint8_t seq; // número de secuencia del destino, impar si se perdió la ruta
+  uint8_t path_count;
+  uint8_t timer_next; // siguiente ruta de la misma lista de la rueda
+  struct route_path paths[MESH_ROUTING_MAX_PATHS];
+};
+
+_Static_assert(sizeof(struct neighbor_list) <= MESH_ROUTING_ENTRY_SIZE,
+               "MESH_ROUTING_ENTRY_SIZE no alcanza para una ruta");
+_Static_assert(MESH_ROUTING_ENTRY_SIZE % sizeof(uint32_t) == 0,
+               "los mapas de bits deben quedar alineados a continuación de la tabla");
+_Static_assert(MESH_ROUTING_BATCH_MAX > 0 && MESH_ROUTING_BATCH_MAX <= 255,
+               "MESH_ROUTING_BATCH_MAX no entra en el contador de la capa conn");
+_Static_assert((MESH_ROUTING_TRACE_SIZE & (MESH_ROUTING_TRACE_SIZE - 1)) == 0,
+               "MESH_ROUTING_TRACE_SIZE debe ser potencia de 2");
+_Static_assert(SNAPSHOT_ROUTE_SIZE + SNAPSHOT_PATH_SIZE * MESH_ROUTING_MAX_PATHS <=
+                   SNAPSHOT_CHUNK_SIZE,
+               "SNAPSHOT_CHUNK_SIZE no alcanza para una ruta");
+
+/**
+ * @brief Estado del armado de un anuncio en formato compacto. El anuncio se arma dos veces, la
+ * primera sin escribir para contar los fragmentos.
+ *
+ */
+struct adv_writer {
+  bool write;             // false para solo contar los fragmentos
+  bool full;              // anuncio completo o solo las rutas modificadas
+  uint8_t * msg;          // fragmento en armado, NULL si todavía no se tomó del pool
+  uint8_t fragment;       // número del fragmento en armado
+  uint8_t fragment_count; // cantidad de fragmentos, contados en el primer armado
+  uint8_t len;            // bytes usados del fragmento
+  uint8_t group;          // posición del encabezado del grupo abierto, 0 si no hay
+  int16_t prev_dst;       // destino de la ruta anterior del grupo
+  uint8_t prev_seq;       // número de secuencia de la ruta anterior del grupo
+  uint8_t via;            // via de la primera ruta del fragmento en armado
+  uint8_t dst;            // destino de la primera ruta del fragmento en armado
+};
+
+/**
+ * @brief Estado de la escritura o lectura en orden de una copia de la tabla de rutas
+ *
+ */
+struct snapshot_stream {
+  const struct mesh_routing_storage * storage;
+  uint32_t offset; // bytes escritos o leídos
+  uint16_t crc;    // CRC de los bytes escritos o leídos
 };
 
 /* === Private variable declarations =========================================================== */
@@ -70,379 +186,2417 @@ struct neighbor_list {
 
 /* === Private variable definitions ============================================================ */
 
+/* === Private function implementation ========================================================= */
 /**
- * @brief Tabla de rutas
+ * @brief Comienza una modificación de la tabla de rutas. Los lectores que la lean hasta
+ * mesh_routing_table_write_end() repetirán la lectura.
  *
  */
-struct neighbor_list neig_list[MAX_NEIGHBOR] = {0};
+static void mesh_routing_table_write_begin(struct mesh_routing_ctx * ctx) {
+  atomic_fetch_add_explicit(&ctx->table_seq, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
 
 /**
- * @todo Solucionar el problema de variables compartidas,
+ * @brief Termina una modificación de la tabla de rutas
  *
  */
-static bool adding_neighbod = false;
+static void mesh_routing_table_write_end(struct mesh_routing_ctx * ctx) {
+  atomic_fetch_add_explicit(&ctx->table_seq, 1, memory_order_release);
+}
 
-/* === Private function implementation ========================================================= */
 /**
- * @brief Función para buscar un elemento dentro de la tabla de rutas en base al destino
+ * @brief Incrementa un contador del nodo
  *
- * @param dst destino a buscar
- * @return struct neighbor_list* devuelve un puntero a la tabla de rutas correspondiente al destino
+ * @param stat contador
+ * @param value valor a sumar
  */
-static struct neighbor_list * mesh_routing_search_element_in_table(uint8_t dst) {
-  for (uint8_t i = 0; i < MAX_NEIGHBOR; i++) {
-    if (neig_list[i].used == true && neig_list[i].dst == dst) {
-      return &neig_list[i];
-    }
+static void mesh_routing_stat_add(struct mesh_routing_ctx * ctx, enum mesh_routing_stat stat,
+                                  unsigned int value) {
+  atomic_fetch_add_explicit(&ctx->stats[stat], value, memory_order_relaxed);
+}
+
+/**
+ * @brief Registra un evento si el registro de trazas está activo. Cada llamada toma su posición en
+ * el buffer circular con un incremento atómico, por lo que se puede registrar desde el camino de
+ * reenvío sin tomar el lock de la tabla. La marca de la posición se borra antes de escribir el
+ * evento y se publica al terminar, como el número de secuencia de la tabla.
+ *
+ * @param type tipo de evento
+ * @param dst destino
+ * @param next_hop próximo salto
+ * @param metric métrica
+ * @param extra número de secuencia, origen o número de fragmento, según el tipo
+ */
+static void mesh_routing_trace(struct mesh_routing_ctx * ctx, enum mesh_routing_trace_type type,
+                               uint8_t dst, uint8_t next_hop, uint8_t metric, uint8_t extra) {
+#if MESH_ROUTING_TRACE_SIZE > 0
+  if (atomic_load_explicit(&ctx->trace_enabled, memory_order_relaxed) == false) {
+    return;
   }
-  return NULL;
+
+  unsigned int head = atomic_fetch_add_explicit(&ctx->trace_head, 1, memory_order_relaxed);
+  unsigned int position = head % MESH_ROUTING_TRACE_SIZE;
+  struct mesh_routing_trace_event * event = &ctx->trace[position];
+
+  atomic_store_explicit(&ctx->trace_commit[position], 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  event->time = atomic_load_explicit(&ctx->trace_time, memory_order_relaxed);
+  event->type = type;
+  event->dst = dst;
+  event->next_hop = next_hop;
+  event->metric = metric;
+  event->extra = extra;
+  atomic_store_explicit(&ctx->trace_commit[position], head + 1, memory_order_release);
+#else
+  (void)ctx;
+  (void)type;
+  (void)dst;
+  (void)next_hop;
+  (void)metric;
+  (void)extra;
+#endif
 }
 
 /**
- * @brief Función para buscar un elemento libre dentro de la tabla de rutas para almacenar una nueva
- * ruta
+ * @brief Registra un cambio de una ruta de la tabla con su mejor camino y su número de secuencia
  *
- * @return struct neighbor_list* devuelve un puntero que apunta al elemento vacio
+ * @param type tipo de evento
+ * @param neighbor_aux elemento de la tabla de ruta
  */
-static struct neighbor_list * mesh_routing_get_free_element_in_table() {
-  for (uint8_t i = 0; i < MAX_NEIGHBOR; i++) {
-    if (neig_list[i].used == false) {
-      return &neig_list[i];
-    }
+static void mesh_routing_trace_route(struct mesh_routing_ctx * ctx,
+                                     enum mesh_routing_trace_type type,
+                                     const struct neighbor_list * neighbor_aux) {
+  if (neighbor_aux->path_count > 0) {
+    mesh_routing_trace(ctx, type, neighbor_aux->dst, neighbor_aux->paths[0].next_hop,
+                       neighbor_aux->paths[0].metric, neighbor_aux->seq);
+  } else {
+    mesh_routing_trace(ctx, type, neighbor_aux->dst, 0, 0, neighbor_aux->seq);
   }
-  return NULL;
 }
 
 /**
- * @brief Función para agregar un nueva ruta y su camino a la tabla de rutas
+ * @brief Compara dos números de secuencia de destino. La secuencia da la vuelta, por lo que se
+ * compara la diferencia con signo.
  *
- * @param neighbor_aux  elemento de la tabla de ruta
- * @param dst destino
- * @param next_hop próximo salto
- * @param metric métrica
+ * @param seq número de secuencia
+ * @param other número de secuencia con el que se compara
+ * @return true si seq es más nuevo que other
  */
-static void mesh_routing_add_element_first_in_table(struct neighbor_list * neighbor_aux,
-                                                    uint8_t dst, uint8_t next_hop, uint8_t metric) {
+static bool mesh_routing_seq_newer(uint8_t seq, uint8_t other) {
+  return (int8_t)(seq - other) > 0;
+}
 
-  neighbor_aux->used = true;
-  neighbor_aux->dst = dst;
-  neighbor_aux->metric = metric;
-  neighbor_aux->next_hop = next_hop;
-  neighbor_aux->time_out = false;
+/**
+ * @brief Indica si una posición está marcada en un mapa de bits de la tabla
+ *
+ * @param map mapa de bits
+ * @param slot posición de la tabla
+ * @return true si está marcada
+ */
+static bool mesh_routing_map_test(const uint32_t * map, uint8_t slot) {
+  return (map[slot / MAP_WORD_BITS] >> (slot % MAP_WORD_BITS)) & 1u;
 }
 
 /**
- * @brief Función para agregar un segundo camino a la tabla de rutas
+ * @brief Marca una posición en un mapa de bits de la tabla
  *
- * @param neighbor_aux elemento de la tabla de ruta
- * @param next_hop próximo salto
- * @param metric métrica
+ * @param map mapa de bits
+ * @param slot posición de la tabla
  */
-static void mesh_routing_add_element_second_in_table(struct neighbor_list * neighbor_aux,
-                                                     uint8_t next_hop, uint8_t metric) {
+static void mesh_routing_map_set(uint32_t * map, uint8_t slot) {
+  map[slot / MAP_WORD_BITS] |= 1u << (slot % MAP_WORD_BITS);
+}
 
-  neighbor_aux->second_used = true;
-  neighbor_aux->second_metric = metric;
-  neighbor_aux->second_next_hop = next_hop;
-  neighbor_aux->second_time_out = false;
+/**
+ * @brief Desmarca una posición en un mapa de bits de la tabla
+ *
+ * @param map mapa de bits
+ * @param slot posición de la tabla
+ */
+static void mesh_routing_map_clear(uint32_t * map, uint8_t slot) {
+  map[slot / MAP_WORD_BITS] &= ~(1u << (slot % MAP_WORD_BITS));
 }
 
 /**
- * @brief Funcion para pasar el segundo camino al primer camino y el primer camino al segundo
+ * @brief Busca la siguiente posición marcada en un mapa de bits de la tabla. Se revisa de a una
+ * palabra, por lo que las posiciones libres no tienen costo.
  *
- * @param neighbor_aux elemento de la talba de ruta
+ * @param map mapa de bits
+ * @param from primera posición a revisar
+ * @return int posición marcada, -1 si no hay más
  */
-static void
-mesh_routing_swap_first_element_in_table_to_second(struct neighbor_list * neighbor_aux) {
+static int mesh_routing_map_next(struct mesh_routing_ctx * ctx, const uint32_t * map, int from) {
+  int word = from / MAP_WORD_BITS;
+  int words = MESH_ROUTING_MAP_WORDS(ctx->neig_capacity);
 
-  uint8_t second_metric_aux, second_next_hop_aux;
-  second_metric_aux = neighbor_aux->second_metric;
-  second_next_hop_aux = neighbor_aux->second_next_hop;
-  neighbor_aux->second_metric = neighbor_aux->metric;
-  neighbor_aux->second_next_hop = neighbor_aux->next_hop;
-  neighbor_aux->metric = second_metric_aux;
-  neighbor_aux->next_hop = second_next_hop_aux;
+  if (word >= words) {
+    return -1;
+  }
+  uint32_t bits = map[word] >> (from % MAP_WORD_BITS);
+  if (bits != 0) {
+    return from + __builtin_ctz(bits);
+  }
+  while (++word < words) {
+    if (map[word] != 0) {
+      return word * MAP_WORD_BITS + __builtin_ctz(map[word]);
+    }
+  }
+  return -1;
 }
 
 /**
- * @brief Función para actualizar el timeout de las rutas para eliminar posibles rutas
- * desactualizadas
+ * @brief Busca la siguiente ruta de la tabla
  *
- * @param neighbor_aux elemento de la talba de ruta
- * @param next_hop próximo salto
- * @param metric métrica
+ * @param from primera posición a revisar
+ * @return int posición de la ruta, -1 si no hay más
  */
-static void mesh_routing_update_time_out(struct neighbor_list * neighbor_aux, uint8_t next_hop,
-                                         uint8_t metric) {
+static int mesh_routing_next_used(struct mesh_routing_ctx * ctx, int from) {
+  return mesh_routing_map_next(ctx, ctx->used_map, from);
+}
 
-  if (neighbor_aux->next_hop == next_hop && neighbor_aux->metric == metric) {
+/**
+ * @brief Devuelve la posición de un elemento en la tabla de rutas
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @return uint8_t posición
+ */
+static uint8_t mesh_routing_slot(struct mesh_routing_ctx * ctx,
+                                 const struct neighbor_list * neighbor_aux) {
+  return (uint8_t)(neighbor_aux - ctx->neig_list);
+}
 
-    neighbor_aux->time_out = false;
+/**
+ * @brief Función para buscar un elemento dentro de la tabla de rutas en base al destino
+ *
+ * @param dst destino a buscar
+ * @return struct neighbor_list* devuelve un puntero a la tabla de rutas correspondiente al destino
+ */
+static struct neighbor_list * mesh_routing_search_element_in_table(struct mesh_routing_ctx * ctx,
+                                                                   uint8_t dst) {
+  uint8_t slot = ctx->neig_index[dst];
 
-  } else if (neighbor_aux->second_next_hop == next_hop && neighbor_aux->second_metric == metric) {
-    neighbor_aux->second_time_out = false;
+  if (slot == INDEX_EMPTY) {
+    return NULL;
   }
+  return &ctx->neig_list[slot];
 }
 
 /**
- * @brief Función que permite agregar un rutas a determinado destino. Guarda hasta 2 caminos
- * posibles. Si recive una ruta con una menor métrica que la almacenada lo guarda en el primer lugar
- * y metrica anterior pasa a ser la segunda opción. Si recive una métrica mayor que la primera pero
- * menor que la segunda esta pasa a remplazar la segunda. Cuando se reciven las rutas ya almacenadas
- * se setea el time_out en false para evitar que se borren
+ * @brief Función para obtener un elemento libre dentro de la tabla de rutas para almacenar una
+ * nueva ruta. Se toma la primera posición libre del mapa de posiciones ocupadas. El elemento queda
+ * ocupado e indexado con el destino indicado.
  *
- * @param dst destino
- * @param next_hop próximo salto
- * @param metric métrica
+ * @param dst destino que se almacenará en el elemento
+ * @return struct neighbor_list* devuelve un puntero que apunta al elemento vacio, NULL si la tabla
+ * está llena
  */
-static void mesh_routing_add_neighbor(uint8_t dst, uint8_t next_hop, uint8_t metric) {
-
-  if ((dst == SRC_DIR || next_hop == SRC_DIR)) // si el dst o src es el mismo no hago nada
-    return;
+static struct neighbor_list * mesh_routing_get_free_element_in_table(struct mesh_routing_ctx * ctx,
+                                                                     uint8_t dst) {
+  if (ctx->free_slots_count == 0) {
+    return NULL;
+  }
 
-  struct neighbor_list * neig_search = mesh_routing_search_element_in_table(dst);
+  int word = 0;
+  while (ctx->used_map[word] == UINT32_MAX) {
+    word++; // hay posiciones libres, por lo que alguna palabra tiene un bit en 0
+  }
+  uint8_t slot = word * MAP_WORD_BITS + __builtin_ctz(~ctx->used_map[word]);
+
+  ctx->free_slots_count--;
+  mesh_routing_map_set(ctx->used_map, slot);
+  mesh_routing_map_clear(ctx->dirty_map, slot);
+  mesh_routing_map_clear(ctx->stale_map, slot);
+  ctx->neig_index[dst] = slot;
+  ctx->neig_list[slot].dst = dst;
+  ctx->neig_list[slot].path_count = 0;
+  return &ctx->neig_list[slot];
+}
 
-  if (neig_search == NULL) {
+/**
+ * @brief Elimina un elemento de la tabla de rutas
+ *
+ * @param dst destino a eliminar de la tabla de rutas
+ */
+static void mesh_routing_delete_neighbor(struct mesh_routing_ctx * ctx, uint8_t dst) {
 
-    struct neighbor_list * neighbor_aux = mesh_routing_get_free_element_in_table();
+  uint8_t slot = ctx->neig_index[dst];
 
-    mesh_routing_add_element_first_in_table(neighbor_aux, dst, next_hop, metric);
-    mesh_routing_update_time_out(neighbor_aux, next_hop, metric);
+  if (slot == INDEX_EMPTY) {
     return;
   }
 
-  if (neig_search->metric > metric) {
+  mesh_routing_map_clear(ctx->used_map, slot);
+  mesh_routing_map_clear(ctx->dirty_map, slot);
+  mesh_routing_map_clear(ctx->stale_map, slot);
+  ctx->neig_list[slot].path_count = 0;
+  ctx->neig_index[dst] = INDEX_EMPTY;
+  ctx->free_slots_count++;
+}
 
-    mesh_routing_swap_first_element_in_table_to_second(neig_search);
-    mesh_routing_add_element_first_in_table(neig_search, dst, next_hop, metric);
+/**
+ * @brief Genera un número pseudoaleatorio con un xorshift de 16 bits
+ *
+ * @return uint16_t número pseudoaleatorio
+ */
+static uint16_t mesh_routing_rand(struct mesh_routing_ctx * ctx) {
+  ctx->trickle.rand ^= ctx->trickle.rand << 7;
+  ctx->trickle.rand ^= ctx->trickle.rand >> 9;
+  ctx->trickle.rand ^= ctx->trickle.rand << 8;
+  return ctx->trickle.rand;
+}
 
-  } else if (neig_search->second_used == false || neig_search->second_metric > metric) {
+/**
+ * @brief Comienza un nuevo intervalo del modo adaptativo eligiendo al azar el paso en el que se
+ * anuncia, dentro de la segunda mitad del intervalo.
+ *
+ */
+static void mesh_routing_trickle_start_interval(struct mesh_routing_ctx * ctx) {
+  uint16_t half = ctx->trickle.interval / 2;
+  ctx->trickle.fire_at = half + 1 + mesh_routing_rand(ctx) % (ctx->trickle.interval - half);
+  ctx->trickle.ticks = 0;
+  ctx->trickle.counter = 0;
+}
 
-    mesh_routing_add_element_second_in_table(neig_search, next_hop, metric);
+/**
+ * @brief Vuelve el intervalo del modo adaptativo al mínimo ante una inconsistencia
+ *
+ */
+static void mesh_routing_trickle_reset(struct mesh_routing_ctx * ctx) {
+  if (ctx->trickle.enabled == true && ctx->trickle.interval > MESH_ROUTING_TRICKLE_IMIN) {
+    ctx->trickle.interval = MESH_ROUTING_TRICKLE_IMIN;
+    ctx->trickle.suppressed = 0;
+    mesh_routing_trickle_start_interval(ctx);
   }
+}
 
-  mesh_routing_update_time_out(neig_search, next_hop, metric);
+/**
+ * @brief Marca una ruta como modificada para que se incluya en el próximo anuncio
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ */
+static void mesh_routing_set_dirty(struct mesh_routing_ctx * ctx,
+                                   struct neighbor_list * neighbor_aux) {
+  mesh_routing_map_set(ctx->dirty_map, mesh_routing_slot(ctx, neighbor_aux));
+  ctx->triggered_pending = true;
+  mesh_routing_trickle_reset(ctx);
 }
 
 /**
- * @brief Elimina un elemento de la tabla de rutas
+ * @brief Devuelve la métrica con la que se anuncia una ruta, la de su mejor camino
  *
- * @param dst destino a eliminar de la tabla de rutas
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @return uint8_t métrica del mejor camino, METRIC_INFINITY si la ruta se perdió
+ */
+static uint8_t mesh_routing_element_metric(struct neighbor_list * neighbor_aux) {
+  if (neighbor_aux->path_count == 0) {
+    return METRIC_INFINITY;
+  }
+  return neighbor_aux->paths[0].metric;
+}
+
+/**
+ * @brief Función para liberar lugar en la tabla llena. Se elimina la ruta con peor métrica siempre
+ * que sea peor que la métrica de la ruta nueva. La ruta del propio nodo nunca se elimina.
+ *
+ * @param metric métrica de la ruta que se quiere agregar
+ * @return true si se liberó un elemento
  */
-static void mesh_routing_delete_neighbor(uint8_t dst) {
+static bool mesh_routing_evict_element_in_table(struct mesh_routing_ctx * ctx, uint8_t metric) {
+  struct neighbor_list * worst = NULL;
+
+  for (int i = mesh_routing_next_used(ctx, 0); i >= 0; i = mesh_routing_next_used(ctx, i + 1)) {
+    if (ctx->neig_list[i].dst != ctx->id &&
+        (worst == NULL ||
+         mesh_routing_element_metric(&ctx->neig_list[i]) > mesh_routing_element_metric(worst))) {
+      worst = &ctx->neig_list[i];
+    }
+  }
 
-  struct neighbor_list * neig_search = mesh_routing_search_element_in_table(dst);
+  if (worst == NULL || mesh_routing_element_metric(worst) <= metric) {
+    return false;
+  }
 
-  neig_search->used = false;
+  mesh_routing_delete_neighbor(ctx, worst->dst);
+  return true;
 }
 
 /**
- * @brief Busca el siguiente salto segun el destino
+ * @brief Función para buscar el camino que pasa por un vecino
  *
- * @param dst destino
- * @return uint8_t próximo salto
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param next_hop próximo salto
+ * @return int posición del camino, -1 si no hay camino por ese vecino
  */
-static uint8_t mesh_routing_search_next_hop(uint8_t dst) {
-  if (dst == BROADCAST_DIR) {
-    return BROADCAST_DIR;
+static int mesh_routing_search_path_in_table(struct neighbor_list * neighbor_aux,
+                                             uint8_t next_hop) {
+  for (int i = 0; i < neighbor_aux->path_count; i++) {
+    if (neighbor_aux->paths[i].next_hop == next_hop) {
+      return i;
+    }
   }
+  return -1;
+}
 
-  struct neighbor_list * neig_search = mesh_routing_search_element_in_table(dst);
-  if (neig_search == NULL) {
-    return UNREACHABLE_DIR;
-  } else {
-    return neig_search->next_hop;
+/**
+ * @brief Función para quitar un camino de la ruta manteniendo el orden del resto
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param position posición del camino a quitar
+ */
+static void mesh_routing_remove_path_in_table(struct neighbor_list * neighbor_aux, int position) {
+  for (int i = position; i + 1 < neighbor_aux->path_count; i++) {
+    neighbor_aux->paths[i] = neighbor_aux->paths[i + 1];
   }
+  neighbor_aux->path_count--;
 }
 
 /**
- * @brief Setea el campo time_out en true en la tabla de rutas
+ * @brief Función para agregar un camino a la ruta en orden de métrica, después de los caminos de
+ * igual métrica. Si ya hay MESH_ROUTING_MAX_PATHS caminos, el nuevo reemplaza al peor solo si lo
+ * mejora.
  *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param next_hop próximo salto
+ * @param metric métrica
+ * @param deadline paso del handler en el que vence el camino
  */
-static void mesh_routing_set_time_out_true() {
-  for (int i = 0; i < MAX_NEIGHBOR; i++) {
-    if (neig_list[i].used == true && neig_list[i].dst != SRC_DIR) {
-      neig_list[i].time_out = true;
-      if (neig_list[i].second_used == true) {
-        neig_list[i].second_time_out = true;
-      }
+static void mesh_routing_add_path_in_table(struct neighbor_list * neighbor_aux, uint8_t next_hop,
+                                           uint8_t metric, uint16_t deadline) {
+  int position = neighbor_aux->path_count;
+
+  if (position == MESH_ROUTING_MAX_PATHS) {
+    if (neighbor_aux->paths[position - 1].metric <= metric) {
+      return;
     }
+    position--; // se descarta el peor camino
+  } else {
+    neighbor_aux->path_count++;
+  }
+
+  while (position > 0 && neighbor_aux->paths[position - 1].metric > metric) {
+    neighbor_aux->paths[position] = neighbor_aux->paths[position - 1];
+    position--;
   }
+  neighbor_aux->paths[position].next_hop = next_hop;
+  neighbor_aux->paths[position].metric = metric;
+  neighbor_aux->paths[position].deadline = deadline;
 }
 
 /**
- * @brief Elimina un elemento de la tabla de ruta por debido a que expiro el timeout
+ * @brief Marca la ruta para anunciarse si cambió la métrica de su mejor camino o si se quedó sin
+ * caminos. Una ruta sin caminos se mantiene en la tabla hasta que se anuncie como perdida y luego
+ * se elimina.
  *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param old_metric métrica de la ruta antes de la modificación
  */
-static void mesh_routing_delete_item_due_to_timeout() {
+static void mesh_routing_update_element_in_table(struct mesh_routing_ctx * ctx,
+                                                 struct neighbor_list * neighbor_aux,
+                                                 uint8_t old_metric) {
+  if (mesh_routing_element_metric(neighbor_aux) != old_metric) {
+    mesh_routing_set_dirty(ctx, neighbor_aux);
+  }
+}
 
-  for (int i = 0; i < MAX_NEIGHBOR; i++) {
-    if (neig_list[i].used == true && neig_list[i].dst != SRC_DIR && neig_list[i].time_out == true) {
-      if (neig_list[i].second_used == false || neig_list[i].second_time_out == true) {
-        mesh_routing_delete_neighbor(neig_list[i].dst);
-      } else {
-        mesh_routing_swap_first_element_in_table_to_second(&neig_list[i]);
-        neig_list[i].second_used = false;
-        neig_list[i].used = true;
-        // mesh_app_process_msg(NULL);
-      }
+/**
+ * @brief Indica si ya llegó un paso del handler. El reloj de pasos da la vuelta, por lo que se
+ * compara la diferencia con signo.
+ *
+ * @param time paso del handler
+ * @return true si el paso ya llegó
+ */
+static bool mesh_routing_time_reached(struct mesh_routing_ctx * ctx, uint16_t time) {
+  return (int16_t)(ctx->now - time) >= 0;
+}
+
+/**
+ * @brief Devuelve el vencimiento más próximo entre los caminos de una ruta
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @return uint16_t paso del handler en el que vence el primero de sus caminos, o en el que termina
+ * la retención si la ruta está perdida
+ */
+static uint16_t mesh_routing_element_deadline(struct neighbor_list * neighbor_aux) {
+  uint16_t deadline = neighbor_aux->paths[0].deadline;
+
+  for (int i = 1; i < neighbor_aux->path_count; i++) {
+    if ((int16_t)(neighbor_aux->paths[i].deadline - deadline) < 0) {
+      deadline = neighbor_aux->paths[i].deadline;
     }
   }
+  return deadline;
 }
 
 /**
- * @brief Elimina toda la tabla de ruta poniendo el campo used y second use en false
+ * @brief Enlaza una ruta en la posición de la rueda de tiempos que le corresponde. El primer nivel
+ * tiene una posición por paso de la vuelta actual y el segundo una posición por vuelta del primero,
+ * hasta WHEEL_SPAN pasos. Un vencimiento más lejano se ubica en la última vuelta y se vuelve a
+ * ubicar cuando llega.
  *
+ * @param slot posición de la ruta en la tabla
+ * @param at paso del handler en el que se debe revisar la ruta, no anterior al actual
  */
-static void mesh_routing_erase_routing_table() {
+static void mesh_routing_timer_link(struct mesh_routing_ctx * ctx, uint8_t slot, uint16_t at) {
+  uint8_t * head;
 
-  for (uint8_t i = 0; i < MAX_NEIGHBOR; i++) {
-    neig_list[i].used = false;
-    neig_list[i].second_used = false;
+  if (at / WHEEL_SLOTS == ctx->now / WHEEL_SLOTS) {
+    head = &ctx->wheel[0][at % WHEEL_SLOTS];
+  } else if ((uint16_t)(at - ctx->now) < WHEEL_SPAN) {
+    head = &ctx->wheel[1][(at / WHEEL_SLOTS) % WHEEL_SLOTS];
+  } else {
+    head = &ctx->wheel[1][(ctx->now / WHEEL_SLOTS) % WHEEL_SLOTS];
   }
+  ctx->neig_list[slot].timer_next = *head;
+  *head = slot;
 }
 
 /**
- * @brief Función que envía la información de toda las rutas alcanzadas con el siguiente formato:
- * {dst, next_hop (él mismo), metric}.
+ * @brief Ubica una ruta en la rueda de tiempos. La posición del paso actual ya se revisó, por lo
+ * que un vencimiento que ya llegó se revisa en el paso siguiente y no una vuelta después.
  *
+ * @param slot posición de la ruta en la tabla
+ * @param at paso del handler en el que se debe revisar la ruta
  */
-static void mesh_routing_send_neighbor() {
-
-  struct msg msg_send;
-  msg_send.dst = BROADCAST_DIR;
-  msg_send.src = SRC_DIR;
-  msg_send.opcode = RCV_NEIGHBOR_OPCODE;
+static void mesh_routing_timer_insert(struct mesh_routing_ctx * ctx, uint8_t slot, uint16_t at) {
+  if (mesh_routing_time_reached(ctx, at) == true) {
+    at = ctx->now + 1;
+  }
+  mesh_routing_timer_link(ctx, slot, at);
+}
 
-  uint8_t j = 0;
+/**
+ * @brief Agrega una ruta a la rueda de tiempos si todavía no está. Como todos los caminos vencen a
+ * la misma cantidad de pasos de su último anuncio, un camino nuevo nunca vence antes que la
+ * posición que la ruta ya tiene en la rueda.
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ */
+static void mesh_routing_timer_arm(struct mesh_routing_ctx * ctx,
+                                   struct neighbor_list * neighbor_aux) {
+  uint8_t slot = mesh_routing_slot(ctx, neighbor_aux);
 
-  for (int i = 0; i < MAX_NEIGHBOR; i++) {
-    if (neig_list[i].used == true) {
-      msg_send.msg[j] = i;
-      msg_send.msg[j + 1] = SRC_DIR;
-      msg_send.msg[j + 2] = neig_list[i].metric;
-      j = j + 3;
-    }
+  if (mesh_routing_map_test(ctx->armed_map, slot) == false && neighbor_aux->dst != ctx->id) {
+    mesh_routing_map_set(ctx->armed_map, slot);
+    mesh_routing_timer_insert(ctx, slot, mesh_routing_element_deadline(neighbor_aux));
   }
+}
 
-  msg_send.lenght = j + 3;
+/**
+ * @brief Marca como perdida una ruta que se quedó sin caminos. Como en DSDV el número de secuencia
+ * pasa a ser impar, más nuevo que el de los anuncios que llevaron a la ruta, y la ruta se retiene
+ * durante la vida de un camino para que los vecinos reciban la pérdida antes que cualquier anuncio
+ * viejo que la vuelva a agregar.
+ *
+ * @param neighbor_aux elemento de la tabla de ruta, sin caminos
+ */
+static void mesh_routing_element_lost(struct mesh_routing_ctx * ctx,
+                                      struct neighbor_list * neighbor_aux) {
+  neighbor_aux->seq |= 1;
+  neighbor_aux->paths[0].deadline = ctx->now + ctx->route_lifetime;
+}
 
-  mesh_conn_send_msg(BROADCAST_DIR, (uint8_t *)&msg_send);
+/**
+ * @brief Elimina una ruta restaurada que ningún vecino confirmó. Como el nodo nunca la anunció no
+ * se anuncia como perdida.
+ *
+ * @param slot posición de la ruta en la tabla
+ */
+static void mesh_routing_stale_drop(struct mesh_routing_ctx * ctx, uint8_t slot) {
+  mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_ROUTE_EXPIRE, &ctx->neig_list[slot]);
+  mesh_routing_map_clear(ctx->armed_map, slot);
+  mesh_routing_table_write_begin(ctx);
+  mesh_routing_delete_neighbor(ctx, ctx->neig_list[slot].dst);
+  mesh_routing_table_write_end(ctx);
+  mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ROUTES_EXPIRED, 1);
 }
 
 /**
- * @brief Función que agrega elementos a la tabla de rutas.
+ * @brief Revisa una ruta cuya posición de la rueda venció. Quita los caminos vencidos; si el mejor
+ * camino vence el siguiente pasa a ser el principal, y si no queda ninguno la ruta se marca como
+ * perdida. Una ruta perdida que ya se anunció se elimina al terminar su retención. Una ruta
+ * restaurada que ningún vecino confirmó se elimina sin anunciarse cuando vencen sus caminos o
+ * cuando pasa stale_deadline. Refrescar un camino solo mueve su vencimiento, por lo que la
+ * posición puede vencer antes que los caminos; en ese caso la ruta se vuelve a ubicar en la rueda.
  *
- * @param p_neighbor puntero con las rutas a agregar con el siguiente formato {destino, next_hop,
- * metrica}. Por ejemplo si se quiere agregar que el destino 9 se llega a traves de 3 con métrica 3
- * y al destino 5 a través de 10 con metrica 1 se debe enviar con el siguiente formato: uint8_t[] =
- * {9,3,3,5,10,1}
- * @param len largo del mensaje. En el ejemplo 6.
+ * @param slot posición de la ruta en la tabla
  */
-static void mesh_routing_add_neig_msg(uint8_t * p_neighbor, uint8_t len) {
+static void mesh_routing_timer_expire(struct mesh_routing_ctx * ctx, uint8_t slot) {
+  struct neighbor_list * neighbor_aux = &ctx->neig_list[slot];
+
+  if (mesh_routing_map_test(ctx->used_map, slot) == false || neighbor_aux->dst == ctx->id) {
+    mesh_routing_map_clear(ctx->armed_map, slot);
+    return; // la ruta se eliminó después de ubicarse en la rueda
+  }
+  if (mesh_routing_map_test(ctx->stale_map, slot) == true &&
+      mesh_routing_time_reached(ctx, ctx->stale_deadline) == true) {
+    mesh_routing_stale_drop(ctx, slot);
+    return;
+  }
 
-  for (uint8_t i = 0; i < len; i = i + 3) {
+  if (neighbor_aux->path_count == 0) {
+    if (mesh_routing_time_reached(ctx, neighbor_aux->paths[0].deadline) == true) {
+      if (mesh_routing_map_test(ctx->dirty_map, slot) == false) {
+        mesh_routing_map_clear(ctx->armed_map, slot);
+        mesh_routing_table_write_begin(ctx);
+        mesh_routing_delete_neighbor(ctx, neighbor_aux->dst);
+        mesh_routing_table_write_end(ctx);
+        return;
+      }
+      neighbor_aux->paths[0].deadline = ctx->now + 1; // falta anunciarla
+    }
+  } else if (mesh_routing_time_reached(ctx, mesh_routing_element_deadline(neighbor_aux)) == true) {
+    uint8_t old_metric = mesh_routing_element_metric(neighbor_aux);
+    bool best_expired = mesh_routing_time_reached(ctx, neighbor_aux->paths[0].deadline);
+
+    mesh_routing_table_write_begin(ctx);
+    for (int j = neighbor_aux->path_count - 1; j >= 0; j--) {
+      if (mesh_routing_time_reached(ctx, neighbor_aux->paths[j].deadline) == true) {
+        mesh_routing_remove_path_in_table(neighbor_aux, j);
+      }
+    }
+    mesh_routing_table_write_end(ctx);
 
-    mesh_routing_add_neighbor(p_neighbor[i], p_neighbor[i + 1], p_neighbor[i + 2] + 1);
+    if (neighbor_aux->path_count == 0 && mesh_routing_map_test(ctx->stale_map, slot) == true) {
+      mesh_routing_stale_drop(ctx, slot);
+      return;
+    }
+    if (neighbor_aux->path_count == 0) {
+      mesh_routing_element_lost(ctx, neighbor_aux);
+      mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ROUTES_EXPIRED, 1);
+      mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_ROUTE_EXPIRE, neighbor_aux);
+    } else if (best_expired == true) {
+      mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_PATH_SWAPS, 1);
+      mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_PATH_SWAP, neighbor_aux);
+    }
+    mesh_routing_update_element_in_table(ctx, neighbor_aux, old_metric);
   }
+  mesh_routing_timer_insert(ctx, slot, mesh_routing_element_deadline(neighbor_aux)); // sigue armada
 }
 
 /**
- * @brief El msg es para la capa routing. Procesa el mensaje segun el OPCODE. OPCODE SEND_NEIGBOR =
- * mensaje donde estan las rutas alcanzadas por determinado vecino.
+ * @brief Avanza un paso el reloj de la rueda de tiempos y revisa las rutas de la posición que
+ * vence. Al comenzar cada vuelta del primer nivel las rutas de la posición correspondiente del
+ * segundo nivel se reparten en el primero. El costo depende de las rutas que vencen y no del tamaño
+ * de la tabla.
  *
- * @param msg puntero al msg a procesar
  */
-static void mesh_routing_process_msg(uint8_t * msg) {
+static void mesh_routing_timer_tick(struct mesh_routing_ctx * ctx) {
+  uint8_t slot;
+
+  ctx->now++;
+#if MESH_ROUTING_TRACE_SIZE > 0
+  atomic_store_explicit(&ctx->trace_time, ctx->now, memory_order_relaxed);
+#endif
+  if (ctx->now % WHEEL_SLOTS == 0) {
+    uint8_t * head = &ctx->wheel[1][(ctx->now / WHEEL_SLOTS) % WHEEL_SLOTS];
+    slot = *head;
+    *head = INDEX_EMPTY;
+    while (slot != INDEX_EMPTY) {
+      uint8_t next = ctx->neig_list[slot].timer_next;
+      if (mesh_routing_map_test(ctx->used_map, slot) == true) {
+        uint16_t at = mesh_routing_element_deadline(&ctx->neig_list[slot]);
+        if ((int16_t)(at - ctx->now) < 0) {
+          at = ctx->now; // la posición del paso actual se revisa a continuación
+        }
+        mesh_routing_timer_link(ctx, slot, at);
+      } else {
+        mesh_routing_map_clear(ctx->armed_map, slot);
+      }
+      slot = next;
+    }
+  }
 
-  switch (msg[OPCODE]) {
+  uint8_t * head = &ctx->wheel[0][ctx->now % WHEEL_SLOTS];
+  slot = *head;
+  *head = INDEX_EMPTY;
+  while (slot != INDEX_EMPTY) {
+    uint8_t next = ctx->neig_list[slot].timer_next;
+    mesh_routing_timer_expire(ctx, slot);
+    slot = next;
+  }
+}
 
-  case RCV_NEIGHBOR_OPCODE:
-    mesh_routing_add_neig_msg(&msg[MSG], msg[LENGHT]);
-    break;
+/**
+ * @brief Devuelve cuántos pasos del handler pasan sin que venza ninguna posición de la rueda
+ *
+ * @return uint16_t pasos sin vencimientos, UINT16_MAX si la rueda está vacía
+ */
+static uint16_t mesh_routing_timer_idle_ticks(struct mesh_routing_ctx * ctx) {
+  uint16_t time = ctx->now + 1;
 
-  default:
-    break;
+  for (; time % WHEEL_SLOTS != 0; time++) {
+    if (ctx->wheel[0][time % WHEEL_SLOTS] != INDEX_EMPTY) {
+      return time - ctx->now - 1;
+    }
+  }
+  for (int i = 0; i < WHEEL_SLOTS; i++, time = time + WHEEL_SLOTS) {
+    if (ctx->wheel[1][(time / WHEEL_SLOTS) % WHEEL_SLOTS] != INDEX_EMPTY) {
+      return time - ctx->now - 1;
+    }
   }
+  return UINT16_MAX;
 }
 
 /**
- * @brief Función que rutea el mensaje poniendo el próximo salto en el campo NEXT_HOP del msg en
- * caso que el msg no sea para él mismo.
+ * @brief Vuelve a armar la rueda de tiempos con todas las rutas. Se usa cuando se acorta la vida
+ * de los caminos, ya que los vencimientos que superan la nueva vida se recortan.
  *
- * @param msg puntero al msg a rutear
  */
-static void mesh_routing_routing_msg(uint8_t * msg) {
+static void mesh_routing_timer_rebuild(struct mesh_routing_ctx * ctx) {
+  for (int level = 0; level < 2; level++) {
+    for (int i = 0; i < WHEEL_SLOTS; i++) {
+      ctx->wheel[level][i] = INDEX_EMPTY;
+    }
+  }
 
-  if (msg[DST] == SRC_DIR || msg[DST] == BROADCAST_DIR) {
-    mesh_app_process_msg(msg);
-  } else {
-    uint8_t next_hop = mesh_routing_search_next_hop(msg[DST]);
-    if (next_hop != UNREACHABLE_DIR) {
-      msg[NEXT_HOP] = next_hop;
-      mesh_conn_send_msg(next_hop, msg);
+  memset(ctx->armed_map, 0, MESH_ROUTING_MAP_WORDS(ctx->neig_capacity) * sizeof(uint32_t));
+
+  uint16_t max_deadline = ctx->now + ctx->route_lifetime;
+  for (int i = mesh_routing_next_used(ctx, 0); i >= 0; i = mesh_routing_next_used(ctx, i + 1)) {
+    int count = ctx->neig_list[i].path_count > 0 ? ctx->neig_list[i].path_count : 1; // retención
+    for (int j = 0; j < count; j++) {
+      if ((int16_t)(ctx->neig_list[i].paths[j].deadline - max_deadline) > 0) {
+        ctx->neig_list[i].paths[j].deadline = max_deadline;
+      }
     }
+    mesh_routing_timer_arm(ctx, &ctx->neig_list[i]);
   }
 }
 
-/* === Public function implementation ========================================================== */
-
-void mesh_routing_init(void) {
+/**
+ * @brief Atiende un anuncio de la ruta hacia el propio nodo. Si trae un número de secuencia más
+ * nuevo que el propio, porque un vecino perdió la ruta o porque el nodo se reinició, el nodo pasa
+ * al siguiente número par y se anuncia para que el resto vuelva a aceptar su ruta.
+ *
+ * @param seq número de secuencia anunciado
+ */
+static void mesh_routing_own_seq(struct mesh_routing_ctx * ctx, uint8_t seq) {
+  struct neighbor_list * own = mesh_routing_search_element_in_table(ctx, ctx->id);
 
-  mesh_routing_erase_routing_table();
-  struct neighbor_list * neighbor_aux = mesh_routing_get_free_element_in_table();
-  neighbor_aux->used = true;
-  neighbor_aux->dst = SRC_DIR;
-  neighbor_aux->next_hop = SRC_DIR;
-  neighbor_aux->metric = 0;
+  if (mesh_routing_seq_newer(seq, own->seq) == true) {
+    own->seq = (seq | 1) + 1;
+    mesh_routing_set_dirty(ctx, own);
+  }
 }
 
-void mesh_routing_send_msg(uint8_t * msg) {
+/**
+ * @brief Función que permite agregar un rutas a determinado destino. Guarda hasta
+ * MESH_ROUTING_MAX_PATHS caminos posibles ordenados por métrica. Si recive un camino por un vecino
+ * que ya tiene un camino guardado se actualiza su métrica. Si recive un camino nuevo se agrega en
+ * su lugar según la métrica, descartando el peor si no hay lugar. Cuando se reciven los caminos ya
+ * almacenados se posterga su vencimiento. Si la métrica es infinita
+ * el vecino perdió la ruta y se quita el camino que pasa por él. Cuando cambia la métrica del
+ * mejor camino la ruta se marca para anunciarse. Un anuncio con un número de secuencia más viejo
+ * que el de la ruta se descarta, y uno más nuevo reemplaza a todos los caminos conocidos.
+ *
+ * @param dst destino
+ * @param next_hop próximo salto
+ * @param metric métrica
+ * @param seq número de secuencia del destino
+ */
+static void mesh_routing_add_neighbor(struct mesh_routing_ctx * ctx, uint8_t dst, uint8_t next_hop,
+                                      uint8_t metric, uint8_t seq) {
 
-  if (msg[OPCODE] >= OPCODE_ROUTING_MIN && msg[OPCODE] <= OPCODE_ROUTING_MAX) {
-    mesh_routing_process_msg(msg);
+  if (dst == ctx->id) {
+    mesh_routing_own_seq(ctx, seq);
+    return;
+  }
+  if (next_hop == ctx->id) {
+    return;
+  }
 
-  } else {
-    mesh_routing_routing_msg(msg);
+  uint16_t deadline = ctx->now + ctx->route_lifetime;
+
+  struct neighbor_list * neig_search = mesh_routing_search_element_in_table(ctx, dst);
+
+  if (neig_search == NULL) {
+
+    if (metric == METRIC_INFINITY) {
+      return;
+    }
+
+    if (ctx->free_slots_count == 0 && mesh_routing_evict_element_in_table(ctx, metric) == false) {
+      return; // tabla llena y la ruta nueva no mejora a ninguna
+    }
+
+    struct neighbor_list * neighbor_aux = mesh_routing_get_free_element_in_table(ctx, dst);
+
+    neighbor_aux->seq = seq;
+    mesh_routing_add_path_in_table(neighbor_aux, next_hop, metric, deadline);
+    mesh_routing_timer_arm(ctx, neighbor_aux);
+    mesh_routing_set_dirty(ctx, neighbor_aux);
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ROUTES_ADDED, 1);
+    mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_ROUTE_ADD, neighbor_aux);
+    return;
   }
-}
 
-void mesh_routing_handler_time_out() {
-  static uint8_t paso = 0;
-  switch (paso) {
-  case 0:
-    mesh_routing_send_neighbor();
-    paso = 1;
-    break;
+  if (mesh_routing_seq_newer(neig_search->seq, seq) == true) {
+    return; // información más vieja que la de la tabla
+  }
+  mesh_routing_map_clear(ctx->stale_map, mesh_routing_slot(ctx, neig_search));
+
+  uint8_t old_metric = mesh_routing_element_metric(neig_search);
+  int position = -1;
+
+  if (neig_search->seq != seq) {
+    neig_search->seq = seq; // los caminos conocidos quedan viejos
+    neig_search->path_count = 0;
+  } else {
+    position = mesh_routing_search_path_in_table(neig_search, next_hop);
+  }
+
+  if (position >= 0 && neig_search->paths[position].metric == metric) {
+    neig_search->paths[position].deadline = deadline;
+    return;
+  }
+
+  if (position >= 0) {
+    mesh_routing_remove_path_in_table(neig_search, position);
+  }
+  if (metric != METRIC_INFINITY) {
+    mesh_routing_add_path_in_table(neig_search, next_hop, metric, deadline);
+  } else if (neig_search->path_count == 0 && old_metric != METRIC_INFINITY) {
+    mesh_routing_element_lost(ctx, neig_search);
+    mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_ROUTE_EXPIRE, neig_search);
+  }
+  mesh_routing_timer_arm(ctx, neig_search);
+
+  if (position == 0 && neig_search->path_count > 0 && neig_search->paths[0].next_hop != next_hop) {
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_PATH_SWAPS, 1);
+    mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_PATH_SWAP, neig_search);
+  }
+  mesh_routing_update_element_in_table(ctx, neig_search, old_metric);
+}
+
+/**
+ * @brief Evita que expiren los caminos que pasan por un vecino del que se recibió un anuncio. Como
+ * los anuncios periódicos solo llevan las rutas modificadas, recibir un anuncio del vecino indica
+ * que el resto de sus rutas sigue vigente.
+ *
+ * @param next_hop vecino que envió el anuncio
+ */
+static void mesh_routing_refresh_next_hop(struct mesh_routing_ctx * ctx, uint8_t next_hop) {
+
+  // se saltean las palabras sin rutas y dentro de cada palabra se corta en la última ruta
+  for (int w = 0; w < MESH_ROUTING_MAP_WORDS(ctx->neig_capacity); w++) {
+    int i = w * MAP_WORD_BITS;
+    for (uint32_t bits = ctx->used_map[w]; bits != 0; bits >>= 1, i++) {
+      if ((bits & 1u) == 0) {
+        continue;
+      }
+      int position = mesh_routing_search_path_in_table(&ctx->neig_list[i], next_hop);
+      if (position >= 0) {
+        ctx->neig_list[i].paths[position].deadline = ctx->now + ctx->route_lifetime;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Inicializa la calidad del enlace con un vecino, sin muestras y sin pérdidas
+ *
+ * @param link enlace a inicializar
+ * @param neighbor id del vecino
+ */
+static void mesh_routing_link_reset(struct mesh_routing_ctx * ctx, struct mesh_routing_link * link,
+                                    uint8_t neighbor) {
+  link->neighbor = neighbor;
+  link->delivery = LINK_DELIVERY_FULL;
+  link->rssi = 0;
+  link->rssi_valid = false;
+  link->cost = ctx->link_cost(link);
+}
+
+/**
+ * @brief Busca la calidad del enlace con un vecino
+ *
+ * @param neighbor id del vecino
+ * @return struct mesh_routing_link* enlace, NULL si no hay muestras del vecino
+ */
+static struct mesh_routing_link * mesh_routing_search_link(struct mesh_routing_ctx * ctx,
+                                                           uint8_t neighbor) {
+  for (int i = 0; i < MESH_ROUTING_MAX_LINKS; i++) {
+    if (ctx->links[i].neighbor == neighbor) {
+      return &ctx->links[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Busca la calidad del enlace con un vecino y si no existe la agrega. Si no hay lugar se
+ * reemplazan los enlaces en orden circular.
+ *
+ * @param neighbor id del vecino
+ * @return struct mesh_routing_link* enlace
+ */
+static struct mesh_routing_link * mesh_routing_get_link(struct mesh_routing_ctx * ctx,
+                                                        uint8_t neighbor) {
+  struct mesh_routing_link * link = mesh_routing_search_link(ctx, neighbor);
+
+  if (link == NULL) {
+    link = mesh_routing_search_link(ctx, NULL_DIR);
+  }
+  if (link == NULL) {
+    link = &ctx->links[ctx->links_next];
+    ctx->links_next = (ctx->links_next + 1) % MESH_ROUTING_MAX_LINKS;
+  }
+  if (link->neighbor != neighbor) {
+    mesh_routing_link_reset(ctx, link, neighbor);
+  }
+  return link;
+}
+
+/**
+ * @brief Devuelve el costo del enlace con un vecino, el de un enlace sin pérdidas si todavía no
+ * hay muestras del vecino
+ *
+ * @param neighbor id del vecino
+ * @return uint8_t costo del enlace
+ */
+static uint8_t mesh_routing_link_cost(struct mesh_routing_ctx * ctx, uint8_t neighbor) {
+  struct mesh_routing_link * link = mesh_routing_search_link(ctx, neighbor);
+  struct mesh_routing_link fresh;
+
+  if (link == NULL) {
+    mesh_routing_link_reset(ctx, &fresh, neighbor);
+    link = &fresh;
+  }
+  return link->cost;
+}
+
+/**
+ * @brief Recalcula el costo de un enlace luego de una muestra. Si cambió al menos
+ * MESH_ROUTING_LINK_HYSTERESIS se corrige la métrica de los caminos que pasan por el vecino; si no,
+ * se mantiene el costo anterior para que las rutas no oscilen.
+ *
+ * @param link enlace con el vecino
+ */
+static void mesh_routing_link_update(struct mesh_routing_ctx * ctx,
+                                     struct mesh_routing_link * link) {
+  int delta = (int)ctx->link_cost(link) - link->cost;
+
+  if (delta > -MESH_ROUTING_LINK_HYSTERESIS && delta < MESH_ROUTING_LINK_HYSTERESIS) {
+    return;
+  }
+  link->cost = (uint8_t)(link->cost + delta);
+
+  mesh_routing_table_write_begin(ctx);
+  for (int i = mesh_routing_next_used(ctx, 0); i >= 0; i = mesh_routing_next_used(ctx, i + 1)) {
+    struct neighbor_list * neighbor_aux = &ctx->neig_list[i];
+    int position = mesh_routing_search_path_in_table(neighbor_aux, link->neighbor);
+    if (position < 0) {
+      continue;
+    }
+
+    uint8_t old_metric = mesh_routing_element_metric(neighbor_aux);
+    struct route_path path = neighbor_aux->paths[position];
+    int metric = path.metric + delta;
+
+    if (metric < 1) {
+      metric = 1;
+    } else if (metric >= METRIC_INFINITY) {
+      metric = METRIC_INFINITY - 1;
+    }
+    mesh_routing_remove_path_in_table(neighbor_aux, position);
+    mesh_routing_add_path_in_table(neighbor_aux, path.next_hop, (uint8_t)metric, path.deadline);
+    if (position == 0 && neighbor_aux->paths[0].next_hop != path.next_hop) {
+      mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_PATH_SWAPS, 1);
+      mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_PATH_SWAP, neighbor_aux);
+    }
+    mesh_routing_update_element_in_table(ctx, neighbor_aux, old_metric);
+  }
+  mesh_routing_table_write_end(ctx);
+}
+
+/**
+ * @brief Calcula el hash de un flujo a partir de su origen, destino y opcode. Todos los msg de un
+ * mismo flujo tienen el mismo hash y por lo tanto siguen el mismo camino, manteniendo su orden.
+ *
+ * @param msg msg a rutear
+ * @return uint8_t hash del flujo
+ */
+static uint8_t mesh_routing_flow_hash(uint8_t * msg) {
+  uint16_t hash = msg[SRC];
+  hash = hash * 31 + msg[DST];
+  hash = hash * 31 + msg[OPCODE];
+  hash ^= hash >> 7;
+  return (uint8_t)(hash ^ (hash >> 8));
+}
+
+/**
+ * @brief Busca el siguiente salto segun el destino. Si hay varios caminos con la misma métrica que
+ * el mejor, o que lo superan en hasta MESH_ROUTING_MULTIPATH_TOLERANCE, se elige uno de ellos
+ * según el hash del flujo.
+ *
+ * @param dst destino
+ * @param flow_hash hash del flujo al que pertenece el msg
+ * @param metric métrica del mejor camino, METRIC_INFINITY si no se alcanza el destino
+ * @return uint8_t próximo salto
+ */
+static uint8_t mesh_routing_search_next_hop(struct mesh_routing_ctx * ctx, uint8_t dst,
+                                            uint8_t flow_hash, uint8_t * metric) {
+  *metric = METRIC_INFINITY;
+
+  if (dst == BROADCAST_DIR) {
+    return BROADCAST_DIR;
+  }
+
+  struct neighbor_list * neig_search = mesh_routing_search_element_in_table(ctx, dst);
+  if (neig_search == NULL || neig_search->path_count == 0) {
+    return UNREACHABLE_DIR;
+  }
+
+  *metric = neig_search->paths[0].metric;
+
+  uint16_t max_metric = neig_search->paths[0].metric + MESH_ROUTING_MULTIPATH_TOLERANCE;
+  uint8_t candidates = 1;
+  while (candidates < neig_search->path_count &&
+         neig_search->paths[candidates].metric <= max_metric) {
+    candidates++;
+  }
+
+  return neig_search->paths[flow_hash % candidates].next_hop;
+}
+
+/**
+ * @brief Lee de la tabla de rutas el próximo salto y la métrica hacia un destino sin tomar ningún
+ * lock. Si la tabla se modificó durante la lectura, la lectura se repite, por lo que el próximo
+ * salto y la métrica siempre corresponden a un mismo estado de la tabla.
+ *
+ * @param dst destino
+ * @param flow_hash hash del flujo al que pertenece el msg
+ * @param metric métrica del mejor camino, METRIC_INFINITY si no se alcanza el destino
+ * @return uint8_t próximo salto
+ */
+static uint8_t mesh_routing_read_next_hop(struct mesh_routing_ctx * ctx, uint8_t dst,
+                                          uint8_t flow_hash, uint8_t * metric) {
+  unsigned int seq;
+  uint8_t next_hop;
+  uint32_t start = mesh_port_cycles();
+
+  do {
+    seq = atomic_load_explicit(&ctx->table_seq, memory_order_acquire);
+    next_hop = mesh_routing_search_next_hop(ctx, dst, flow_hash, metric);
+    atomic_thread_fence(memory_order_acquire);
+  } while ((seq & 1) != 0 || atomic_load_explicit(&ctx->table_seq, memory_order_relaxed) != seq);
+
+  uint32_t cycles = mesh_port_cycles() - start;
+  uint8_t bucket = 0;
+  while (bucket < MESH_ROUTING_LATENCY_BUCKETS - 1 &&
+         cycles >= ((uint32_t)MESH_ROUTING_LATENCY_BASE << bucket)) {
+    bucket++;
+  }
+  atomic_fetch_add_explicit(&ctx->lookup_latency[bucket], 1, memory_order_relaxed);
+
+  return next_hop;
+}
+
+/**
+ * @brief Elimina toda la tabla de ruta limpiando los mapas de bits, vacía el índice de destinos y
+ * la rueda de tiempos y deja todas las posiciones como libres. El costo depende de la cantidad de
+ * palabras de los mapas y no de la cantidad de rutas.
+ *
+ */
+static void mesh_routing_erase_routing_table(struct mesh_routing_ctx * ctx) {
+
+  size_t map_size = MESH_ROUTING_MAP_WORDS(ctx->neig_capacity) * sizeof(uint32_t);
+
+  memset(ctx->used_map, 0, map_size);
+  memset(ctx->dirty_map, 0, map_size);
+  memset(ctx->armed_map, 0, map_size);
+  memset(ctx->stale_map, 0, map_size);
+  for (int level = 0; level < 2; level++) {
+    for (int i = 0; i < WHEEL_SLOTS; i++) {
+      ctx->wheel[level][i] = INDEX_EMPTY;
+    }
+  }
+  ctx->free_slots_count = ctx->neig_capacity;
+  memset(ctx->neig_index, INDEX_EMPTY, sizeof(ctx->neig_index));
+}
+
+/**
+ * @brief Toma un msg del pool y le completa el encabezado de un fragmento del msg de rutas
+ *
+ * @param index número de fragmento
+ * @param count cantidad de fragmentos
+ * @return uint8_t* fragmento sin rutas, NULL si el pool está agotado
+ */
+static uint8_t * mesh_routing_new_fragment(struct mesh_routing_ctx * ctx, uint8_t index,
+                                           uint8_t count) {
+
+  uint8_t * msg = mesh_msg_alloc();
+  if (msg != NULL) {
+    msg[SRC] = ctx->id;
+    msg[DST] = BROADCAST_DIR;
+    msg[NEXT_HOP] = BROADCAST_DIR;
+    msg[OPCODE] = RCV_NEIGHBOR_OPCODE;
+    msg[SEQ] = FLOOD_SEQ_NONE;
+    msg[TTL] = 0; // los anuncios no se reenvían
+    msg[MSG + ADV_FORMAT] = ADV_FORMAT_COMPACT;
+    msg[MSG + ADV_FRAGMENT_INDEX] = index;
+    msg[MSG + ADV_FRAGMENT_COUNT] = count;
+  }
+  return msg;
+}
+
+/**
+ * @brief Entrega un fragmento del msg de rutas a la capa conn y libera la referencia propia. Si
+ * la capa conn necesita guardar el fragmento lo retiene, por lo que un mismo buffer se comparte
+ * entre todas las conexiones.
+ *
+ * @param msg fragmento a enviar
+ * @param len largo del fragmento
+ */
+static void mesh_routing_send_fragment(struct mesh_routing_ctx * ctx, uint8_t * msg,
+                                       uint8_t len) {
+  msg[LENGHT] = len;
+  mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ADV_SENT, 1);
+  mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_BYTES_SENT, MSG + len);
+  mesh_routing_trace(ctx, MESH_ROUTING_TRACE_ADV_SENT, BROADCAST_DIR, BROADCAST_DIR, len,
+                     msg[MSG + ADV_FRAGMENT_INDEX]);
+  mesh_conn_send_msg(BROADCAST_DIR, msg);
+  mesh_msg_release(msg);
+}
+
+/**
+ * @brief Indica si una ruta va en el anuncio. Las rutas restauradas sin confirmar no se anuncian.
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param full true si el anuncio lleva toda la tabla
+ * @return true si la ruta se anuncia
+ */
+static bool mesh_routing_adv_selected(struct mesh_routing_ctx * ctx,
+                                      struct neighbor_list * neighbor_aux, bool full) {
+  uint8_t slot = mesh_routing_slot(ctx, neighbor_aux);
+
+  return mesh_routing_map_test(full == true ? ctx->used_map : ctx->dirty_map, slot) &&
+         mesh_routing_map_test(ctx->stale_map, slot) == false;
+}
+
+/**
+ * @brief Devuelve el próximo salto con el que se anuncia una ruta: el de su mejor camino,
+ * ADV_VIA_DIRECT si es el propio destino, o el id del nodo si la ruta se perdió
+ *
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @return uint8_t via del grupo de la ruta
+ */
+static uint8_t mesh_routing_adv_via(struct mesh_routing_ctx * ctx,
+                                    struct neighbor_list * neighbor_aux) {
+  uint8_t via = neighbor_aux->path_count > 0 ? neighbor_aux->paths[0].next_hop : ctx->id;
+  return via == neighbor_aux->dst ? ADV_VIA_DIRECT : via;
+}
+
+/**
+ * @brief Busca el menor via mayor que otro entre las rutas a anunciar, y el rango de destinos de
+ * sus rutas. Los grupos se arman en orden de via, por lo que los dos armados del anuncio producen
+ * los mismos fragmentos.
+ *
+ * @param after via del grupo anterior, -1 para el primero
+ * @param first menor destino del grupo siguiente
+ * @param last mayor destino del grupo siguiente
+ * @return int via del grupo siguiente, -1 si no hay más rutas
+ */
+static int mesh_routing_adv_next_via(struct mesh_routing_ctx * ctx, bool full, int after,
+                                     uint8_t * first, uint8_t * last) {
+  int next = -1;
+
+  const uint32_t * map = full == true ? ctx->used_map : ctx->dirty_map;
+
+  for (int w = 0; w < MESH_ROUTING_MAP_WORDS(ctx->neig_capacity); w++) {
+    int i = w * MAP_WORD_BITS;
+    for (uint32_t bits = map[w] & ~ctx->stale_map[w]; bits != 0; bits >>= 1, i++) {
+      if ((bits & 1u) == 0) {
+        continue;
+      }
+      struct neighbor_list * neighbor_aux = &ctx->neig_list[i];
+      int via = mesh_routing_adv_via(ctx, neighbor_aux);
+      if (via <= after || (next >= 0 && via > next)) {
+        continue;
+      }
+      if (via != next) {
+        next = via;
+        *first = neighbor_aux->dst;
+        *last = neighbor_aux->dst;
+      } else if (neighbor_aux->dst < *first) {
+        *first = neighbor_aux->dst;
+      } else if (neighbor_aux->dst > *last) {
+        *last = neighbor_aux->dst;
+      }
+    }
+  }
+  return next;
+}
+
+/**
+ * @brief Codifica una ruta en formato compacto. El primer byte lleva la diferencia con el destino
+ * anterior del grupo (0 si no entra en 4 bits y el destino va aparte), ADV_SEQ_FLAG si el número
+ * de secuencia difiere del de la ruta anterior y la métrica (ADV_METRIC_MASK si no entra en 3 bits
+ * y va aparte). Le siguen el destino, el número de secuencia y la métrica que van aparte, en ese
+ * orden.
+ *
+ * @param route ruta codificada, de hasta ADV_ROUTE_MAX_SIZE bytes
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param prev_dst destino de la ruta anterior del grupo
+ * @param prev_seq número de secuencia de la ruta anterior del grupo
+ * @return uint8_t bytes de la ruta codificada
+ */
+static uint8_t mesh_routing_adv_encode_route(uint8_t * route, struct neighbor_list * neighbor_aux,
+                                             int16_t prev_dst, uint8_t prev_seq) {
+  int delta = neighbor_aux->dst - prev_dst;
+  uint8_t metric = mesh_routing_element_metric(neighbor_aux);
+  uint8_t len = 1;
+
+  route[0] = 0;
+  if (delta < (1 << (8 - ADV_DST_SHIFT))) {
+    route[0] = (uint8_t)(delta << ADV_DST_SHIFT);
+  } else {
+    route[len++] = neighbor_aux->dst;
+  }
+  if (neighbor_aux->seq != prev_seq) {
+    route[0] |= ADV_SEQ_FLAG;
+    route[len++] = neighbor_aux->seq;
+  }
+  if (metric < ADV_METRIC_MASK) {
+    route[0] |= metric;
+  } else {
+    route[0] |= ADV_METRIC_MASK;
+    route[len++] = metric;
+  }
+  return len;
+}
+
+/**
+ * @brief Cierra el fragmento en armado y, si se está escribiendo, lo envía
+ *
+ * @param writer estado del armado
+ */
+static void mesh_routing_adv_close_fragment(struct mesh_routing_ctx * ctx,
+                                            struct adv_writer * writer) {
+  if (writer->msg != NULL) {
+    mesh_routing_send_fragment(ctx, writer->msg, writer->len);
+    writer->msg = NULL;
+  }
+  writer->fragment++;
+  writer->len = ADV_HEADER_SIZE;
+  writer->group = 0;
+}
+
+/**
+ * @brief Agrega una ruta al anuncio, dentro del grupo abierto si entra en el fragmento. Si no, la
+ * ruta abre un grupo nuevo, en el mismo fragmento o en uno nuevo.
+ *
+ * @param writer estado del armado
+ * @param neighbor_aux elemento de la tabla de ruta
+ * @param via via del grupo de la ruta
+ * @return true si se agregó, false si el pool de msg está agotado
+ */
+static bool mesh_routing_adv_put_route(struct mesh_routing_ctx * ctx, struct adv_writer * writer,
+                                       struct neighbor_list * neighbor_aux, uint8_t via) {
+  uint8_t route[ADV_ROUTE_MAX_SIZE];
+  uint8_t len = 0;
+
+  if (writer->group != 0) {
+    len = mesh_routing_adv_encode_route(route, neighbor_aux, writer->prev_dst, writer->prev_seq);
+  }
+  if (writer->group == 0 || writer->len + len > MAX_SIZE_MSG) {
+    len = mesh_routing_adv_encode_route(route, neighbor_aux, -1, 0);
+    if (writer->len + ADV_GROUP_SIZE + len > MAX_SIZE_MSG) {
+      mesh_routing_adv_close_fragment(ctx, writer);
+    }
+    if (writer->msg == NULL) {
+      writer->via = via;
+      writer->dst = neighbor_aux->dst;
+    }
+    if (writer->write == true && writer->msg == NULL) {
+      writer->msg = mesh_routing_new_fragment(ctx, writer->fragment, writer->fragment_count);
+      if (writer->msg == NULL) {
+        return false;
+      }
+    }
+    if (writer->msg != NULL) {
+      writer->msg[MSG + writer->len] = via;
+      writer->msg[MSG + writer->len + 1] = 0;
+    }
+    writer->group = writer->len;
+    writer->len = writer->len + ADV_GROUP_SIZE;
+  }
+
+  if (writer->msg != NULL) {
+    for (uint8_t i = 0; i < len; i++) {
+      writer->msg[MSG + writer->len + i] = route[i];
+    }
+    writer->msg[MSG + writer->group + 1]++;
+    mesh_routing_map_clear(ctx->dirty_map, mesh_routing_slot(ctx, neighbor_aux));
+  }
+  writer->len = writer->len + len;
+  writer->prev_dst = neighbor_aux->dst;
+  writer->prev_seq = neighbor_aux->seq;
+  return true;
+}
+
+/**
+ * @brief Arma el anuncio en formato compacto: un grupo por via, en orden de via, y dentro de cada
+ * grupo las rutas en orden de destino. El armado empieza en la ruta indicada por via y dst del
+ * estado, para seguir un anuncio a medias.
+ *
+ * @param writer estado del armado
+ * @return true si se armó, false si el pool de msg se agotó
+ */
+static bool mesh_routing_adv_encode(struct mesh_routing_ctx * ctx, struct adv_writer * writer) {
+  uint8_t from_via = writer->via;
+  uint8_t from_dst = writer->dst;
+  int via = from_via - 1;
+  uint8_t first = 0;
+  uint8_t last = 0;
+
+  while ((via = mesh_routing_adv_next_via(ctx, writer->full, via, &first, &last)) >= 0) {
+    writer->group = 0;
+    for (int dst = via == from_via && from_dst > first ? from_dst : first; dst <= last; dst++) {
+      if (ctx->neig_index[dst] == INDEX_EMPTY) {
+        continue;
+      }
+      struct neighbor_list * neighbor_aux = &ctx->neig_list[ctx->neig_index[dst]];
+      if (mesh_routing_adv_selected(ctx, neighbor_aux, writer->full) == true &&
+          mesh_routing_adv_via(ctx, neighbor_aux) == via &&
+          mesh_routing_adv_put_route(ctx, writer, neighbor_aux, (uint8_t)via) == false) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Envía los fragmentos del anuncio en curso a partir de su cursor. Cada fragmento se arma
+ * en un msg del pool, sin otra memoria, y la capa conn lo retiene hasta transmitirlo. Si el pool
+ * se agota en el medio, el cursor queda en la primera ruta sin enviar y el resto del anuncio sigue
+ * en el próximo paso del handler. Los fragmentos que faltan se cuentan de nuevo desde el cursor,
+ * por lo que si la tabla cambió entre pasos la cantidad de fragmentos anunciada se ajusta.
+ *
+ * @return true si se envió el último fragmento, false si el anuncio sigue a medias
+ */
+static bool mesh_routing_adv_send(struct mesh_routing_ctx * ctx) {
+  struct mesh_routing_adv_cursor * adv = &ctx->adv;
+  struct adv_writer writer = {.write = false,
+                              .full = adv->full,
+                              .fragment = adv->fragment,
+                              .len = ADV_HEADER_SIZE,
+                              .via = adv->via,
+                              .dst = adv->dst};
+
+  mesh_routing_adv_encode(ctx, &writer);
+
+  writer.fragment_count = writer.fragment + 1;
+  writer.write = true;
+  writer.msg = NULL;
+  writer.fragment = adv->fragment;
+  writer.len = ADV_HEADER_SIZE;
+  writer.group = 0;
+  writer.via = adv->via;
+  writer.dst = adv->dst;
+
+  if (mesh_routing_adv_encode(ctx, &writer) == false) {
+    adv->fragment = writer.fragment;
+    adv->via = writer.via;
+    adv->dst = writer.dst;
+    return false; // pool agotado, se sigue en el próximo paso
+  }
+  if (writer.msg == NULL) {
+    writer.msg = mesh_routing_new_fragment(ctx, writer.fragment, writer.fragment_count);
+    if (writer.msg == NULL) {
+      return false; // pool agotado
+    }
+  }
+  mesh_routing_send_fragment(ctx, writer.msg, writer.len);
+
+  adv->pending = false;
+  if (adv->periodic == true) {
+    ctx->periodic_count = (ctx->periodic_count + 1) % MESH_ROUTING_FULL_SYNC_PERIOD;
+  }
+  return true;
+}
+
+/**
+ * @brief Función que envía la información de las rutas alcanzadas. El anuncio completo lleva toda
+ * la tabla, el anuncio incremental solo las rutas modificadas desde el último anuncio. Como las
+ * rutas pueden no entrar en un solo msg, se envían fragmentos numerados uno detrás del otro. Cada
+ * fragmento tiene el siguiente formato: {formato, número de fragmento, cantidad de fragmentos,
+ * grupos...}. El id del nodo va una sola vez, en el campo SRC. Cada grupo es {via, cantidad de
+ * rutas, rutas...} y reúne las rutas cuyo mejor camino pasa por via, que es el próximo salto de
+ * este nodo; las rutas van en orden de destino, codificadas como en
+ * mesh_routing_adv_encode_route(). Si no hay rutas para anunciar se envía igual un fragmento vacío
+ * para que los vecinos sepan que las rutas siguen vigentes. Las rutas perdidas se anuncian con
+ * métrica infinita mientras dura su retención. Si el anuncio necesita más fragmentos de los que
+ * tiene libres el pool, se envía en varios pasos del handler, ver mesh_routing_adv_send(). Mientras
+ * un anuncio sigue a medias no se empieza otro.
+ *
+ * @param full true para anunciar toda la tabla, false para anunciar solo las rutas modificadas
+ * @param periodic true si es el anuncio periódico
+ */
+static void mesh_routing_send_neighbor(struct mesh_routing_ctx * ctx, bool full, bool periodic) {
+  if (ctx->adv.pending == true) {
+    return;
+  }
+  ctx->adv.pending = true;
+  ctx->adv.full = full;
+  ctx->adv.periodic = periodic;
+  ctx->adv.fragment = 0;
+  ctx->adv.via = 0;
+  ctx->adv.dst = 0;
+  ctx->triggered_pending = false; // las rutas modificadas van en este anuncio
+
+  mesh_routing_adv_send(ctx);
+}
+
+/**
+ * @brief Envía el anuncio periódico. Cada MESH_ROUTING_FULL_SYNC_PERIOD anuncios se envía la
+ * tabla completa, el resto solo lleva las rutas modificadas. La cuenta avanza recién cuando sale
+ * el último fragmento del anuncio, así un anuncio completo que no terminó vuelve a ser completo.
+ *
+ */
+static void mesh_routing_send_periodic_update(struct mesh_routing_ctx * ctx) {
+  mesh_routing_send_neighbor(ctx, ctx->periodic_count == 0, true);
+}
+
+/**
+ * @brief Envía las rutas modificadas si las hay. Se llama una vez por paso del handler, por lo que
+ * se envía a lo sumo un anuncio disparado por paso.
+ *
+ */
+static void mesh_routing_send_triggered_update(struct mesh_routing_ctx * ctx) {
+  if (ctx->triggered_pending == true) {
+    mesh_routing_send_neighbor(ctx, false, false);
+  }
+}
+
+/**
+ * @brief Agrega a la tabla una ruta anunciada por un vecino. Las rutas que el vecino alcanza a
+ * través de este nodo se toman como perdidas (envenenamiento), así un camino nunca vuelve por el
+ * nodo del que salió.
+ *
+ * @param src vecino que anunció la ruta, próximo salto de la ruta
+ * @param cost costo del enlace con el vecino
+ * @param dst destino
+ * @param via próximo salto del vecino hacia el destino
+ * @param metric métrica anunciada por el vecino
+ * @param seq número de secuencia del destino
+ */
+static void mesh_routing_add_adv_route(struct mesh_routing_ctx * ctx, uint8_t src, uint8_t cost,
+                                       uint8_t dst, uint8_t via, uint8_t metric, uint8_t seq) {
+  if (via == ctx->id) {
+    metric = METRIC_INFINITY; // el vecino llega al destino a través de este nodo
+  } else if (metric < METRIC_INFINITY - cost) {
+    metric = metric + cost;
+  } else {
+    metric = METRIC_INFINITY;
+  }
+  mesh_routing_add_neighbor(ctx, dst, src, metric, seq);
+}
+
+/**
+ * @brief Agrega las rutas de un fragmento en formato plano, {dst, via, metric, seq} por ruta
+ *
+ * @param src vecino que envió el fragmento
+ * @param cost costo del enlace con el vecino
+ * @param p_neighbor fragmento
+ * @param len largo del fragmento
+ */
+static void mesh_routing_add_plain_routes(struct mesh_routing_ctx * ctx, uint8_t src, uint8_t cost,
+                                          uint8_t * p_neighbor, uint8_t len) {
+  for (uint8_t i = ADV_HEADER_SIZE; i + ADV_ROUTE_SIZE <= len; i = i + ADV_ROUTE_SIZE) {
+    mesh_routing_add_adv_route(ctx, src, cost, p_neighbor[i], p_neighbor[i + 1], p_neighbor[i + 2],
+                               p_neighbor[i + 3]);
+  }
+}
+
+/**
+ * @brief Agrega las rutas de un fragmento en formato compacto, ver mesh_routing_send_neighbor().
+ * Si el fragmento está mal formado se descarta el resto.
+ *
+ * @param src vecino que envió el fragmento
+ * @param cost costo del enlace con el vecino
+ * @param p_neighbor fragmento
+ * @param len largo del fragmento
+ */
+static void mesh_routing_add_compact_routes(struct mesh_routing_ctx * ctx, uint8_t src,
+                                            uint8_t cost, uint8_t * p_neighbor, uint8_t len) {
+  uint8_t i = ADV_HEADER_SIZE;
+
+  while (i + ADV_GROUP_SIZE <= len) {
+    uint8_t via = p_neighbor[i];
+    uint8_t count = p_neighbor[i + 1];
+    int dst = -1;
+    uint8_t seq = 0;
+    i = i + ADV_GROUP_SIZE;
+
+    for (uint8_t k = 0; k < count; k++) {
+      if (i >= len) {
+        return;
+      }
+      uint8_t route = p_neighbor[i];
+      uint8_t delta = route >> ADV_DST_SHIFT;
+      uint8_t metric = route & ADV_METRIC_MASK;
+      uint8_t size = 1 + (delta == 0) + ((route & ADV_SEQ_FLAG) != 0) + (metric == ADV_METRIC_MASK);
+
+      if (i + size > len) {
+        return;
+      }
+      i++;
+      dst = delta == 0 ? p_neighbor[i++] : dst + delta;
+      if ((route & ADV_SEQ_FLAG) != 0) {
+        seq = p_neighbor[i++];
+      }
+      if (metric == ADV_METRIC_MASK) {
+        metric = p_neighbor[i++];
+      }
+      if (dst >= BROADCAST_DIR) {
+        return;
+      }
+      mesh_routing_add_adv_route(ctx, src, cost, (uint8_t)dst, via == ADV_VIA_DIRECT ? dst : via,
+                                 metric, seq);
+    }
+  }
+}
+
+/**
+ * @brief Función que agrega elementos a la tabla de rutas a partir de un fragmento del msg de
+ * rutas. Cada fragmento se procesa a medida que llega, directamente sobre el msg recibido.
+ *
+ * @param p_neighbor puntero al fragmento con el formato {formato, número de fragmento, cantidad de
+ * fragmentos, rutas...}. Los nodos envían el formato compacto, ver mesh_routing_send_neighbor().
+ * En el formato plano las rutas tienen el formato {destino, next_hop, metrica, seq}, donde
+ * next_hop es el próximo salto del vecino hacia el destino. Por ejemplo si el vecino llega al
+ * destino 9 a traves de 3 con métrica 3 y al destino 5 a través de 7 con metrica 1, ambos con
+ * secuencia 4, en un único fragmento se debe enviar con el siguiente formato:
+ * uint8_t[] = {1,0,1,9,3,3,4,5,7,1,4}. Una métrica infinita indica que el vecino perdió la ruta.
+ * Los fragmentos de un formato desconocido se descartan.
+ * @param src vecino que envió el fragmento, próximo salto de las rutas
+ * @param len largo del mensaje. En el ejemplo 11.
+ */
+static void mesh_routing_add_neig_msg(struct mesh_routing_ctx * ctx, uint8_t src,
+                                      uint8_t * p_neighbor, uint8_t len) {
+
+  if (len < ADV_HEADER_SIZE || len > MAX_SIZE_MSG ||
+      p_neighbor[ADV_FRAGMENT_INDEX] >= p_neighbor[ADV_FRAGMENT_COUNT] ||
+      (p_neighbor[ADV_FORMAT] != ADV_FORMAT_PLAIN &&
+       p_neighbor[ADV_FORMAT] != ADV_FORMAT_COMPACT)) {
+    return; // fragmento inválido
+  }
+  mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ADV_RECEIVED, 1);
+
+  if (p_neighbor[ADV_FRAGMENT_INDEX] == 0) {
+    mesh_routing_refresh_next_hop(ctx, src);
+  }
+
+  uint16_t interval = ctx->trickle.interval;
+  bool pending = ctx->triggered_pending;
+  ctx->triggered_pending = false;
+
+  uint8_t cost = mesh_routing_link_cost(ctx, src);
+
+  mesh_routing_table_write_begin(ctx);
+  if (p_neighbor[ADV_FORMAT] == ADV_FORMAT_PLAIN) {
+    mesh_routing_add_plain_routes(ctx, src, cost, p_neighbor, len);
+  } else {
+    mesh_routing_add_compact_routes(ctx, src, cost, p_neighbor, len);
+  }
+  mesh_routing_table_write_end(ctx);
+
+  if (ctx->triggered_pending == false && interval == ctx->trickle.interval &&
+      p_neighbor[ADV_FRAGMENT_INDEX] + 1 == p_neighbor[ADV_FRAGMENT_COUNT]) {
+    ctx->trickle.counter++; // anuncio completo del vecino que no cambió la tabla
+  }
+  ctx->triggered_pending = ctx->triggered_pending || pending;
+}
+
+/**
+ * @brief El msg es para la capa routing. Procesa el mensaje segun el OPCODE. OPCODE SEND_NEIGBOR =
+ * mensaje donde estan las rutas alcanzadas por determinado vecino.
+ *
+ * @param msg puntero al msg a procesar
+ */
+static void mesh_routing_process_msg(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+
+  switch (msg[OPCODE]) {
+
+  case RCV_NEIGHBOR_OPCODE:
+    mesh_routing_add_neig_msg(ctx, msg[SRC], &msg[MSG], msg[LENGHT]);
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Descuenta el salto que hace un msg al transmitirse
+ *
+ * @param msg msg a transmitir
+ * @return true si el msg todavía tenía saltos, false si los agotó y se tiene que descartar
+ */
+static bool mesh_routing_take_hop(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+  if (msg[TTL] == 0) {
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_DROPPED_TTL, 1);
+    mesh_routing_trace(ctx, MESH_ROUTING_TRACE_DROP_TTL, msg[DST], 0, 0, msg[SRC]);
+    return false;
+  }
+  msg[TTL]--;
+  return true;
+}
+
+/**
+ * @brief Busca un broadcast entre los últimos vistos y si no estaba lo agrega al buffer circular,
+ * reemplazando al más antiguo
+ *
+ * @param src origen del broadcast
+ * @param seq número de secuencia del broadcast
+ * @return true si el broadcast ya se había visto
+ */
+static bool mesh_routing_flood_seen(struct mesh_routing_ctx * ctx, uint8_t src, uint8_t seq) {
+  for (int i = 0; i < MESH_ROUTING_FLOOD_CACHE; i++) {
+    if (ctx->flood_seen[i][0] == src && ctx->flood_seen[i][1] == seq) {
+      return true;
+    }
+  }
+
+  ctx->flood_seen[ctx->flood_seen_next][0] = src;
+  ctx->flood_seen[ctx->flood_seen_next][1] = seq;
+  ctx->flood_seen_next = (ctx->flood_seen_next + 1) % MESH_ROUTING_FLOOD_CACHE;
+  return false;
+}
+
+/**
+ * @brief Retransmite un broadcast a todos los vecinos
+ *
+ * @param msg broadcast a retransmitir
+ */
+static void mesh_routing_flood_send(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+  msg[NEXT_HOP] = BROADCAST_DIR;
+  mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_FLOOD_RELAYED, 1);
+  mesh_conn_send_msg(BROADCAST_DIR, msg);
+}
+
+/**
+ * @brief Programa la retransmisión de un broadcast recibido por primera vez en un paso al azar de
+ * los próximos MESH_ROUTING_FLOOD_JITTER pasos del handler, para que los vecinos que lo recibieron
+ * a la vez no lo retransmitan juntos. Si no hay lugar para otra retransmisión pendiente o el pool
+ * de msg está agotado el broadcast se retransmite enseguida.
+ *
+ * @param msg broadcast a retransmitir
+ */
+static void mesh_routing_flood_schedule(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+  for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+    struct mesh_routing_flood_relay * relay = &ctx->flood_pending[i];
+    if (relay->msg == NULL) {
+      relay->msg = mesh_msg_hold(msg);
+      if (relay->msg != NULL) {
+        relay->fire_at = ctx->now + 1 + mesh_routing_rand(ctx) % MESH_ROUTING_FLOOD_JITTER;
+        relay->copies = 0;
+        return;
+      }
+      break;
+    }
+  }
+  mesh_routing_flood_send(ctx, msg);
+}
+
+/**
+ * @brief Cuenta una copia escuchada de un broadcast que espera retransmitirse
+ *
+ * @param msg copia del broadcast
+ */
+static void mesh_routing_flood_count_copy(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+  for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+    struct mesh_routing_flood_relay * relay = &ctx->flood_pending[i];
+    if (relay->msg != NULL && relay->msg[SRC] == msg[SRC] && relay->msg[SEQ] == msg[SEQ]) {
+      if (relay->copies < UINT8_MAX) {
+        relay->copies++;
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Retransmite los broadcast cuyo paso llegó, salvo los que ya se escucharon
+ * MESH_ROUTING_FLOOD_SUPPRESS veces, y libera los msg retenidos
+ *
+ */
+static void mesh_routing_flood_tick(struct mesh_routing_ctx * ctx) {
+  for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+    struct mesh_routing_flood_relay * relay = &ctx->flood_pending[i];
+    if (relay->msg != NULL && mesh_routing_time_reached(ctx, relay->fire_at) == true) {
+      if (relay->copies < MESH_ROUTING_FLOOD_SUPPRESS) {
+        mesh_routing_flood_send(ctx, relay->msg);
+      } else {
+        mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_FLOOD_SUPPRESSED, 1);
+      }
+      mesh_msg_release(relay->msg);
+      relay->msg = NULL;
+    }
+  }
+}
+
+/**
+ * @brief Decide qué hacer con un broadcast en modo inundación. Un broadcast propio sin numerar
+ * recibe el próximo número de secuencia y se envía a todos los vecinos. Un broadcast de otro nodo
+ * se entrega a la capa de aplicación y se programa su retransmisión solo la primera vez que se
+ * recibe; las copias siguientes, y las propias que vuelven, solo cuentan para suprimir la
+ * retransmisión. Un broadcast sin número de secuencia, o que agotó sus saltos, se entrega sin
+ * retransmitirse.
+ *
+ * @param msg broadcast a rutear
+ * @return uint8_t BROADCAST_DIR si el msg se tiene que enviar, UNREACHABLE_DIR si no
+ */
+static uint8_t mesh_routing_flood_msg(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+
+  if (msg[SEQ] == FLOOD_SEQ_NONE && msg[SRC] == ctx->id) {
+    if (mesh_routing_take_hop(ctx, msg) == false) {
+      return UNREACHABLE_DIR;
+    }
+    mesh_port_routing_lock();
+    ctx->flood_seq++;
+    if (ctx->flood_seq == FLOOD_SEQ_NONE) {
+      ctx->flood_seq++;
+    }
+    msg[SEQ] = ctx->flood_seq;
+    mesh_routing_flood_seen(ctx, msg[SRC], msg[SEQ]);
+    mesh_port_routing_unlock();
+    msg[NEXT_HOP] = BROADCAST_DIR;
+    return BROADCAST_DIR;
+  }
+
+  bool seen = false;
+  if (msg[SEQ] != FLOOD_SEQ_NONE) {
+    mesh_port_routing_lock();
+    seen = msg[SRC] == ctx->id || mesh_routing_flood_seen(ctx, msg[SRC], msg[SEQ]) == true;
+    if (seen == true) {
+      mesh_routing_flood_count_copy(ctx, msg);
+      mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_FLOOD_DUPLICATES, 1);
+    } else if (mesh_routing_take_hop(ctx, msg) == true) {
+      mesh_routing_flood_schedule(ctx, msg);
+    }
+    mesh_port_routing_unlock();
+  }
+
+  if (seen == false) {
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_DELIVERED, 1);
+    mesh_app_process_msg(msg);
+  }
+  return UNREACHABLE_DIR;
+}
+
+/**
+ * @brief Función que decide qué hacer con un msg que no es de la capa routing. Si el msg es para
+ * él mismo lo pasa a la capa de aplicación, si no pone el próximo salto en el campo NEXT_HOP y
+ * descuenta un salto del campo TTL. Un msg que llega sin saltos se descarta, por lo que un msg
+ * atrapado en un lazo transitorio no circula indefinidamente. Sin el modo inundación un broadcast
+ * propio se envía a todos los vecinos y uno recibido se entrega a la capa de aplicación.
+ *
+ * @param msg puntero al msg a rutear
+ * @return uint8_t próximo salto, UNREACHABLE_DIR si el msg no se tiene que reenviar
+ */
+static uint8_t mesh_routing_route_msg(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+
+  if (msg[DST] == BROADCAST_DIR && ctx->flooding == true) {
+    return mesh_routing_flood_msg(ctx, msg);
+  }
+
+  if (msg[DST] == BROADCAST_DIR && msg[SRC] == ctx->id) {
+    msg[NEXT_HOP] = BROADCAST_DIR; // sin numerar, los vecinos no lo retransmiten
+    return BROADCAST_DIR;
+  }
+
+  if (msg[DST] == ctx->id || msg[DST] == BROADCAST_DIR) {
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_DELIVERED, 1);
+    mesh_app_process_msg(msg);
+    return UNREACHABLE_DIR;
+  }
+
+  if (mesh_routing_take_hop(ctx, msg) == false) {
+    return UNREACHABLE_DIR;
+  }
+
+  uint8_t metric;
+  uint8_t next_hop =
+      mesh_routing_read_next_hop(ctx, msg[DST], mesh_routing_flow_hash(msg), &metric);
+  if (next_hop != UNREACHABLE_DIR) {
+    msg[NEXT_HOP] = next_hop;
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_FORWARDED, 1);
+    mesh_routing_trace(ctx, MESH_ROUTING_TRACE_FORWARD, msg[DST], next_hop, metric, msg[SRC]);
+  } else {
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_DROPPED_UNREACHABLE, 1);
+    mesh_routing_trace(ctx, MESH_ROUTING_TRACE_DROP_UNREACHABLE, msg[DST], 0, 0, msg[SRC]);
+  }
+  return next_hop;
+}
+
+/**
+ * @brief Función que rutea el mensaje poniendo el próximo salto en el campo NEXT_HOP del msg en
+ * caso que el msg no sea para él mismo. El msg se reenvía sin copiarse: se entrega a la capa conn
+ * el mismo buffer recibido.
+ *
+ * @param msg puntero al msg a rutear
+ */
+static void mesh_routing_routing_msg(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+
+  uint8_t next_hop = mesh_routing_route_msg(ctx, msg);
+  if (next_hop != UNREACHABLE_DIR) {
+    mesh_conn_send_msg(next_hop, msg);
+  }
+}
+
+/**
+ * @brief Función que rutea un lote de msg y los entrega a la capa conn en una sola llamada,
+ * agrupados por próximo salto y manteniendo el orden de llegada dentro de cada grupo.
+ *
+ * @param msgs msg del lote, a lo sumo MESH_ROUTING_BATCH_MAX
+ * @param count cantidad de msg
+ */
+static void mesh_routing_routing_batch(struct mesh_routing_ctx * ctx, uint8_t ** msgs,
+                                       uint8_t count) {
+
+  uint8_t * forward[MESH_ROUTING_BATCH_MAX];
+  uint8_t forward_count = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t * msg = msgs[i];
+
+    if (msg[OPCODE] >= OPCODE_ROUTING_MIN && msg[OPCODE] <= OPCODE_ROUTING_MAX) {
+      mesh_port_routing_lock();
+      mesh_routing_process_msg(ctx, msg);
+      mesh_port_routing_unlock();
+    } else if (mesh_routing_route_msg(ctx, msg) != UNREACHABLE_DIR) {
+
+      uint8_t position = forward_count; // inserción estable ordenada por próximo salto
+      while (position > 0 && forward[position - 1][NEXT_HOP] > msg[NEXT_HOP]) {
+        forward[position] = forward[position - 1];
+        position--;
+      }
+      forward[position] = msg;
+      forward_count++;
+    }
+  }
+
+  if (forward_count > 0) {
+    mesh_conn_send_msgs(forward, forward_count);
+  }
+}
+
+/**
+ * @brief Paso del handler en modo adaptativo. Anuncia en el paso elegido del intervalo salvo que se
+ * hayan escuchado suficientes anuncios de vecinos sin cambios y duplica el intervalo al terminar.
+ *
+ */
+static void mesh_routing_trickle_handler_time_out(struct mesh_routing_ctx * ctx) {
+  ctx->trickle.ticks++;
+
+  if (ctx->trickle.ticks == ctx->trickle.fire_at) {
+    if (ctx->trickle.counter < MESH_ROUTING_TRICKLE_K ||
+        ctx->trickle.suppressed >= TRICKLE_MAX_SUPPRESS) {
+      mesh_routing_send_periodic_update(ctx);
+      ctx->trickle.suppressed = 0;
+    } else {
+      ctx->trickle.suppressed++;
+    }
+  }
+
+  if (ctx->trickle.ticks >= ctx->trickle.interval) {
+    ctx->trickle.interval = ctx->trickle.interval * 2;
+    if (ctx->trickle.interval > MESH_ROUTING_TRICKLE_IMAX) {
+      ctx->trickle.interval = MESH_ROUTING_TRICKLE_IMAX;
+    }
+    mesh_routing_trickle_start_interval(ctx);
+  }
+}
+
+/**
+ * @brief Acumula bytes en el CRC-16/CCITT de una copia de la tabla de rutas
+ *
+ * @param crc CRC de los bytes anteriores
+ * @param data bytes a acumular
+ * @param len cantidad de bytes
+ * @return uint16_t CRC actualizado
+ */
+static uint16_t mesh_routing_snapshot_crc(uint16_t crc, const uint8_t * data, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ SNAPSHOT_CRC_POLY) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief Escribe los bytes siguientes de la copia de la tabla de rutas
+ *
+ * @param stream estado de la escritura
+ * @param data bytes a escribir
+ * @param len cantidad de bytes
+ * @return int 0 si se escribieron, -1 si falló la escritura
+ */
+static int mesh_routing_snapshot_write(struct snapshot_stream * stream, const uint8_t * data,
+                                       uint16_t len) {
+  if (stream->storage->write(stream->storage->user, stream->offset, data, len) != 0) {
+    return -1;
+  }
+  stream->crc = mesh_routing_snapshot_crc(stream->crc, data, len);
+  stream->offset = stream->offset + len;
+  return 0;
+}
+
+/**
+ * @brief Lee los bytes siguientes de la copia de la tabla de rutas
+ *
+ * @param stream estado de la lectura
+ * @param data bytes leídos
+ * @param len cantidad de bytes
+ * @return int 0 si se leyeron, -1 si falló la lectura o la copia excede el medio
+ */
+static int mesh_routing_snapshot_read(struct snapshot_stream * stream, uint8_t * data,
+                                      uint16_t len) {
+  if (stream->offset + len > (uint32_t)UINT16_MAX + 1 ||
+      stream->storage->read(stream->storage->user, stream->offset, data, len) != 0) {
+    return -1;
+  }
+  stream->crc = mesh_routing_snapshot_crc(stream->crc, data, len);
+  stream->offset = stream->offset + len;
+  return 0;
+}
+
+/**
+ * @brief Recorre una copia de la tabla de rutas y verifica su CRC, que se calcula sobre las rutas y
+ * después sobre el encabezado porque el encabezado se escribe al final. La primera pasada solo
+ * valida la copia; la segunda carga las rutas y vuelve a verificar el CRC sobre los bytes que leyó,
+ * por si el medio cambió entre las dos pasadas. Se descartan la ruta propia, los destinos repetidos
+ * o inválidos, las rutas perdidas y los caminos por el propio nodo o de métrica infinita; si la
+ * copia tiene más caminos por destino que MESH_ROUTING_MAX_PATHS se guardan los mejores. Las rutas
+ * que no entran en la tabla se descartan. Cada camino cargado vence a la vida de un camino, como si
+ * se acabara de anunciar.
+ *
+ * @param stream estado de la lectura
+ * @param loaded si no es NULL se cargan las rutas y se marcan sus posiciones de la tabla
+ * @param seq número de secuencia propio guardado en la copia
+ * @return int 0 si la copia es válida, -1 si no lo es o falló la lectura
+ */
+static int mesh_routing_snapshot_load(struct mesh_routing_ctx * ctx,
+                                      struct snapshot_stream * stream, uint32_t * loaded,
+                                      uint8_t * seq) {
+  uint8_t header[SNAPSHOT_HEADER_SIZE];
+  uint8_t route[SNAPSHOT_ROUTE_SIZE];
+  uint8_t path[SNAPSHOT_PATH_SIZE];
+  uint8_t crc[SNAPSHOT_CRC_SIZE];
+  uint16_t deadline = ctx->now + ctx->route_lifetime;
+
+  if (mesh_routing_snapshot_read(stream, header, sizeof(header)) != 0 ||
+      header[0] != SNAPSHOT_MAGIC_0 || header[1] != SNAPSHOT_MAGIC_1 ||
+      header[2] != SNAPSHOT_VERSION || header[3] != ctx->id) {
+    return -1;
+  }
+  stream->crc = SNAPSHOT_CRC_INIT;
+  *seq = header[4];
+
+  for (int i = 0; i < header[5]; i++) {
+    struct neighbor_list * neighbor_aux = NULL;
+
+    if (mesh_routing_snapshot_read(stream, route, sizeof(route)) != 0) {
+      return -1;
+    }
+    if (loaded != NULL && route[0] != ctx->id && route[0] < BROADCAST_DIR &&
+        ctx->neig_index[route[0]] == INDEX_EMPTY && (route[1] & 1) == 0) {
+      neighbor_aux = mesh_routing_get_free_element_in_table(ctx, route[0]); // NULL si está llena
+    }
+    if (neighbor_aux != NULL) {
+      neighbor_aux->seq = route[1];
+    }
+
+    for (int j = 0; j < route[2]; j++) {
+      if (mesh_routing_snapshot_read(stream, path, sizeof(path)) != 0) {
+        if (neighbor_aux != NULL) {
+          mesh_routing_delete_neighbor(ctx, neighbor_aux->dst);
+        }
+        return -1;
+      }
+      if (neighbor_aux != NULL && path[0] != ctx->id && path[0] < BROADCAST_DIR &&
+          path[1] != METRIC_INFINITY &&
+          mesh_routing_search_path_in_table(neighbor_aux, path[0]) < 0) {
+        mesh_routing_add_path_in_table(neighbor_aux, path[0], path[1], deadline);
+      }
+    }
+
+    if (neighbor_aux == NULL) {
+      continue;
+    }
+    if (neighbor_aux->path_count == 0) {
+      mesh_routing_delete_neighbor(ctx, neighbor_aux->dst);
+      continue;
+    }
+    mesh_routing_map_set(loaded, mesh_routing_slot(ctx, neighbor_aux));
+  }
+
+  uint16_t expected = mesh_routing_snapshot_crc(stream->crc, header, sizeof(header));
+  if (mesh_routing_snapshot_read(stream, crc, sizeof(crc)) != 0 ||
+      (uint16_t)((crc[0] << 8) | crc[1]) != expected) {
+    return -1;
+  }
+  return 0;
+}
+
+/* === Public function implementation ========================================================== */
+
+int mesh_routing_init(struct mesh_routing_ctx * ctx, uint8_t id, uint8_t capacity, void * arena,
+                      size_t arena_size) {
+
+  if (capacity == 0 || capacity > MESH_ROUTING_MAX_CAPACITY || id >= BROADCAST_DIR ||
+      arena == NULL || arena_size < MESH_ROUTING_ARENA_SIZE(capacity) ||
+      ((uintptr_t)arena % sizeof(uint32_t)) != 0) {
+    return -1;
+  }
+
+  ctx->id = id;
+  ctx->neig_list = (struct neighbor_list *)arena;
+  ctx->neig_capacity = capacity;
+  ctx->used_map = (uint32_t *)((uint8_t *)arena + (size_t)capacity * MESH_ROUTING_ENTRY_SIZE);
+  ctx->dirty_map = ctx->used_map + MESH_ROUTING_MAP_WORDS(capacity);
+  ctx->armed_map = ctx->dirty_map + MESH_ROUTING_MAP_WORDS(capacity);
+  ctx->stale_map = ctx->armed_map + MESH_ROUTING_MAP_WORDS(capacity);
+
+  mesh_routing_erase_routing_table(ctx);
+  ctx->paso = 0;
+  ctx->periodic_count = 0;
+  ctx->triggered_pending = false;
+  ctx->adv.pending = false;
+  ctx->trickle.enabled = false;
+  ctx->trickle.rand = ((uint16_t)ctx->id << 8) | 0x5A; // semilla distinta en cada nodo
+  ctx->now = 0;
+  ctx->route_lifetime = MESH_ROUTING_ROUTE_LIFETIME;
+  ctx->flooding = false;
+  ctx->flood_seq = FLOOD_SEQ_NONE;
+  ctx->flood_seen_next = 0;
+  for (int i = 0; i < MESH_ROUTING_FLOOD_CACHE; i++) {
+    ctx->flood_seen[i][0] = BROADCAST_DIR; // ningún broadcast tiene este origen
+  }
+  for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+    ctx->flood_pending[i].msg = NULL;
+  }
+  ctx->link_cost = mesh_routing_metric_hop_count;
+  for (int i = 0; i < MESH_ROUTING_MAX_LINKS; i++) {
+    ctx->links[i].neighbor = NULL_DIR;
+  }
+  ctx->links_next = 0;
+  atomic_store(&ctx->table_seq, 0);
+  mesh_routing_reset_stats(ctx);
+#if MESH_ROUTING_TRACE_SIZE > 0
+  atomic_store(&ctx->trace_enabled, false);
+  atomic_store(&ctx->trace_head, 0);
+  atomic_store(&ctx->trace_time, 0);
+  for (int i = 0; i < MESH_ROUTING_TRACE_SIZE; i++) {
+    atomic_store(&ctx->trace_commit[i], 0);
+  }
+#endif
+  struct neighbor_list * neighbor_aux = mesh_routing_get_free_element_in_table(ctx, ctx->id);
+  neighbor_aux->seq = 0;
+  mesh_routing_add_path_in_table(neighbor_aux, ctx->id, 0, 0);
+  return 0;
+}
+
+void mesh_routing_send_msg(struct mesh_routing_ctx * ctx, uint8_t * msg) {
+
+  if (msg[OPCODE] >= OPCODE_ROUTING_MIN && msg[OPCODE] <= OPCODE_ROUTING_MAX) {
+    mesh_port_routing_lock();
+    mesh_routing_process_msg(ctx, msg);
+    mesh_port_routing_unlock();
+
+  } else {
+    mesh_routing_routing_msg(ctx, msg);
+  }
+}
+
+void mesh_routing_send_msgs(struct mesh_routing_ctx * ctx, uint8_t ** msgs, uint16_t count) {
+
+  while (count > 0) {
+    uint8_t batch = count < MESH_ROUTING_BATCH_MAX ? count : MESH_ROUTING_BATCH_MAX;
+
+    mesh_routing_routing_batch(ctx, msgs, batch);
+    msgs = msgs + batch;
+    count = count - batch;
+  }
+}
+
+bool mesh_routing_get_route(struct mesh_routing_ctx * ctx, uint8_t dst, uint8_t * next_hop,
+                            uint8_t * metric) {
+
+  *next_hop = mesh_routing_read_next_hop(ctx, dst, 0, metric);
+  return *next_hop != UNREACHABLE_DIR;
+}
+
+void mesh_routing_set_trickle(struct mesh_routing_ctx * ctx, bool enable) {
+  mesh_port_routing_lock();
+  ctx->trickle.enabled = enable;
+  ctx->trickle.interval = MESH_ROUTING_TRICKLE_IMIN;
+  ctx->trickle.suppressed = 0;
+  ctx->trickle.rand = ((uint16_t)ctx->id << 8) | 0x5A; // semilla distinta en cada nodo
+  mesh_routing_trickle_start_interval(ctx);
+  ctx->route_lifetime = enable ? TRICKLE_ROUTE_LIFETIME : MESH_ROUTING_ROUTE_LIFETIME;
+  mesh_routing_timer_rebuild(ctx);
+  mesh_port_routing_unlock();
+}
+
+void mesh_routing_set_flooding(struct mesh_routing_ctx * ctx, bool enable) {
+  mesh_port_routing_lock();
+  ctx->flooding = enable;
+  if (enable == false) {
+    for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+      mesh_msg_release(ctx->flood_pending[i].msg);
+      ctx->flood_pending[i].msg = NULL;
+    }
+  }
+  mesh_port_routing_unlock();
+}
+
+void mesh_routing_set_metric(struct mesh_routing_ctx * ctx,
+                             uint8_t (*link_cost)(const struct mesh_routing_link * link)) {
+  mesh_port_routing_lock();
+  ctx->link_cost = link_cost != NULL ? link_cost : mesh_routing_metric_hop_count;
+  for (int i = 0; i < MESH_ROUTING_MAX_LINKS; i++) {
+    if (ctx->links[i].neighbor != NULL_DIR) {
+      ctx->links[i].cost = ctx->link_cost(&ctx->links[i]);
+    }
+  }
+  mesh_port_routing_unlock();
+}
+
+uint8_t mesh_routing_metric_hop_count(const struct mesh_routing_link * link) {
+  (void)link;
+  return 1;
+}
+
+uint8_t mesh_routing_metric_etx(const struct mesh_routing_link * link) {
+  uint32_t cost = MESH_ROUTING_LINK_MAX_COST;
+
+  if (link->delivery > 0) {
+    cost = (MESH_ROUTING_LINK_UNIT * LINK_DELIVERY_FULL + link->delivery / 2) / link->delivery;
+  }
+  return cost < MESH_ROUTING_LINK_MAX_COST ? (uint8_t)cost : MESH_ROUTING_LINK_MAX_COST;
+}
+
+uint8_t mesh_routing_metric_rssi(const struct mesh_routing_link * link) {
+  int below = MESH_ROUTING_RSSI_GOOD * LINK_RSSI_SCALE - link->rssi;
+  int cost = MESH_ROUTING_LINK_UNIT;
+
+  if (link->rssi_valid == true && below > 0) {
+    cost = cost + below / (MESH_ROUTING_RSSI_STEP * LINK_RSSI_SCALE);
+  }
+  return cost < MESH_ROUTING_LINK_MAX_COST ? (uint8_t)cost : MESH_ROUTING_LINK_MAX_COST;
+}
+
+void mesh_routing_link_tx(struct mesh_routing_ctx * ctx, uint8_t neighbor, bool acked) {
+  mesh_port_routing_lock();
+  struct mesh_routing_link * link = mesh_routing_get_link(ctx, neighbor);
+  int sample = acked ? LINK_DELIVERY_FULL : 0;
+
+  link->delivery = (uint16_t)(link->delivery + (sample - (int)link->delivery) /
+                                                   (1 << MESH_ROUTING_LINK_EWMA_SHIFT));
+  mesh_routing_link_update(ctx, link);
+  mesh_port_routing_unlock();
+}
+
+void mesh_routing_link_rssi(struct mesh_routing_ctx * ctx, uint8_t neighbor, int8_t rssi) {
+  mesh_port_routing_lock();
+  struct mesh_routing_link * link = mesh_routing_get_link(ctx, neighbor);
+  int sample = rssi * LINK_RSSI_SCALE;
+
+  if (link->rssi_valid == false) {
+    link->rssi = (int16_t)sample;
+    link->rssi_valid = true;
+  } else {
+    link->rssi =
+        (int16_t)(link->rssi + (sample - link->rssi) / (1 << MESH_ROUTING_LINK_EWMA_SHIFT));
+  }
+  mesh_routing_link_update(ctx, link);
+  mesh_port_routing_unlock();
+}
+
+void mesh_routing_handler_time_out(struct mesh_routing_ctx * ctx) {
+  mesh_port_routing_lock();
+  mesh_routing_timer_tick(ctx);
+  mesh_routing_flood_tick(ctx);
+
+  if (ctx->adv.pending == true) {
+    mesh_routing_adv_send(ctx);
+  }
+
+  if (ctx->trickle.enabled == true) {
+    mesh_routing_trickle_handler_time_out(ctx);
+    mesh_port_routing_unlock();
+    return;
+  }
+
+  switch (ctx->paso) {
+  case 0:
+    mesh_routing_send_periodic_update(ctx);
+    ctx->paso = 1;
+    break;
   case 1:
-    mesh_routing_set_time_out_true();
-    paso = 2;
+    mesh_routing_send_triggered_update(ctx);
+    ctx->paso = 2;
     break;
   case 2:
-    mesh_routing_send_neighbor();
-    paso = 3;
+    mesh_routing_send_periodic_update(ctx);
+    ctx->paso = 3;
     break;
   case 3:
-    mesh_routing_delete_item_due_to_timeout();
-    paso = 0;
+    mesh_routing_send_triggered_update(ctx);
+    ctx->paso = 0;
     break;
   default:
-    paso = 0;
+    ctx->paso = 0;
     break;
   };
+
+  mesh_port_routing_unlock();
+}
+
+uint16_t mesh_routing_idle_ticks(struct mesh_routing_ctx * ctx) {
+  mesh_port_routing_lock();
+  uint16_t idle = mesh_routing_timer_idle_ticks(ctx);
+
+  for (int i = 0; i < MESH_ROUTING_FLOOD_PENDING; i++) {
+    if (ctx->flood_pending[i].msg != NULL) {
+      uint16_t next = ctx->flood_pending[i].fire_at - ctx->now - 1;
+      idle = next < idle ? next : idle;
+    }
+  }
+
+  if (ctx->trickle.enabled == true) {
+    uint16_t next = ctx->trickle.interval - ctx->trickle.ticks - 1;
+    if (ctx->trickle.fire_at > ctx->trickle.ticks &&
+        ctx->trickle.fire_at - ctx->trickle.ticks - 1 < next) {
+      next = ctx->trickle.fire_at - ctx->trickle.ticks - 1;
+    }
+    if (next < idle) {
+      idle = next;
+    }
+  } else if ((ctx->paso == 1 || ctx->paso == 3) && ctx->triggered_pending == false) {
+    idle = idle < 1 ? idle : 1; // el paso siguiente solo anuncia si hay cambios
+  } else {
+    idle = 0;
+  }
+  if (ctx->adv.pending == true) {
+    idle = 0; // el anuncio a medias sigue en el paso siguiente
+  }
+
+  mesh_port_routing_unlock();
+  return idle;
+}
+
+uint8_t mesh_routing_get_id(struct mesh_routing_ctx * ctx) {
+  return ctx->id;
+}
+
+void mesh_routing_get_stats(struct mesh_routing_ctx * ctx, struct mesh_routing_stats * stats) {
+  for (int i = 0; i < MESH_ROUTING_STAT_COUNT; i++) {
+    stats->counters[i] = atomic_load_explicit(&ctx->stats[i], memory_order_relaxed);
+  }
+  for (int i = 0; i < MESH_ROUTING_LATENCY_BUCKETS; i++) {
+    stats->lookup_latency[i] = atomic_load_explicit(&ctx->lookup_latency[i], memory_order_relaxed);
+  }
+}
+
+void mesh_routing_reset_stats(struct mesh_routing_ctx * ctx) {
+  for (int i = 0; i < MESH_ROUTING_STAT_COUNT; i++) {
+    atomic_store_explicit(&ctx->stats[i], 0, memory_order_relaxed);
+  }
+  for (int i = 0; i < MESH_ROUTING_LATENCY_BUCKETS; i++) {
+    atomic_store_explicit(&ctx->lookup_latency[i], 0, memory_order_relaxed);
+  }
+}
+
+void mesh_routing_set_trace(struct mesh_routing_ctx * ctx, bool enable) {
+#if MESH_ROUTING_TRACE_SIZE > 0
+  atomic_store_explicit(&ctx->trace_enabled, enable, memory_order_relaxed);
+#else
+  (void)ctx;
+  (void)enable;
+#endif
+}
+
+uint16_t mesh_routing_trace_dump(struct mesh_routing_ctx * ctx, uint8_t * buffer, uint16_t size) {
+  unsigned int head = 0;
+  uint16_t count = 0;
+
+  if (size < MESH_ROUTING_TRACE_HEADER_SIZE) {
+    return 0;
+  }
+
+#if MESH_ROUTING_TRACE_SIZE > 0
+  head = atomic_load_explicit(&ctx->trace_head, memory_order_acquire);
+  unsigned int available = head < MESH_ROUTING_TRACE_SIZE ? head : MESH_ROUTING_TRACE_SIZE;
+  unsigned int fit = (size - MESH_ROUTING_TRACE_HEADER_SIZE) / MESH_ROUTING_TRACE_EVENT_SIZE;
+  count = available < fit ? available : fit;
+
+  uint8_t * data = &buffer[MESH_ROUTING_TRACE_HEADER_SIZE];
+  unsigned int first = head - count;
+  count = 0;
+  for (unsigned int i = first; i != head; i++) {
+    unsigned int position = i % MESH_ROUTING_TRACE_SIZE;
+    if (atomic_load_explicit(&ctx->trace_commit[position], memory_order_acquire) != i + 1) {
+      continue; // todavía se está escribiendo o ya se reemplazó
+    }
+    struct mesh_routing_trace_event event = ctx->trace[position];
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&ctx->trace_commit[position], memory_order_relaxed) != i + 1) {
+      continue; // se reemplazó mientras se copiaba
+    }
+    data[0] = event.time >> 8;
+    data[1] = event.time & 0xFF;
+    data[2] = event.type;
+    data[3] = event.dst;
+    data[4] = event.next_hop;
+    data[5] = event.metric;
+    data[6] = event.extra;
+    data[7] = 0;
+    data = data + MESH_ROUTING_TRACE_EVENT_SIZE;
+    count++;
+  }
+#endif
+
+  unsigned int lost = head - count;
+  if (lost > UINT16_MAX) {
+    lost = UINT16_MAX;
+  }
+  buffer[0] = TRACE_MAGIC_0;
+  buffer[1] = TRACE_MAGIC_1;
+  buffer[2] = TRACE_VERSION;
+  buffer[3] = ctx->id;
+  buffer[4] = count >> 8;
+  buffer[5] = count & 0xFF;
+  buffer[6] = lost >> 8;
+  buffer[7] = lost & 0xFF;
+  return MESH_ROUTING_TRACE_HEADER_SIZE + count * MESH_ROUTING_TRACE_EVENT_SIZE;
+}
+
+int mesh_routing_snapshot_save(struct mesh_routing_ctx * ctx,
+                               const struct mesh_routing_storage * storage) {
+  struct snapshot_stream stream = {
+      .storage = storage, .offset = SNAPSHOT_HEADER_SIZE, .crc = SNAPSHOT_CRC_INIT};
+  uint8_t chunk[SNAPSHOT_CHUNK_SIZE];
+  uint8_t header[SNAPSHOT_HEADER_SIZE];
+  uint8_t crc[SNAPSHOT_CRC_SIZE];
+  uint8_t count = 0;
+  int next = 0;
+  int result = 0;
+
+  header[0] = SNAPSHOT_MAGIC_0;
+  header[1] = SNAPSHOT_MAGIC_1;
+  header[2] = SNAPSHOT_VERSION;
+  header[3] = ctx->id;
+
+  // las rutas se arman de a bloques con el lock tomado y se escriben con el lock liberado
+  while (next >= 0 && result == 0) {
+    uint16_t len = 0;
+
+    mesh_port_routing_lock();
+    for (next = mesh_routing_next_used(ctx, next); next >= 0;
+         next = mesh_routing_next_used(ctx, next + 1)) {
+      struct neighbor_list * neighbor_aux = &ctx->neig_list[next];
+      if (neighbor_aux->dst == ctx->id || neighbor_aux->path_count == 0) {
+        continue;
+      }
+      if (len + SNAPSHOT_ROUTE_SIZE + SNAPSHOT_PATH_SIZE * neighbor_aux->path_count >
+          SNAPSHOT_CHUNK_SIZE) {
+        break; // sigue en el próximo bloque
+      }
+      chunk[len++] = neighbor_aux->dst;
+      chunk[len++] = neighbor_aux->seq;
+      chunk[len++] = neighbor_aux->path_count;
+      for (int j = 0; j < neighbor_aux->path_count; j++) {
+        chunk[len++] = neighbor_aux->paths[j].next_hop;
+        chunk[len++] = neighbor_aux->paths[j].metric;
+      }
+      count++;
+    }
+    if (next < 0) {
+      header[4] = mesh_routing_search_element_in_table(ctx, ctx->id)->seq;
+    }
+    mesh_port_routing_unlock();
+
+    if (len > 0) {
+      result = mesh_routing_snapshot_write(&stream, chunk, len);
+    }
+  }
+  if (result != 0) {
+    return -1;
+  }
+
+  header[5] = count;
+  stream.crc = mesh_routing_snapshot_crc(stream.crc, header, sizeof(header));
+  crc[0] = stream.crc >> 8;
+  crc[1] = stream.crc & 0xFF;
+  if (mesh_routing_snapshot_write(&stream, crc, sizeof(crc)) != 0 ||
+      storage->write(storage->user, 0, header, sizeof(header)) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int mesh_routing_snapshot_restore(struct mesh_routing_ctx * ctx,
+                                  const struct mesh_routing_storage * storage) {
+  struct snapshot_stream stream = {.storage = storage, .offset = 0, .crc = SNAPSHOT_CRC_INIT};
+  uint32_t loaded[MESH_ROUTING_MAP_WORDS(MESH_ROUTING_MAX_CAPACITY)] = {0};
+  uint8_t seq;
+
+  if (mesh_routing_snapshot_load(ctx, &stream, NULL, &seq) != 0) {
+    return -1;
+  }
+
+  stream.offset = 0;
+  mesh_port_routing_lock();
+  mesh_routing_table_write_begin(ctx);
+  int result = mesh_routing_snapshot_load(ctx, &stream, loaded, &seq);
+
+  struct neighbor_list * own = mesh_routing_search_element_in_table(ctx, ctx->id);
+  if (result == 0 && mesh_routing_seq_newer(seq, own->seq) == true) {
+    own->seq = seq;
+  }
+  if (result == 0) {
+    ctx->stale_deadline = ctx->now + ctx->route_lifetime * MESH_ROUTING_FULL_SYNC_PERIOD;
+  }
+  for (int i = 0; i < ctx->neig_capacity; i++) {
+    if (mesh_routing_map_test(loaded, i) == false) {
+      continue;
+    }
+    struct neighbor_list * neighbor_aux = &ctx->neig_list[i];
+    if (result != 0) {
+      mesh_routing_delete_neighbor(ctx, neighbor_aux->dst); // la copia cambió en el medio
+      continue;
+    }
+    mesh_routing_map_set(ctx->stale_map, i);
+    mesh_routing_timer_arm(ctx, neighbor_aux);
+    mesh_routing_stat_add(ctx, MESH_ROUTING_STAT_ROUTES_ADDED, 1);
+    mesh_routing_trace_route(ctx, MESH_ROUTING_TRACE_ROUTE_ADD, neighbor_aux);
+  }
+  mesh_routing_table_write_end(ctx);
+  mesh_port_routing_unlock();
+  return result;
 }
 
-void mesh_routing_display_routing_table() {
+void mesh_routing_display_routing_table(struct mesh_routing_ctx * ctx) {
 
-  for (int i = 0; i < MAX_NEIGHBOR; i++) {
+  mesh_port_routing_lock();
+  for (int i = mesh_routing_next_used(ctx, 0); i >= 0; i = mesh_routing_next_used(ctx, i + 1)) {
 
-    if (neig_list[i].used == true) {
+    if (ctx->neig_list[i].path_count > 0) {
       uint8_t msg[50];
-      sprintf(msg, "DST: %d,NEXT HOP: %d, METRIC: %d\r\n", neig_list[i].dst, neig_list[i].next_hop,
-              neig_list[i].metric);
+      sprintf(msg, "DST: %d,NEXT HOP: %d, METRIC: %d\r\n", ctx->neig_list[i].dst,
+              ctx->neig_list[i].paths[0].next_hop, ctx->neig_list[i].paths[0].metric);
       mesh_print(msg);
     }
   }
+  mesh_port_routing_unlock();
 }
 
 /* === End of documentation
@@ -32,42 +32,691 @@ SPDX-License-Identifier: MIT
 #include "stdint.h"
 #include "stdbool.h"
 #include "stddef.h"
+#include "stdatomic.h"
 /* === Public macros definitions =============================================================== */
-#define MAX_NEIGHBOR 20
+#define MAX_NEIGHBOR               20 // capacidad por defecto de la tabla de rutas
+
+#define MESH_ROUTING_MAX_CAPACITY  253 // cantidad de direcciones unicast (0x00 a 0xFC)
+
+#ifndef MESH_ROUTING_MAX_PATHS
+#define MESH_ROUTING_MAX_PATHS 2 // caminos que se guardan para cada destino
+#endif
+
+#ifndef MESH_ROUTING_MULTIPATH_TOLERANCE
+#define MESH_ROUTING_MULTIPATH_TOLERANCE 0 // diferencia de métrica admitida para repartir tráfico
+#endif
+
+#define MESH_ROUTING_ENTRY_SIZE (4 + 4 * MESH_ROUTING_MAX_PATHS) // bytes por ruta, sin los mapas
+
+#ifndef MESH_ROUTING_ROUTE_LIFETIME
+#define MESH_ROUTING_ROUTE_LIFETIME 4 // pasos del handler que dura un camino sin anunciarse
+#endif
+
+#ifndef MESH_ROUTING_WHEEL_SLOTS
+#define MESH_ROUTING_WHEEL_SLOTS 16 // posiciones por nivel de la rueda de tiempos, potencia de 2
+#endif
+
+#ifndef MESH_ROUTING_DEFAULT_TTL
+#define MESH_ROUTING_DEFAULT_TTL 64 // saltos de un msg de aplicación antes de descartarse
+#endif
+
+#ifndef MESH_ROUTING_BATCH_MAX
+#define MESH_ROUTING_BATCH_MAX 16 // msg que se entregan juntos a la capa conn
+#endif
+
+#ifndef MESH_ROUTING_FULL_SYNC_PERIOD
+#define MESH_ROUTING_FULL_SYNC_PERIOD 4 // cada cuántos anuncios periódicos se anuncia toda la tabla
+#endif
+
+#ifndef MESH_ROUTING_TRICKLE_IMIN
+#define MESH_ROUTING_TRICKLE_IMIN 2 // intervalo mínimo del modo adaptativo, en pasos del handler
+#endif
+
+#ifndef MESH_ROUTING_TRICKLE_IMAX
+#define MESH_ROUTING_TRICKLE_IMAX 64 // intervalo máximo del modo adaptativo, en pasos del handler
+#endif
+
+#ifndef MESH_ROUTING_TRICKLE_K
+#define MESH_ROUTING_TRICKLE_K 1 // anuncios de vecinos sin cambios que suprimen el anuncio propio
+#endif
+
+#ifndef MESH_ROUTING_FLOOD_CACHE
+#define MESH_ROUTING_FLOOD_CACHE 16 // broadcast recientes que se recuerdan para descartar copias
+#endif
+
+#ifndef MESH_ROUTING_FLOOD_PENDING
+#define MESH_ROUTING_FLOOD_PENDING 4 // broadcast que pueden esperar a retransmitirse a la vez
+#endif
+
+#ifndef MESH_ROUTING_FLOOD_JITTER
+#define MESH_ROUTING_FLOOD_JITTER 2 // pasos del handler entre los que se sortea la retransmisión
+#endif
+
+#ifndef MESH_ROUTING_FLOOD_SUPPRESS
+#define MESH_ROUTING_FLOOD_SUPPRESS 2 // copias escuchadas que suprimen la retransmisión propia
+#endif
+
+#ifndef MESH_ROUTING_MAX_LINKS
+#define MESH_ROUTING_MAX_LINKS 8 // vecinos de los que se mide la calidad del enlace
+#endif
+
+#ifndef MESH_ROUTING_LINK_UNIT
+#define MESH_ROUTING_LINK_UNIT 4 // costo de un enlace perfecto en las métricas ETX y RSSI
+#endif
+
+#ifndef MESH_ROUTING_LINK_MAX_COST
+#define MESH_ROUTING_LINK_MAX_COST 64 // costo máximo de un enlace
+#endif
+
+#ifndef MESH_ROUTING_LINK_EWMA_SHIFT
+#define MESH_ROUTING_LINK_EWMA_SHIFT 3 // cada muestra pesa 1/2^n en los promedios del enlace
+#endif
+
+#ifndef MESH_ROUTING_LINK_HYSTERESIS
+#define MESH_ROUTING_LINK_HYSTERESIS 2 // cambio mínimo del costo de un enlace que se aplica
+#endif
+
+#ifndef MESH_ROUTING_RSSI_GOOD
+#define MESH_ROUTING_RSSI_GOOD -60 // dBm desde los que el enlace se considera perfecto
+#endif
+
+#ifndef MESH_ROUTING_RSSI_STEP
+#define MESH_ROUTING_RSSI_STEP 6 // dB por debajo de MESH_ROUTING_RSSI_GOOD que suman 1 al costo
+#endif
+
+#ifndef MESH_ROUTING_LATENCY_BUCKETS
+#define MESH_ROUTING_LATENCY_BUCKETS 8 // intervalos del histograma de latencia de búsqueda
+#endif
+
+#ifndef MESH_ROUTING_LATENCY_BASE
+#define MESH_ROUTING_LATENCY_BASE 16 // ciclos del primer intervalo del histograma de latencia
+#endif
+
+#ifndef MESH_ROUTING_TRACE_SIZE
+#define MESH_ROUTING_TRACE_SIZE 64 // eventos del registro de trazas, potencia de 2; 0 lo quita
+#endif
+
+#define MESH_ROUTING_TRACE_HEADER_SIZE 8 // bytes del encabezado del volcado de trazas
+#define MESH_ROUTING_TRACE_EVENT_SIZE  8 // bytes por evento en el volcado de trazas
+
+/**
+ * @brief Tamaño en bytes del volcado de trazas con todos los eventos del registro
+ *
+ */
+#define MESH_ROUTING_TRACE_DUMP_SIZE                                                               \
+  (MESH_ROUTING_TRACE_HEADER_SIZE + MESH_ROUTING_TRACE_EVENT_SIZE * MESH_ROUTING_TRACE_SIZE)
+
+/**
+ * @brief Palabras de 32 bits de cada mapa de bits de una tabla de rutas de la capacidad indicada
+ *
+ */
+#define MESH_ROUTING_MAP_WORDS(capacity) (((capacity) + 31) / 32)
+
+/**
+ * @brief Tamaño en bytes de la arena necesaria para una tabla de rutas de la capacidad indicada
+ *
+ */
+#define MESH_ROUTING_ARENA_SIZE(capacity)                                                          \
+  ((size_t)(capacity)*MESH_ROUTING_ENTRY_SIZE +                                                    \
+   4 * MESH_ROUTING_MAP_WORDS(capacity) * sizeof(uint32_t))
+
+/**
+ * @brief Tamaño máximo en bytes de la copia de una tabla de rutas de la capacidad indicada: el
+ * encabezado, una ruta por posición salvo la propia y el CRC
+ *
+ */
+#define MESH_ROUTING_SNAPSHOT_MAX_SIZE(capacity)                                                   \
+  (6 + ((capacity)-1) * (3 + 2 * MESH_ROUTING_MAX_PATHS) + 2)
 
 /* === Public data type declarations =========================================================== */
 
+struct neighbor_list;
+
+/**
+ * @brief Contadores de la capa routing
+ *
+ */
+enum mesh_routing_stat {
+  /** @brief msg reenviados hacia otro nodo */
+  MESH_ROUTING_STAT_FORWARDED,
+  /** @brief msg entregados a la capa de aplicación del propio nodo */
+  MESH_ROUTING_STAT_DELIVERED,
+  /** @brief msg descartados por no tener ruta hacia el destino */
+  MESH_ROUTING_STAT_DROPPED_UNREACHABLE,
+  /** @brief msg descartados por haber agotado sus saltos (campo TTL) */
+  MESH_ROUTING_STAT_DROPPED_TTL,
+  /** @brief Rutas nuevas agregadas a la tabla */
+  MESH_ROUTING_STAT_ROUTES_ADDED,
+  /** @brief Rutas que perdieron el mejor camino y pasaron a usar el siguiente */
+  MESH_ROUTING_STAT_PATH_SWAPS,
+  /** @brief Rutas perdidas porque expiraron todos sus caminos */
+  MESH_ROUTING_STAT_ROUTES_EXPIRED,
+  /** @brief Fragmentos de anuncio enviados */
+  MESH_ROUTING_STAT_ADV_SENT,
+  /** @brief Fragmentos de anuncio recibidos */
+  MESH_ROUTING_STAT_ADV_RECEIVED,
+  /** @brief Bytes de anuncios enviados, encabezado incluido */
+  MESH_ROUTING_STAT_BYTES_SENT,
+  /** @brief Broadcast de otros nodos retransmitidos en modo inundación */
+  MESH_ROUTING_STAT_FLOOD_RELAYED,
+  /** @brief Copias de broadcast ya recibidos descartadas en modo inundación */
+  MESH_ROUTING_STAT_FLOOD_DUPLICATES,
+  /** @brief Retransmisiones suprimidas por haber escuchado suficientes copias */
+  MESH_ROUTING_STAT_FLOOD_SUPPRESSED,
+  MESH_ROUTING_STAT_COUNT,
+};
+
+/**
+ * @brief Copia de los contadores de un nodo. lookup_latency[i] cuenta las búsquedas de ruta que
+ * tardaron menos de MESH_ROUTING_LATENCY_BASE << i ciclos de mesh_port_cycles() y no entraron en
+ * un intervalo anterior; el último intervalo no tiene límite.
+ *
+ */
+struct mesh_routing_stats {
+  uint32_t counters[MESH_ROUTING_STAT_COUNT];
+  uint32_t lookup_latency[MESH_ROUTING_LATENCY_BUCKETS];
+};
+
+/**
+ * @brief Eventos del registro de trazas. Cada evento lleva el paso del handler y cuatro campos,
+ * cuyo significado depende del tipo; los que no se usan van en 0.
+ *
+ */
+enum mesh_routing_trace_type {
+  /** @brief Ruta nueva en la tabla: dst, next_hop y metric de su camino, extra es su seq */
+  MESH_ROUTING_TRACE_ROUTE_ADD,
+  /** @brief Cambió el mejor camino de una ruta: dst, next_hop y metric del nuevo, extra es seq */
+  MESH_ROUTING_TRACE_PATH_SWAP,
+  /** @brief Una ruta perdió todos sus caminos: dst, extra es su seq ya marcado como perdido */
+  MESH_ROUTING_TRACE_ROUTE_EXPIRE,
+  /** @brief msg reenviado: dst, next_hop elegido, metric de la ruta, extra es el origen */
+  MESH_ROUTING_TRACE_FORWARD,
+  /** @brief msg descartado por no tener ruta: dst, extra es el origen */
+  MESH_ROUTING_TRACE_DROP_UNREACHABLE,
+  /** @brief msg descartado por haber agotado sus saltos: dst, extra es el origen */
+  MESH_ROUTING_TRACE_DROP_TTL,
+  /** @brief Fragmento de anuncio enviado: metric es el largo, extra el número de fragmento */
+  MESH_ROUTING_TRACE_ADV_SENT,
+  MESH_ROUTING_TRACE_TYPE_COUNT,
+};
+
+/**
+ * @brief Evento del registro de trazas
+ *
+ */
+struct mesh_routing_trace_event {
+  /** @brief Paso del handler en el que ocurrió */
+  uint16_t time;
+  /** @brief Tipo, enum mesh_routing_trace_type */
+  uint8_t type;
+  uint8_t dst;
+  uint8_t next_hop;
+  uint8_t metric;
+  /** @brief Número de secuencia, origen del msg o número de fragmento, según el tipo */
+  uint8_t extra;
+};
+
+/**
+ * @brief Estado del temporizador de anuncios en modo adaptativo, basado en el algoritmo Trickle
+ * (RFC 6206). El intervalo se duplica mientras la red no cambia y vuelve al mínimo ante una
+ * inconsistencia. Dentro de cada intervalo se anuncia en un paso al azar de su segunda mitad,
+ * salvo que ya se hayan escuchado MESH_ROUTING_TRICKLE_K anuncios de vecinos sin cambios.
+ *
+ */
+struct mesh_routing_trickle {
+  bool enabled;
+  uint16_t interval;
+  uint16_t fire_at;
+  uint16_t ticks;
+  uint16_t rand;
+  uint8_t counter;
+  uint8_t suppressed;
+};
+
+/**
+ * @brief Anuncio que no se terminó de enviar porque el pool de msg se agotó. Los fragmentos que
+ * faltan se envían en los pasos siguientes del handler, a partir de la primera ruta que no se
+ * envió.
+ *
+ */
+struct mesh_routing_adv_cursor {
+  /** @brief Hay un anuncio a medias */
+  bool pending;
+  /** @brief El anuncio lleva toda la tabla */
+  bool full;
+  /** @brief Es el anuncio periódico, que al terminar avanza la cuenta hasta el completo */
+  bool periodic;
+  /** @brief Número del próximo fragmento a enviar */
+  uint8_t fragment;
+  /** @brief Via del grupo de la primera ruta sin enviar */
+  uint8_t via;
+  /** @brief Destino de la primera ruta sin enviar */
+  uint8_t dst;
+};
+
+/**
+ * @brief Retransmisión pendiente de un broadcast en modo inundación
+ *
+ */
+struct mesh_routing_flood_relay {
+  /** @brief msg retenido hasta retransmitirse, NULL si la posición está libre */
+  uint8_t * msg;
+  /** @brief Paso del handler en el que se retransmite */
+  uint16_t fire_at;
+  /** @brief Copias del mismo broadcast escuchadas mientras espera */
+  uint8_t copies;
+};
+
+/**
+ * @brief Calidad del enlace con un vecino, calculada a partir de las muestras que entrega el port
+ *
+ */
+struct mesh_routing_link {
+  /** @brief id del vecino, NULL_DIR si la posición está libre */
+  uint8_t neighbor;
+  /** @brief Costo del enlace que se suma a las métricas anunciadas por el vecino */
+  uint8_t cost;
+  /** @brief Proporción de envíos confirmados por el vecino, en 1/256; promedio móvil exponencial */
+  uint16_t delivery;
+  /** @brief RSSI de las tramas del vecino, en 1/16 dBm; promedio móvil exponencial */
+  int16_t rssi;
+  /** @brief Se recibió al menos una muestra de RSSI */
+  bool rssi_valid;
+};
+
+/**
+ * @brief Medio donde se guarda la copia de la tabla de rutas, por ejemplo un archivo o una región
+ * de la flash. La copia se escribe y se lee en orden desde el desplazamiento 0.
+ *
+ */
+struct mesh_routing_storage {
+  /** @brief Escribe len bytes a partir de offset, devuelve 0 si se escribieron o -1 si falló */
+  int (*write)(void * user, uint16_t offset, const uint8_t * data, uint16_t len);
+  /** @brief Lee len bytes a partir de offset, devuelve 0 si se leyeron o -1 si falló */
+  int (*read)(void * user, uint16_t offset, uint8_t * data, uint16_t len);
+  /** @brief Dato del llamador que se pasa a write y read */
+  void * user;
+};
+
+/**
+ * @brief Contexto de una instancia de la capa routing, es decir de un nodo. Guarda todo el estado
+ * de la capa, por lo que un mismo proceso puede tener varios nodos, por ejemplo para simular una
+ * red. El llamador reserva el contexto y la arena de la tabla; los campos solo los usa
+ * mesh_routing.c.
+ *
+ */
+struct mesh_routing_ctx {
+  /** @brief id del nodo */
+  uint8_t id;
+  /** @brief Tabla de rutas, ubicada al comienzo de la arena */
+  struct neighbor_list * neig_list;
+  /** @brief Cantidad de elementos de la tabla de rutas */
+  uint8_t neig_capacity;
+  /**
+   * @brief Mapa de bits de las posiciones ocupadas de la tabla, un bit por posición, en la arena a
+   * continuación de la tabla. Los recorridos de la tabla saltean de a una palabra las libres.
+   */
+  uint32_t * used_map;
+  /** @brief Mapa de bits de las rutas modificadas desde el último anuncio, a continuación */
+  uint32_t * dirty_map;
+  /** @brief Mapa de bits de las rutas que están en la rueda de tiempos, a continuación */
+  uint32_t * armed_map;
+  /**
+   * @brief Mapa de bits de las rutas restauradas de una copia que ningún vecino volvió a anunciar,
+   * a continuación. Se usan para reenviar pero no se anuncian.
+   */
+  uint32_t * stale_map;
+  /**
+   * @brief Paso del handler en el que se eliminan las rutas restauradas que siguen sin confirmar.
+   * Un vecino anuncia al menos una vez por vida de camino y toda su tabla cada
+   * MESH_ROUTING_FULL_SYNC_PERIOD anuncios, por lo que para entonces ya anunció todas sus rutas.
+   */
+  uint16_t stale_deadline;
+  /** @brief Cantidad de posiciones libres de la tabla */
+  uint8_t free_slots_count;
+  /** @brief Paso actual del handler de time out */
+  uint8_t paso;
+  /** @brief Cantidad de anuncios periódicos enviados desde el último anuncio completo */
+  uint8_t periodic_count;
+  /** @brief Hay rutas modificadas que deben anunciarse en el próximo paso del handler */
+  bool triggered_pending;
+  /** @brief Anuncio a medias que se sigue enviando en los pasos siguientes */
+  struct mesh_routing_adv_cursor adv;
+  /** @brief Temporizador de anuncios del modo adaptativo */
+  struct mesh_routing_trickle trickle;
+  /** @brief Pasos del handler desde la inicialización; da la vuelta */
+  uint16_t now;
+  /** @brief Pasos del handler que dura un camino sin volver a anunciarse */
+  uint16_t route_lifetime;
+  /**
+   * @brief Rueda de tiempos jerárquica de dos niveles con el vencimiento de las rutas. Cada
+   * posición es el comienzo de una lista de rutas enlazadas por su posición en la tabla.
+   */
+  uint8_t wheel[2][MESH_ROUTING_WHEEL_SLOTS];
+  /** @brief Modo inundación de broadcast activo */
+  bool flooding;
+  /** @brief Número de secuencia del último broadcast propio inundado */
+  uint8_t flood_seq;
+  /** @brief Buffer circular con el par {origen, secuencia} de los últimos broadcast vistos */
+  uint8_t flood_seen[MESH_ROUTING_FLOOD_CACHE][2];
+  /** @brief Posición del buffer circular flood_seen que se reemplaza a continuación */
+  uint8_t flood_seen_next;
+  /** @brief Retransmisiones de broadcast pendientes */
+  struct mesh_routing_flood_relay flood_pending[MESH_ROUTING_FLOOD_PENDING];
+  /** @brief Métrica en uso, calcula el costo de un enlace */
+  uint8_t (*link_cost)(const struct mesh_routing_link * link);
+  /** @brief Calidad del enlace con los vecinos */
+  struct mesh_routing_link links[MESH_ROUTING_MAX_LINKS];
+  /** @brief Posición de links que se reemplaza cuando no hay lugar para un vecino nuevo */
+  uint8_t links_next;
+  /**
+   * @brief Número de secuencia de la tabla de rutas (seqlock). Es impar mientras se está
+   * modificando la tabla. Los lectores leen sin tomar ningún lock y repiten la lectura si la
+   * secuencia era impar o cambió durante la lectura. Los escritores se serializan con
+   * mesh_port_routing_lock().
+   */
+  atomic_uint table_seq;
+  /**
+   * @brief Índice directo destino -> posición en la tabla de rutas. Como las direcciones son de 8
+   * bits cada destino tiene su propia entrada, por lo que la búsqueda es de tiempo constante.
+   */
+  uint8_t neig_index[UINT8_MAX + 1];
+  /**
+   * @brief Contadores, indexados por enum mesh_routing_stat. Son atómicos para que se puedan
+   * incrementar desde el camino de reenvío sin tomar el lock de la tabla.
+   */
+  atomic_uint stats[MESH_ROUTING_STAT_COUNT];
+  /** @brief Histograma de latencia de búsqueda de ruta, ver struct mesh_routing_stats */
+  atomic_uint lookup_latency[MESH_ROUTING_LATENCY_BUCKETS];
+#if MESH_ROUTING_TRACE_SIZE > 0
+  /** @brief Registro de trazas activo, se puede cambiar desde cualquier hilo */
+  atomic_bool trace_enabled;
+  /**
+   * @brief Eventos registrados desde la inicialización. Cada hilo que registra un evento toma su
+   * posición incrementándolo, por lo que el registro no necesita lock.
+   */
+  atomic_uint trace_head;
+  /** @brief Copia de now para los hilos que registran eventos sin tomar el lock de la tabla */
+  atomic_ushort trace_time;
+  /**
+   * @brief Marca de cada posición del buffer circular: 0 mientras se escribe y el número de evento
+   * más uno cuando el evento está completo. El volcado descarta las posiciones que cambian mientras
+   * las lee, así nunca entrega un evento a medio escribir.
+   */
+  atomic_uint trace_commit[MESH_ROUTING_TRACE_SIZE];
+  /** @brief Buffer circular de eventos; cuando se llena cada evento reemplaza al más antiguo */
+  struct mesh_routing_trace_event trace[MESH_ROUTING_TRACE_SIZE];
+#endif
+};
+
 /* === Public variable declarations ============================================================ */
 
 /* === Public function declarations ============================================================ */
 
 /**
- * @brief Función que inicializa y vacía la tabla de rutas.
+ * @brief Función que inicializa un nodo y vacía su tabla de rutas. Se debe llamar antes de que
+ * otros hilos usen el nodo. La tabla se construye sobre la memoria provista por el llamador, por lo
+ * que la misma imagen puede manejar redes de distinto tamaño. Cuando la tabla está llena una ruta
+ * nueva reemplaza a la ruta de peor métrica, siempre que la nueva sea mejor; en caso contrario la
+ * ruta nueva se descarta.
  *
+ * @param ctx contexto del nodo
+ * @param id id del nodo en la red mesh
+ * @param capacity cantidad máxima de rutas, incluida la del propio nodo (1 a
+ * MESH_ROUTING_MAX_CAPACITY)
+ * @param arena memoria para la tabla, alineada a 4 bytes, de al menos
+ * MESH_ROUTING_ARENA_SIZE(capacity) bytes
+ * @param arena_size tamaño en bytes de la arena
+ * @return int 0 si se inicializó, -1 si los parámetros son inválidos
  */
-void mesh_routing_init(void);
+int mesh_routing_init(struct mesh_routing_ctx * ctx, uint8_t id, uint8_t capacity, void * arena,
+                      size_t arena_size);
 
 /**
  * @brief Función que permite enviar un mensaje a la capa routing
  *
+ * @param ctx contexto del nodo
  * @param msg msg a enviar a la capa routing
  */
-void mesh_routing_send_msg(uint8_t * msg);
+void mesh_routing_send_msg(struct mesh_routing_ctx * ctx, uint8_t * msg);
+
+/**
+ * @brief Función que permite enviar a la capa routing varios msg recibidos juntos, por ejemplo en
+ * una misma ráfaga de la radio. Los msg de la capa routing se procesan en orden y los que hay que
+ * reenviar se entregan a la capa conn con mesh_conn_send_msgs(), agrupados por próximo salto, en
+ * una llamada cada MESH_ROUTING_BATCH_MAX msg.
+ *
+ * @param ctx contexto del nodo
+ * @param msgs arreglo de msg a enviar a la capa routing
+ * @param count cantidad de msg del arreglo
+ */
+void mesh_routing_send_msgs(struct mesh_routing_ctx * ctx, uint8_t ** msgs, uint16_t count);
+
+/**
+ * @brief Función que consulta la ruta hacia un destino. No toma ningún lock, por lo que se puede
+ * llamar desde cualquier hilo mientras otro modifica la tabla; el próximo salto y la métrica
+ * devueltos siempre corresponden a un mismo estado de la tabla.
+ *
+ * @param ctx contexto del nodo
+ * @param dst destino a consultar
+ * @param next_hop próximo salto del mejor camino, UNREACHABLE_DIR si no se alcanza el destino
+ * @param metric métrica del mejor camino
+ * @return true si el destino es alcanzable
+ */
+bool mesh_routing_get_route(struct mesh_routing_ctx * ctx, uint8_t dst, uint8_t * next_hop,
+                            uint8_t * metric);
+
+/**
+ * @brief Devuelve el id del nodo
+ *
+ * @param ctx contexto del nodo
+ * @return uint8_t id del nodo
+ */
+uint8_t mesh_routing_get_id(struct mesh_routing_ctx * ctx);
 
 /**
  * @brief Función que muestra la tabla de rutas
  *
+ * @param ctx contexto del nodo
  */
-void mesh_routing_display_routing_table();
+void mesh_routing_display_routing_table(struct mesh_routing_ctx * ctx);
 
 /**
  * @brief Handler que envía los mensajes hello para el descubrimiento de vecinos y verifica que las
  * rutas sigan disponibles. Si se ejecuta esta handler cada X segundos, el mensaje hello se enviará
- * con una frecuencia de 2*X segundos. y se verificará que las rutas estén disponibles cada 3*X
- * segundos.
+ * con una frecuencia de 2*X segundos. Cada camino vence MESH_ROUTING_ROUTE_LIFETIME pasos después
+ * de su último anuncio; los vencimientos se llevan en una rueda de tiempos, por lo que el costo de
+ * cada paso depende de las rutas que vencen y no del tamaño de la tabla. Los anuncios periódicos
+ * solo llevan las rutas modificadas, salvo uno de cada MESH_ROUTING_FULL_SYNC_PERIOD que lleva toda
+ * la tabla. Cuando cambia una métrica o se pierde una ruta el cambio se anuncia en el siguiente
+ * paso, sin esperar al anuncio periódico.
+ *
+ * @param ctx contexto del nodo
+ */
+void mesh_routing_handler_time_out(struct mesh_routing_ctx * ctx);
+
+/**
+ * @brief Activa o desactiva el modo adaptativo de anuncios, basado en el algoritmo Trickle. En
+ * este modo mientras la tabla no cambia el intervalo entre anuncios se duplica hasta
+ * MESH_ROUTING_TRICKLE_IMAX pasos del handler, y el anuncio propio se suprime si en el intervalo ya
+ * se escucharon MESH_ROUTING_TRICKLE_K anuncios de vecinos que no cambiaron la tabla. Ante un
+ * cambio en la tabla el intervalo vuelve a MESH_ROUTING_TRICKLE_IMIN pasos. Como los anuncios son
+ * menos frecuentes, una ruta que deja de anunciarse tarda más en eliminarse que en el modo fijo.
+ * mesh_routing_init() deja el modo adaptativo desactivado.
+ *
+ * @param ctx contexto del nodo
+ * @param enable true para activar el modo adaptativo, false para volver al modo fijo
+ */
+void mesh_routing_set_trickle(struct mesh_routing_ctx * ctx, bool enable);
+
+/**
+ * @brief Activa o desactiva el modo inundación de broadcast. En este modo los broadcast de la capa
+ * de aplicación llegan a toda la red: el origen los numera en el campo SEQ y cada nodo entrega y
+ * retransmite una sola vez cada par {origen, secuencia}, que recuerda en un buffer circular de
+ * MESH_ROUTING_FLOOD_CACHE entradas. La retransmisión se demora entre 1 y MESH_ROUTING_FLOOD_JITTER
+ * pasos del handler elegidos al azar y se suprime si mientras tanto se escucharon
+ * MESH_ROUTING_FLOOD_SUPPRESS copias del mismo broadcast, ya que los vecinos probablemente ya lo
+ * recibieron. Los broadcast recibidos con secuencia 0 no se inundan y solo se entregan al propio
+ * nodo, como fuera de este modo. Fuera de este modo los broadcast que origina el nodo se envían una
+ * sola vez a sus vecinos, sin numerarse, y los recibidos se entregan sin retransmitirse. Al
+ * desactivarlo se descartan las retransmisiones pendientes. mesh_routing_init() deja el modo
+ * inundación desactivado.
+ *
+ * @param ctx contexto del nodo
+ * @param enable true para inundar los broadcast, false para que solo lleguen a los vecinos
+ */
+void mesh_routing_set_flooding(struct mesh_routing_ctx * ctx, bool enable);
+
+/**
+ * @brief Elige la métrica de las rutas. Cada ruta anunciada por un vecino se guarda con la métrica
+ * anunciada más el costo del enlace con ese vecino, que calcula link_cost a partir de las muestras
+ * de mesh_routing_link_tx() y mesh_routing_link_rssi(). El costo de un enlace solo se actualiza
+ * cuando cambia al menos MESH_ROUTING_LINK_HYSTERESIS, para que las rutas no oscilen con cada
+ * muestra; al actualizarse se corrigen las rutas que pasan por el vecino y se anuncian. Todos los
+ * nodos de la red deben usar la misma métrica. mesh_routing_init() elige la cantidad de saltos.
+ *
+ * @param ctx contexto del nodo
+ * @param link_cost métrica, por ejemplo mesh_routing_metric_etx o mesh_routing_metric_rssi; NULL
+ * para la cantidad de saltos
+ */
+void mesh_routing_set_metric(struct mesh_routing_ctx * ctx,
+                             uint8_t (*link_cost)(const struct mesh_routing_link * link));
+
+/**
+ * @brief Métrica de cantidad de saltos: todos los enlaces cuestan 1
+ *
+ * @param link enlace con el vecino
+ * @return uint8_t costo del enlace
+ */
+uint8_t mesh_routing_metric_hop_count(const struct mesh_routing_link * link);
+
+/**
+ * @brief Métrica ETX: cantidad esperada de transmisiones para que el vecino reciba un msg, en
+ * 1/MESH_ROUTING_LINK_UNIT, hasta MESH_ROUTING_LINK_MAX_COST
+ *
+ * @param link enlace con el vecino
+ * @return uint8_t costo del enlace
+ */
+uint8_t mesh_routing_metric_etx(const struct mesh_routing_link * link);
+
+/**
+ * @brief Métrica por RSSI: MESH_ROUTING_LINK_UNIT más 1 cada MESH_ROUTING_RSSI_STEP dB por debajo
+ * de MESH_ROUTING_RSSI_GOOD, hasta MESH_ROUTING_LINK_MAX_COST
+ *
+ * @param link enlace con el vecino
+ * @return uint8_t costo del enlace
+ */
+uint8_t mesh_routing_metric_rssi(const struct mesh_routing_link * link);
+
+/**
+ * @brief Registra el resultado de un envío a un vecino, para estimar la calidad del enlace. Se
+ * llama cuando la capa ble confirma o da por perdida una escritura.
+ *
+ * @param ctx contexto del nodo
+ * @param neighbor id del vecino
+ * @param acked true si el vecino confirmó la recepción
+ */
+void mesh_routing_link_tx(struct mesh_routing_ctx * ctx, uint8_t neighbor, bool acked);
+
+/**
+ * @brief Registra el RSSI de una trama recibida de un vecino, para estimar la calidad del enlace
+ *
+ * @param ctx contexto del nodo
+ * @param neighbor id del vecino
+ * @param rssi RSSI en dBm
+ */
+void mesh_routing_link_rssi(struct mesh_routing_ctx * ctx, uint8_t neighbor, int8_t rssi);
+
+/**
+ * @brief Devuelve cuántas de las próximas llamadas a mesh_routing_handler_time_out() no tienen
+ * nada que hacer: no envían anuncios, no retransmiten broadcast ni vence ninguna ruta. El port
+ * puede detener su temporizador durante esos pasos y al despertar llamar al handler una vez por
+ * cada paso transcurrido. Un msg recibido puede adelantar el próximo anuncio, por lo que el valor
+ * se debe volver a consultar luego de entregar msg a la capa routing.
+ *
+ * @param ctx contexto del nodo
+ * @return uint16_t pasos del handler sin trabajo, UINT16_MAX si no hay ninguno pendiente
+ */
+uint16_t mesh_routing_idle_ticks(struct mesh_routing_ctx * ctx);
+
+/**
+ * @brief Copia los contadores del nodo. Cada contador se lee en forma atómica, pero la copia no es
+ * una foto instantánea del conjunto si otro hilo sigue ruteando mientras tanto.
+ *
+ * @param ctx contexto del nodo
+ * @param stats copia de los contadores
+ */
+void mesh_routing_get_stats(struct mesh_routing_ctx * ctx, struct mesh_routing_stats * stats);
+
+/**
+ * @brief Pone en cero los contadores del nodo. mesh_routing_init() también los pone en cero.
+ *
+ * @param ctx contexto del nodo
+ */
+void mesh_routing_reset_stats(struct mesh_routing_ctx * ctx);
+
+/**
+ * @brief Activa o desactiva el registro de trazas. Con el registro activo los cambios de rutas, los
+ * anuncios enviados y cada msg reenviado o descartado se guardan como eventos binarios de pocos
+ * bytes en un buffer circular de MESH_ROUTING_TRACE_SIZE eventos, sin formatear texto ni tomar
+ * locks. Con MESH_ROUTING_TRACE_SIZE en 0 el registro no se compila y esta función no hace nada.
+ * mesh_routing_init() deja el registro desactivado y vacío.
+ *
+ * @param ctx contexto del nodo
+ * @param enable true para registrar eventos, false para dejar de registrarlos
+ */
+void mesh_routing_set_trace(struct mesh_routing_ctx * ctx, bool enable);
+
+/**
+ * @brief Vuelca los últimos eventos del registro de trazas en un buffer, para leerlos fuera del
+ * nodo, por ejemplo con tools/mesh_trace_decode.c. El volcado es un encabezado {'M', 'T',
+ * versión, id del nodo, cantidad de eventos, eventos perdidos} seguido de los eventos del más
+ * antiguo al más nuevo, cada uno {time, type, dst, next_hop, metric, extra, 0}. Los campos de 16
+ * bits van con el byte alto primero. Si el buffer no alcanza se vuelcan los eventos más nuevos que
+ * entran; los eventos perdidos cuentan los que ya no están en el volcado, hasta UINT16_MAX. Si
+ * otros hilos siguen ruteando durante el volcado, los eventos que todavía se están escribiendo o
+ * que se reemplazan mientras se leen no se vuelcan y se cuentan como perdidos.
+ *
+ * @param ctx contexto del nodo
+ * @param buffer buffer donde se escribe el volcado
+ * @param size tamaño del buffer, MESH_ROUTING_TRACE_DUMP_SIZE para todo el registro
+ * @return uint16_t bytes escritos, 0 si el buffer no alcanza para el encabezado
+ */
+uint16_t mesh_routing_trace_dump(struct mesh_routing_ctx * ctx, uint8_t * buffer, uint16_t size);
+
+/**
+ * @brief Guarda una copia de la tabla de rutas, para recuperarla con
+ * mesh_routing_snapshot_restore() luego de un reinicio. La copia lleva un encabezado con versión y
+ * el id del nodo, sus caminos con la métrica de cada uno y un CRC, y ocupa a lo sumo
+ * MESH_ROUTING_SNAPSHOT_MAX_SIZE(capacity) bytes. Las rutas perdidas no se guardan. Las rutas se
+ * arman de a bloques con el lock de la tabla tomado y cada bloque se escribe con el lock liberado,
+ * así un medio lento no demora al resto de la capa; si la tabla cambia mientras se guarda, la
+ * copia puede tener rutas de antes y de después del cambio, pero cada ruta queda completa. El
+ * encabezado se escribe al final, por lo que una copia interrumpida no se restaura.
+ *
+ * @param ctx contexto del nodo
+ * @param storage medio donde se escribe la copia
+ * @return int 0 si se guardó, -1 si falló la escritura
+ */
+int mesh_routing_snapshot_save(struct mesh_routing_ctx * ctx,
+                               const struct mesh_routing_storage * storage);
+
+/**
+ * @brief Carga en la tabla de rutas una copia guardada con mesh_routing_snapshot_save(). Se debe
+ * llamar justo después de mesh_routing_init() y de elegir el modo de anuncios. Las rutas cargadas
+ * se usan para reenviar desde ese momento y sus caminos vencen como los de cualquier ruta, pero no
+ * se anuncian hasta que un vecino las vuelva a anunciar. Las que ningún vecino confirma dentro de
+ * MESH_ROUTING_FULL_SYNC_PERIOD vidas de camino se eliminan sin anunciarse como perdidas. Si la
+ * copia no es válida, es de otra versión o de otro nodo la tabla no se modifica. La copia se valida
+ * antes de tomar el lock y se vuelve a validar mientras se carga; si cambió en el medio las rutas
+ * cargadas se quitan.
  *
+ * @param ctx contexto del nodo
+ * @param storage medio del que se lee la copia
+ * @return int 0 si se cargó, -1 si la copia no es válida o falló la lectura
  */
-void mesh_routing_handler_time_out();
+int mesh_routing_snapshot_restore(struct mesh_routing_ctx * ctx,
+                                  const struct mesh_routing_storage * storage);
 
 /* === End of documentation ==================================================================== */
 
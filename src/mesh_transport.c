@@ -0,0 +1,368 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file mesh_transport.c
+ ** @brief Fragmentación y rearmado de datagramas de aplicación. Cada fragmento es un msg de
+ *         OPCODE_TRANSPORT cuyo contenido empieza con el opcode de aplicación, el id del datagrama
+ *         y un byte con el índice del fragmento en el nibble alto y la cantidad de fragmentos
+ *         menos uno en el bajo; el resto son datos. Como todos los fragmentos son iguales salvo
+ *         por el contenido, routing los resuelve con el mismo próximo salto. En el destino los
+ *         datos de cada fragmento se copian una sola vez a su lugar en el buffer de rearmado, que
+ *         ya tiene lugar para el encabezado de un msg, así el datagrama completo se entrega a
+ *         mesh_app_process_msg() sin copiarlo de nuevo. Los buffers de rearmado son de la subcapa
+ *         y no se toman del pool de msg, cuyos buffers solo tienen lugar para MAX_SIZE_MSG bytes.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh_transport.h"
+#include "mesh.h"
+#include "mesh_app.h"
+#include "mesh_msg.h"
+#include "mesh_port.h"
+#include "mesh_routing.h"
+#include <string.h>
+
+/* === Macros definitions ====================================================================== */
+
+#define TRANSPORT_OPCODE        0 // opcode de aplicación del datagrama
+#define TRANSPORT_ID            1 // id del datagrama, propio de cada origen
+#define TRANSPORT_FRAGMENT      2 // índice << 4 | cantidad de fragmentos - 1
+#define TRANSPORT_HEADER_SIZE   3
+
+#define TRANSPORT_FRAGMENT_DATA (MAX_SIZE_MSG - TRANSPORT_HEADER_SIZE)
+#define TRANSPORT_MAX_FRAGMENTS 16
+
+_Static_assert(MESH_TRANSPORT_MAX_PAYLOAD <= 255, "MESH_TRANSPORT_MAX_PAYLOAD no entra en LENGHT");
+_Static_assert(MESH_TRANSPORT_MAX_PAYLOAD <= TRANSPORT_FRAGMENT_DATA * TRANSPORT_MAX_FRAGMENTS,
+               "MESH_TRANSPORT_MAX_PAYLOAD necesita demasiados fragmentos");
+_Static_assert(MESH_TRANSPORT_BATCH > 0 && MESH_TRANSPORT_BATCH <= MESH_MSG_POOL_SIZE,
+               "MESH_TRANSPORT_BATCH debe entrar en el pool de msg");
+_Static_assert(MESH_TRANSPORT_DELIVERED_RING > 0 && MESH_TRANSPORT_DELIVERED_RING <= 255,
+               "MESH_TRANSPORT_DELIVERED_RING fuera de rango");
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Estado de un buffer de rearmado
+ *
+ */
+enum reassembly_state {
+  REASSEMBLY_FREE,
+  REASSEMBLY_BUSY,       // esperando fragmentos
+  REASSEMBLY_DELIVERING, // completo, entregándose a la aplicación
+};
+
+/**
+ * @brief Datagrama en rearmado
+ *
+ */
+struct reassembly {
+  uint8_t state;
+  uint8_t src;
+  uint8_t id;
+  uint8_t count;     // fragmentos del datagrama
+  uint16_t received; // un bit por fragmento recibido
+  uint8_t len;       // largo del datagrama, se conoce al recibir el último fragmento
+  uint8_t ticks;     // llamadas a mesh_transport_handler_time_out() que le quedan
+  uint8_t buffer[MSG + MESH_TRANSPORT_MAX_PAYLOAD];
+};
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+/**
+ * @brief Buffers de rearmado
+ *
+ */
+static struct reassembly reassemblies[MESH_TRANSPORT_REASSEMBLY_SLOTS];
+
+/**
+ * @brief Últimos datagramas entregados, como origen << 8 | id, para descartar los fragmentos
+ * repetidos que llegan después de entregarlos. Es más grande que la cantidad de buffers de
+ * rearmado porque un fragmento retransmitido puede llegar después de que se entregaron otros
+ * datagramas, y si abre un rearmado que nunca se completa ocupa un buffer hasta el time out.
+ *
+ */
+static uint16_t delivered[MESH_TRANSPORT_DELIVERED_RING];
+
+/**
+ * @brief Próxima posición de delivered que se reemplaza
+ *
+ */
+static uint8_t delivered_next = 0;
+
+/**
+ * @brief Id del próximo datagrama que se envía
+ *
+ */
+static uint8_t next_id = 0;
+
+/**
+ * @brief Nodo de la capa routing por el que se envían los fragmentos
+ *
+ */
+static struct mesh_routing_ctx * routing_ctx = NULL;
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Completa el encabezado de un msg que origina este nodo
+ *
+ * @param msg msg a completar
+ * @param dst destino
+ * @param opcode opcode del msg
+ * @param len largo del contenido
+ */
+static void transport_header(uint8_t * msg, uint8_t dst, uint8_t opcode, uint8_t len) {
+  msg[SRC] = mesh_routing_get_id(routing_ctx);
+  msg[DST] = dst;
+  msg[NEXT_HOP] = NULL_DIR;
+  msg[OPCODE] = opcode;
+  msg[LENGHT] = len;
+  msg[SEQ] = 0; // la capa routing numera los broadcast que inunda
+  msg[TTL] = MESH_ROUTING_DEFAULT_TTL;
+}
+
+/**
+ * @brief Entrega los msg a routing y los devuelve al pool
+ *
+ * @param msgs msg a enviar
+ * @param count cantidad de msg
+ */
+static void transport_flush(uint8_t ** msgs, uint8_t count) {
+  mesh_routing_send_msgs(routing_ctx, msgs, count);
+  for (uint8_t i = 0; i < count; i++) {
+    mesh_msg_release(msgs[i]);
+  }
+}
+
+/**
+ * @brief Indica si un datagrama ya se entregó. Se llama con el lock tomado.
+ *
+ * @param src origen del datagrama
+ * @param id id del datagrama
+ * @return true si está entre los últimos entregados
+ */
+static bool was_delivered(uint8_t src, uint8_t id) {
+  uint16_t key = (uint16_t)(src << 8) | id;
+  for (uint8_t i = 0; i < MESH_TRANSPORT_DELIVERED_RING; i++) {
+    if (delivered[i] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Busca el buffer de rearmado de un datagrama, si no lo hay toma uno libre. Se llama con
+ * el lock tomado.
+ *
+ * @param src origen del datagrama
+ * @param id id del datagrama
+ * @param count fragmentos del datagrama
+ * @return struct reassembly* buffer, NULL si no hay buffers libres
+ */
+static struct reassembly * get_reassembly(uint8_t src, uint8_t id, uint8_t count) {
+  struct reassembly * p_free = NULL;
+
+  for (uint8_t i = 0; i < MESH_TRANSPORT_REASSEMBLY_SLOTS; i++) {
+    struct reassembly * r = &reassemblies[i];
+    if (r->state == REASSEMBLY_FREE) {
+      if (p_free == NULL) {
+        p_free = r;
+      }
+    } else if (r->src == src && r->id == id) {
+      return r;
+    }
+  }
+
+  if (p_free != NULL) {
+    p_free->state = REASSEMBLY_BUSY;
+    p_free->src = src;
+    p_free->id = id;
+    p_free->count = count;
+    p_free->received = 0;
+    p_free->len = 0;
+    p_free->ticks = MESH_TRANSPORT_TIMEOUT;
+  }
+  return p_free;
+}
+
+/* === Public function implementation ========================================================== */
+
+void mesh_transport_init(struct mesh_routing_ctx * routing) {
+  routing_ctx = routing;
+  next_id = 0;
+  delivered_next = 0;
+  for (uint8_t i = 0; i < MESH_TRANSPORT_REASSEMBLY_SLOTS; i++) {
+    reassemblies[i].state = REASSEMBLY_FREE;
+  }
+  for (uint8_t i = 0; i < MESH_TRANSPORT_DELIVERED_RING; i++) {
+    delivered[i] = UNREACHABLE_DIR << 8; // ningún nodo tiene ese id
+  }
+}
+
+int mesh_transport_send(uint8_t dst, uint8_t opcode, const uint8_t * data, uint16_t len) {
+
+  if (opcode < OPCODE_APP_MIN || opcode > OPCODE_APP_MAX || len > MESH_TRANSPORT_MAX_PAYLOAD) {
+    return -1;
+  }
+
+  if (len <= MAX_SIZE_MSG) {
+    uint8_t * msg = mesh_msg_alloc();
+    if (msg == NULL) {
+      return -1;
+    }
+    transport_header(msg, dst, opcode, len);
+    if (len > 0) {
+      memcpy(&msg[MSG], data, len);
+    }
+    transport_flush(&msg, 1);
+    return 0;
+  }
+
+  mesh_port_transport_lock();
+  uint8_t id = next_id++;
+  mesh_port_transport_unlock();
+
+  uint8_t count = (len + TRANSPORT_FRAGMENT_DATA - 1) / TRANSPORT_FRAGMENT_DATA;
+  uint8_t * batch[MESH_TRANSPORT_BATCH];
+  uint8_t pending = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t * msg = mesh_msg_alloc();
+    if (msg == NULL) {
+      // los lotes ya enviados se descartan en el destino por time out
+      for (uint8_t j = 0; j < pending; j++) {
+        mesh_msg_release(batch[j]);
+      }
+      return -1;
+    }
+
+    uint16_t offset = i * TRANSPORT_FRAGMENT_DATA;
+    uint8_t size = len - offset < TRANSPORT_FRAGMENT_DATA ? len - offset : TRANSPORT_FRAGMENT_DATA;
+    transport_header(msg, dst, OPCODE_TRANSPORT, TRANSPORT_HEADER_SIZE + size);
+    msg[MSG + TRANSPORT_OPCODE] = opcode;
+    msg[MSG + TRANSPORT_ID] = id;
+    msg[MSG + TRANSPORT_FRAGMENT] = (i << 4) | (count - 1);
+    memcpy(&msg[MSG + TRANSPORT_HEADER_SIZE], &data[offset], size);
+
+    batch[pending++] = msg;
+    if (pending == MESH_TRANSPORT_BATCH || i + 1 == count) {
+      transport_flush(batch, pending);
+      pending = 0;
+    }
+  }
+  return 0;
+}
+
+void mesh_transport_process_msg(uint8_t * msg) {
+
+  if (msg[LENGHT] <= TRANSPORT_HEADER_SIZE || msg[LENGHT] > MAX_SIZE_MSG) {
+    return;
+  }
+
+  uint8_t opcode = msg[MSG + TRANSPORT_OPCODE];
+  uint8_t index = msg[MSG + TRANSPORT_FRAGMENT] >> 4;
+  uint8_t count = (msg[MSG + TRANSPORT_FRAGMENT] & 0x0F) + 1;
+  uint8_t size = msg[LENGHT] - TRANSPORT_HEADER_SIZE;
+  uint16_t offset = index * TRANSPORT_FRAGMENT_DATA;
+  bool last = index + 1 == count;
+
+  if (opcode < OPCODE_APP_MIN || opcode > OPCODE_APP_MAX || index >= count ||
+      (last == false && size != TRANSPORT_FRAGMENT_DATA) ||
+      offset + size > MESH_TRANSPORT_MAX_PAYLOAD) {
+    return;
+  }
+
+  mesh_port_transport_lock();
+  struct reassembly * r = NULL;
+  if (was_delivered(msg[SRC], msg[MSG + TRANSPORT_ID]) == false) {
+    r = get_reassembly(msg[SRC], msg[MSG + TRANSPORT_ID], count);
+  }
+  if (r == NULL || r->state != REASSEMBLY_BUSY || r->count != count ||
+      (r->received != 0 && r->buffer[OPCODE] != opcode) || (r->received & (1u << index)) != 0) {
+    mesh_port_transport_unlock();
+    return;
+  }
+
+  memcpy(&r->buffer[MSG + offset], &msg[MSG + TRANSPORT_HEADER_SIZE], size);
+  r->buffer[OPCODE] = opcode;
+  r->received |= 1u << index;
+  if (last) {
+    r->len = offset + size;
+  }
+
+  bool complete = r->received == (1u << count) - 1;
+  if (complete) {
+    r->state = REASSEMBLY_DELIVERING; // el time out no lo libera mientras se entrega
+    delivered[delivered_next] = (uint16_t)(r->src << 8) | r->id;
+    delivered_next = (delivered_next + 1) % MESH_TRANSPORT_DELIVERED_RING;
+  }
+  mesh_port_transport_unlock();
+
+  if (complete) {
+    r->buffer[SRC] = msg[SRC];
+    r->buffer[DST] = msg[DST];
+    r->buffer[NEXT_HOP] = msg[NEXT_HOP];
+    r->buffer[LENGHT] = r->len;
+    r->buffer[SEQ] = msg[SEQ];
+    r->buffer[TTL] = msg[TTL];
+    mesh_app_process_msg(r->buffer);
+
+    mesh_port_transport_lock();
+    r->state = REASSEMBLY_FREE;
+    mesh_port_transport_unlock();
+  }
+}
+
+void mesh_transport_handler_time_out() {
+  mesh_port_transport_lock();
+  for (uint8_t i = 0; i < MESH_TRANSPORT_REASSEMBLY_SLOTS; i++) {
+    struct reassembly * r = &reassemblies[i];
+    if (r->state == REASSEMBLY_BUSY && --r->ticks == 0) {
+      r->state = REASSEMBLY_FREE;
+    }
+  }
+  mesh_port_transport_unlock();
+}
+
+uint8_t mesh_transport_pending() {
+  uint8_t pending = 0;
+
+  mesh_port_transport_lock();
+  for (uint8_t i = 0; i < MESH_TRANSPORT_REASSEMBLY_SLOTS; i++) {
+    if (reassemblies[i].state != REASSEMBLY_FREE) {
+      pending++;
+    }
+  }
+  mesh_port_transport_unlock();
+  return pending;
+}
+
+/* === End of documentation ==================================================================== */
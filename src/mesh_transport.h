@@ -0,0 +1,122 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+#ifndef __mesh_transport_H
+#define __mesh_transport_H
+
+/** @file
+ ** @brief Subcapa de transporte entre la aplicación y routing. Los datos de aplicación que no
+ * entran en un msg se parten en fragmentos de OPCODE_TRANSPORT que se rearman en el destino antes
+ * de entregarlos a mesh_app_process_msg().
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+/* === Public macros definitions =============================================================== */
+
+#ifndef MESH_TRANSPORT_MAX_PAYLOAD
+#define MESH_TRANSPORT_MAX_PAYLOAD 128 // bytes de aplicación de un datagrama, como máximo 255
+#endif
+
+#ifndef MESH_TRANSPORT_REASSEMBLY_SLOTS
+#define MESH_TRANSPORT_REASSEMBLY_SLOTS 2 // datagramas que se pueden rearmar a la vez
+#endif
+
+#ifndef MESH_TRANSPORT_DELIVERED_RING
+#define MESH_TRANSPORT_DELIVERED_RING 8 // datagramas entregados que se recuerdan, hasta 255
+#endif
+
+#ifndef MESH_TRANSPORT_TIMEOUT
+#define MESH_TRANSPORT_TIMEOUT 4 // llamadas a mesh_transport_handler_time_out() para rearmar
+#endif
+
+#ifndef MESH_TRANSPORT_BATCH
+#define MESH_TRANSPORT_BATCH 4 // fragmentos que se entregan juntos a routing
+#endif
+
+/* === Public data type declarations =========================================================== */
+
+struct mesh_routing_ctx;
+
+/* === Public variable declarations ============================================================ */
+
+/* === Public function declarations ============================================================ */
+
+/**
+ * @brief Inicializa la subcapa de transporte sin datagramas en rearmado
+ *
+ * @param routing nodo de la capa routing por el que se envían los fragmentos
+ */
+void mesh_transport_init(struct mesh_routing_ctx * routing);
+
+/**
+ * @brief Envía datos de aplicación de cualquier largo hasta MESH_TRANSPORT_MAX_PAYLOAD. Si entran
+ * en un msg se envían como un msg de aplicación común; si no, se parten en fragmentos que se
+ * entregan a routing de a MESH_TRANSPORT_BATCH con mesh_routing_send_msgs(). Todos los fragmentos
+ * tienen el mismo origen, destino y opcode, por lo que routing elige el mismo camino para todos
+ * mientras la tabla de ruta no cambie; el próximo salto no se fija por datagrama, y si la ruta
+ * cambia entre dos lotes los fragmentos siguientes van por el camino nuevo.
+ *
+ * Si el pool de msg se agota después de entregar a routing algún lote, esos fragmentos ya salieron
+ * y el envío devuelve -1 igual. El destino descarta el datagrama incompleto por time out, y los
+ * datos se pueden volver a enviar completos, con otro id.
+ *
+ * @param dst destino de los datos
+ * @param opcode opcode de aplicación con el que se entregan en el destino
+ * @param data datos a enviar
+ * @param len largo de los datos
+ * @return int 0 si se enviaron, -1 si el opcode o el largo son inválidos o el pool de msg se
+ * agotó, aunque ya se hayan enviado algunos fragmentos
+ */
+int mesh_transport_send(uint8_t dst, uint8_t opcode, const uint8_t * data, uint16_t len);
+
+/**
+ * @brief Procesa un fragmento recibido. Los datos se copian directo a su lugar en el buffer de
+ * rearmado del datagrama, y cuando llegan todos los fragmentos el buffer se entrega una única vez
+ * a mesh_app_process_msg(). Los fragmentos repetidos se descartan, también los que llegan después
+ * de entregar el datagrama.
+ *
+ * @param msg fragmento con OPCODE_TRANSPORT
+ */
+void mesh_transport_process_msg(uint8_t * msg);
+
+/**
+ * @brief Descarta los datagramas que no terminaron de llegar en MESH_TRANSPORT_TIMEOUT llamadas.
+ * El port la llama periódicamente, por ejemplo junto a mesh_conn_handler_time_out().
+ *
+ */
+void mesh_transport_handler_time_out();
+
+/**
+ * @brief Cantidad de datagramas que se están rearmando
+ *
+ * @return uint8_t buffers de rearmado ocupados
+ */
+uint8_t mesh_transport_pending();
+
+/* === End of documentation ==================================================================== */
+
+#endif
@@ -0,0 +1,270 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file
+ ** @brief Test de mesh_app.c
+ */
+
+/* === Headers files inclusions
+ * =============================================================== */
+
+#include "unity.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "Mockmesh_routing.h"
+#include "Mockmesh_transport.h"
+
+#include "mesh.h"
+#include "mesh_app.h"
+
+/* === Macros definitions
+ * ====================================================================== */
+#define SRC_TEST_MSG    0
+#define DST_TEST_MSG    1
+#define OPCODE_TEST_MSG 3
+#define LENGHT_TEST_MSG 4
+#define MSG_TEST_MSG    7
+
+/* === Private data type declarations
+ * ========================================================== */
+
+/* === Private variable declarations
+ * =========================================================== */
+
+/* === Private function declarations
+ * =========================================================== */
+
+/* === Public variable definitions
+ * ============================================================= */
+
+/* === Private variable definitions
+ * ============================================================ */
+
+uint8_t msg_rcv[MSG_TEST_MSG + 2] = {3, SRC_DIR, SRC_DIR, 40, 2, 0, 0, 'h', 'i'};
+
+struct mesh_routing_ctx nodo;
+
+int llamadas_a, llamadas_b;
+
+uint8_t * contenido_recibido;
+
+int largo_recibido;
+
+uint8_t * contenido_recibido_b;
+
+uint8_t msg_enviado[MSG_TEST_MSG + MAX_SIZE_MSG];
+
+int cantidad_msg_enviados;
+
+/* === Private function implementation
+ * ========================================================= */
+
+void setUp() {
+  mesh_routing_get_id_IgnoreAndReturn(SRC_DIR);
+  mesh_app_init(&nodo);
+  llamadas_a = 0;
+  llamadas_b = 0;
+  contenido_recibido = NULL;
+  largo_recibido = 0;
+  cantidad_msg_enviados = 0;
+}
+
+/** @test Funciones auxiliares suscriptas a los opcodes */
+
+int aux_suscriptor_a(uint8_t * msg, int len) {
+  llamadas_a++;
+  contenido_recibido = msg;
+  largo_recibido = len;
+  return 0;
+}
+
+int aux_suscriptor_b(uint8_t * msg, int len) {
+  llamadas_b++;
+  contenido_recibido_b = msg;
+  return 0;
+}
+
+int aux_suscriptor_que_se_elimina(uint8_t * msg, int len) {
+  llamadas_b++;
+  mesh_app_remove_opcode(40, aux_suscriptor_que_se_elimina);
+  return 0;
+}
+
+int aux_suscriptor_que_elimina_a_b(uint8_t * msg, int len) {
+  llamadas_a++;
+  mesh_app_remove_opcode(40, aux_suscriptor_b);
+  return 0;
+}
+
+/** @test Función auxiliar que guarda una copia del msg que la capa app pasa a la capa routing, con
+ * el encabezado completo */
+
+void aux_guardar_msg_enviado(struct mesh_routing_ctx * ctx, uint8_t * msg, int num_calls) {
+  TEST_ASSERT_EQUAL_PTR(&nodo, ctx);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_SIZE_MSG, msg[LENGHT_TEST_MSG]);
+  memcpy(msg_enviado, msg, MSG_TEST_MSG + msg[LENGHT_TEST_MSG]);
+  cantidad_msg_enviados++;
+}
+
+/* === Public function implementation
+ * ========================================================== */
+
+/** @test Un msg se entrega a la función suscripta a su opcode con su contenido y largo */
+void test_entregar_msg_a_la_funcion_suscripta() {
+  TEST_ASSERT_EQUAL(0, mesh_app_add_opcode(40, aux_suscriptor_a));
+  TEST_ASSERT_EQUAL(1, opcode_existe(40));
+  TEST_ASSERT_EQUAL(0, opcode_existe(41));
+
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(1, llamadas_a);
+  TEST_ASSERT_EQUAL_PTR(&msg_rcv[MSG_TEST_MSG], contenido_recibido);
+  TEST_ASSERT_EQUAL(2, largo_recibido);
+}
+
+/** @test Un msg con un opcode sin suscripciones no se entrega a ninguna función */
+void test_msg_sin_suscriptores() {
+  mesh_app_add_opcode(41, aux_suscriptor_a);
+  mesh_app_process_msg(msg_rcv);
+  TEST_ASSERT_EQUAL(0, llamadas_a);
+}
+
+/** @test Todas las funciones suscriptas a un opcode reciben el mismo buffer, en el orden en que se
+ * suscribieron */
+void test_entregar_msg_a_varios_suscriptores() {
+  mesh_app_add_opcode(40, aux_suscriptor_a);
+  mesh_app_add_opcode(40, aux_suscriptor_b);
+
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(1, llamadas_a);
+  TEST_ASSERT_EQUAL(1, llamadas_b);
+  TEST_ASSERT_EQUAL_PTR(contenido_recibido, contenido_recibido_b);
+}
+
+/** @test Una función eliminada deja de recibir msg y el resto sigue suscripta */
+void test_eliminar_suscripcion() {
+  mesh_app_add_opcode(40, aux_suscriptor_a);
+  mesh_app_add_opcode(40, aux_suscriptor_b);
+  TEST_ASSERT_EQUAL(0, mesh_app_remove_opcode(40, aux_suscriptor_a));
+  TEST_ASSERT_EQUAL(-1, mesh_app_remove_opcode(40, aux_suscriptor_a));
+
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(0, llamadas_a);
+  TEST_ASSERT_EQUAL(1, llamadas_b);
+  TEST_ASSERT_EQUAL(0, mesh_app_remove_opcode(40, aux_suscriptor_b));
+  TEST_ASSERT_EQUAL(0, opcode_existe(40));
+}
+
+/** @test Una función puede eliminar su propia suscripción mientras procesa un msg */
+void test_eliminar_suscripcion_durante_el_despacho() {
+  mesh_app_add_opcode(40, aux_suscriptor_que_se_elimina);
+  mesh_app_add_opcode(40, aux_suscriptor_a);
+
+  mesh_app_process_msg(msg_rcv);
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(1, llamadas_b);
+  TEST_ASSERT_EQUAL(2, llamadas_a);
+}
+
+/** @test Una función puede eliminar la suscripción que le sigue mientras procesa un msg, sin que
+ * el despacho llame a la función eliminada ni recorra las suscripciones libres */
+void test_eliminar_otra_suscripcion_durante_el_despacho() {
+  mesh_app_add_opcode(40, aux_suscriptor_que_elimina_a_b);
+  mesh_app_add_opcode(40, aux_suscriptor_b);
+  mesh_app_add_opcode(41, aux_suscriptor_b);
+
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(1, llamadas_a);
+  TEST_ASSERT_EQUAL(0, llamadas_b);
+  TEST_ASSERT_EQUAL(-1, mesh_app_remove_opcode(40, aux_suscriptor_b));
+
+  TEST_ASSERT_EQUAL(0, mesh_app_add_opcode(40, aux_suscriptor_b));
+  mesh_app_process_msg(msg_rcv);
+
+  TEST_ASSERT_EQUAL(2, llamadas_a);
+  TEST_ASSERT_EQUAL(0, llamadas_b);
+  TEST_ASSERT_EQUAL(1, opcode_existe(41));
+}
+
+/** @test No se puede suscribir a opcodes que no son de aplicación, dos veces la misma función ni
+ * más funciones que el máximo */
+void test_suscripciones_invalidas() {
+  TEST_ASSERT_EQUAL(-1, mesh_app_add_opcode(OPCODE_ROUTING_MAX, aux_suscriptor_a));
+  TEST_ASSERT_EQUAL(-1, mesh_app_add_opcode(OPCODE_APP_MAX + 1, aux_suscriptor_a));
+  TEST_ASSERT_EQUAL(0, mesh_app_add_opcode(40, aux_suscriptor_a));
+  TEST_ASSERT_EQUAL(-1, mesh_app_add_opcode(40, aux_suscriptor_a));
+
+  for (int i = 1; i < MESH_APP_MAX_SUBSCRIBERS; i++) {
+    TEST_ASSERT_EQUAL(0, mesh_app_add_opcode(OPCODE_APP_MAX - i, aux_suscriptor_a));
+  }
+  TEST_ASSERT_EQUAL(-1, mesh_app_add_opcode(OPCODE_APP_MAX, aux_suscriptor_a));
+  mesh_app_remove_opcode(40, aux_suscriptor_a);
+  TEST_ASSERT_EQUAL(0, mesh_app_add_opcode(OPCODE_APP_MAX, aux_suscriptor_a));
+}
+
+/** @test Un msg enviado por la aplicación sale con el id del nodo como origen hacia la capa
+ * routing */
+void test_enviar_msg_de_aplicacion() {
+  uint8_t msg[MSG_TEST_MSG + 1] = {0, 7, 0, 40, 1, 9, 0, 'x'};
+  uint8_t msg_esperado[MSG_TEST_MSG + 1] = {SRC_DIR, 7, 0, 40, 1, 0, MESH_ROUTING_DEFAULT_TTL, 'x'};
+
+  mesh_routing_send_msg_StubWithCallback(aux_guardar_msg_enviado);
+  ble_app_send(msg);
+
+  TEST_ASSERT_EQUAL(1, cantidad_msg_enviados);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_esperado, msg_enviado, sizeof(msg_esperado));
+}
+
+/** @test Un broadcast de aplicación sale con el id propio como origen y sin numerar, así la capa
+ * routing lo envía a los vecinos aunque la inundación esté desactivada */
+void test_enviar_broadcast_de_aplicacion() {
+  uint8_t msg[MSG_TEST_MSG + 1] = {0, BROADCAST_DIR, 0, 40, 1, 9, 0, 'x'};
+  uint8_t msg_esperado[MSG_TEST_MSG + 1] = {SRC_DIR, BROADCAST_DIR, 0, 40, 1, 0,
+                                            MESH_ROUTING_DEFAULT_TTL, 'x'};
+
+  mesh_routing_send_msg_StubWithCallback(aux_guardar_msg_enviado);
+  ble_app_send(msg);
+
+  TEST_ASSERT_EQUAL(1, cantidad_msg_enviados);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_esperado, msg_enviado, sizeof(msg_esperado));
+}
+
+/** @test Los fragmentos de transporte se entregan a mesh_transport y no a los suscriptores del
+ * opcode de aplicación que llevan adentro */
+void test_fragmento_de_transporte() {
+  uint8_t fragmento[MSG_TEST_MSG + 4] = {3,  SRC_DIR, SRC_DIR, OPCODE_TRANSPORT, 4, 0, 0,
+                                         40, 0,       1,       'h'};
+  mesh_app_add_opcode(40, aux_suscriptor_a);
+
+  mesh_transport_process_msg_Expect(fragmento);
+  mesh_app_process_msg(fragmento);
+
+  TEST_ASSERT_EQUAL(0, llamadas_a);
+}
+/* === End of documentation
+ * ==================================================================== */
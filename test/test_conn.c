@@ -0,0 +1,481 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file
+ ** @brief Test de mesh_conn.c
+ */
+
+/* === Headers files inclusions
+ * =============================================================== */
+
+#include "unity.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "Mockmesh_port.h"
+#include "Mockmesh_routing.h"
+
+#include "mesh.h"
+#include "mesh_conn.h"
+#include "mesh_msg.h"
+
+/* === Macros definitions
+ * ====================================================================== */
+#define SRC_TEST_MSG      0
+#define DST_TEST_MSG      1
+#define NEXT_HOP_TEST_MSG 2
+#define OPCODE_TEST_MSG   3
+#define LENGHT_TEST_MSG   4
+#define MSG_TEST_MSG      7
+
+#define MAX_SIZE_MSG_TEST 20
+#define HELLO_OPCODE_TEST 11
+#define TRAMAS_TEST       8
+
+/* === Private data type declarations
+ * ========================================================== */
+
+/* === Private variable declarations
+ * =========================================================== */
+
+/* === Private function declarations
+ * =========================================================== */
+
+/* === Public variable definitions
+ * ============================================================= */
+
+/* === Private variable definitions
+ * ============================================================ */
+
+struct mesh_routing_ctx nodo;
+
+uint8_t conexion_a, conexion_b;
+
+uint8_t tramas_enviadas[TRAMAS_TEST][MESH_CONN_MTU];
+
+uint8_t largo_tramas_enviadas[TRAMAS_TEST];
+
+uint8_t * conexion_tramas_enviadas[TRAMAS_TEST];
+
+int cantidad_tramas_enviadas;
+
+uint8_t * lote_recibido[MESH_CONN_MTU / MSG_TEST_MSG];
+
+uint16_t cantidad_lote_recibido;
+
+/* === Private function implementation
+ * ========================================================= */
+
+void setUp() {
+  mesh_port_conn_lock_Ignore();
+  mesh_port_conn_unlock_Ignore();
+  mesh_msg_init();
+  mesh_routing_get_id_IgnoreAndReturn(SRC_DIR);
+  mesh_conn_init(&nodo);
+  cantidad_tramas_enviadas = 0;
+}
+
+/** @test Función auxiliar que guarda las tramas enviadas por la capa conn a la capa ble */
+
+void aux_guardar_trama_enviada(uint8_t * p_conn, uint8_t * msg, uint8_t len, int num_calls) {
+  TEST_ASSERT_LESS_OR_EQUAL(MESH_CONN_MTU, len);
+  memcpy(tramas_enviadas[cantidad_tramas_enviadas], msg, len);
+  largo_tramas_enviadas[cantidad_tramas_enviadas] = len;
+  conexion_tramas_enviadas[cantidad_tramas_enviadas] = p_conn;
+  cantidad_tramas_enviadas++;
+}
+
+/** @test Función auxiliar que guarda el lote de msg que la capa conn pasa a la capa routing */
+
+void aux_guardar_lote_recibido(struct mesh_routing_ctx * ctx, uint8_t ** msgs, uint16_t count,
+                               int num_calls) {
+  TEST_ASSERT_EQUAL_PTR(&nodo, ctx);
+  memcpy(lote_recibido, msgs, count * sizeof(msgs[0]));
+  cantidad_lote_recibido = count;
+}
+
+/** @test Función auxiliar para generar un msg */
+
+void aux_generar_msg(uint8_t * msg, uint8_t next_hop, uint8_t opcode, uint8_t len) {
+  msg[SRC_TEST_MSG] = SRC_DIR;
+  msg[DST_TEST_MSG] = next_hop;
+  msg[NEXT_HOP_TEST_MSG] = next_hop;
+  msg[OPCODE_TEST_MSG] = opcode;
+  msg[LENGHT_TEST_MSG] = len;
+  for (uint8_t i = 0; i < len; i++) {
+    msg[MSG_TEST_MSG + i] = i;
+  }
+}
+
+/** @test Función auxiliar que agrega una conexión y recibe por ella el msg hello del vecino */
+
+void aux_conectar_vecino(uint8_t * p_conn, uint8_t id_mesh) {
+  uint8_t trama[] = {1, id_mesh, BROADCAST_DIR, BROADCAST_DIR, HELLO_OPCODE_TEST, 0, 0, 0};
+  TEST_ASSERT_EQUAL(0, mesh_conn_add_per(p_conn));
+  mesh_conn_rcv_ble_msg(p_conn, trama, sizeof(trama));
+}
+
+/* === Public function implementation
+ * ========================================================== */
+
+/** @test El msg hello de un vecino asocia su id con la conexión por la que llegó */
+void test_asociar_vecino_con_msg_hello() {
+  uint8_t msg[MSG_TEST_MSG + 2];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_conectar_vecino(&conexion_b, 6);
+  aux_generar_msg(msg, 6, 40, 2);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_send_msg(6, msg);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(1, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL_PTR(&conexion_b, conexion_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL(1 + sizeof(msg), largo_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL(1, tramas_enviadas[0][0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg, &tramas_enviadas[0][1], sizeof(msg));
+}
+
+/** @test No se puede agregar dos veces la misma conexión ni más conexiones que el máximo */
+void test_agregar_y_eliminar_conexiones() {
+  uint8_t conexiones[MESH_CONN_MAX_CONN + 1];
+  for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+    TEST_ASSERT_EQUAL(0, mesh_conn_add_per(&conexiones[i]));
+  }
+  TEST_ASSERT_EQUAL(-1, mesh_conn_add_per(&conexiones[0]));
+  TEST_ASSERT_EQUAL(-1, mesh_conn_add_per(&conexiones[MESH_CONN_MAX_CONN]));
+  TEST_ASSERT_EQUAL(0, mesh_conn_delete_per(&conexiones[0]));
+  TEST_ASSERT_EQUAL(-1, mesh_conn_delete_per(&conexiones[0]));
+  TEST_ASSERT_EQUAL(0, mesh_conn_add_per(&conexiones[MESH_CONN_MAX_CONN]));
+}
+
+/** @test Los msg hacia un mismo vecino se agrupan en una sola trama y los de otro vecino van en
+ * otra trama */
+void test_agrupar_msg_por_vecino() {
+  uint8_t msg_1[MSG_TEST_MSG + 3], msg_2[MSG_TEST_MSG + 1], msg_3[MSG_TEST_MSG + 4];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_conectar_vecino(&conexion_b, 6);
+  aux_generar_msg(msg_1, 5, 40, 3);
+  aux_generar_msg(msg_2, 6, 40, 1);
+  aux_generar_msg(msg_3, 5, 41, 4);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_send_msg(5, msg_1);
+  mesh_conn_send_msg(6, msg_2);
+  mesh_conn_send_msg(5, msg_3);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(2, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL_PTR(&conexion_a, conexion_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL(2, tramas_enviadas[0][0]);
+  TEST_ASSERT_EQUAL(1 + sizeof(msg_1) + sizeof(msg_3), largo_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_1, &tramas_enviadas[0][1], sizeof(msg_1));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_3, &tramas_enviadas[0][1 + sizeof(msg_1)], sizeof(msg_3));
+  TEST_ASSERT_EQUAL_PTR(&conexion_b, conexion_tramas_enviadas[1]);
+  TEST_ASSERT_EQUAL(1, tramas_enviadas[1][0]);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Los msg que no entran en una trama salen en la trama siguiente */
+void test_dividir_msg_en_tramas_de_hasta_mtu_bytes() {
+  uint8_t msg[MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+  uint8_t msgs_por_trama = (MESH_CONN_MTU - 1) / sizeof(msg);
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, 40, MAX_SIZE_MSG_TEST);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  for (uint8_t i = 0; i < MESH_CONN_QUEUE_SIZE; i++) {
+    mesh_conn_send_msg(5, msg);
+  }
+  mesh_conn_flush();
+
+  uint8_t tramas = (MESH_CONN_QUEUE_SIZE + msgs_por_trama - 1) / msgs_por_trama;
+  TEST_ASSERT_EQUAL(tramas, cantidad_tramas_enviadas);
+  uint8_t total = 0;
+  for (int i = 0; i < cantidad_tramas_enviadas; i++) {
+    TEST_ASSERT_EQUAL(1 + tramas_enviadas[i][0] * sizeof(msg), largo_tramas_enviadas[i]);
+    total = total + tramas_enviadas[i][0];
+  }
+  TEST_ASSERT_EQUAL(MESH_CONN_QUEUE_SIZE, total);
+}
+
+/** @test Con la cola de control de una conexión llena, el msg siguiente no se descarta: antes de
+ * encolarlo sale una trama por esa conexión, y el resto sale al vaciar las colas */
+void test_cola_de_control_llena_envia_una_trama() {
+  struct mesh_conn_state estado;
+  uint8_t * msg = mesh_msg_alloc();
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, OPCODE_ROUTING_MIN, MAX_SIZE_MSG_TEST);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  for (uint8_t i = 0; i < MESH_CONN_QUEUE_SIZE + 2; i++) {
+    mesh_conn_send_msg(5, msg);
+  }
+  TEST_ASSERT_EQUAL(1, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL(MESH_CONN_QUEUE_SIZE, tramas_enviadas[0][0]);
+  mesh_conn_flush();
+
+  uint8_t total = 0;
+  for (int i = 0; i < cantidad_tramas_enviadas; i++) {
+    TEST_ASSERT_EQUAL_PTR(&conexion_a, conexion_tramas_enviadas[i]);
+    total = total + tramas_enviadas[i][0];
+  }
+  TEST_ASSERT_EQUAL(MESH_CONN_QUEUE_SIZE + 2, total);
+  mesh_conn_get_state(&conexion_a, &estado);
+  TEST_ASSERT_EQUAL(0, estado.dropped);
+  mesh_msg_release(msg);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Los msg de la capa routing salen antes que los msg de aplicación encolados antes */
+void test_msg_de_routing_tienen_prioridad() {
+  uint8_t msg_app[MSG_TEST_MSG + 1], msg_routing[MSG_TEST_MSG + 2];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg_app, 5, OPCODE_APP_MIN, 1);
+  aux_generar_msg(msg_routing, BROADCAST_DIR, OPCODE_ROUTING_MIN, 2);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_send_msg(5, msg_app);
+  mesh_conn_send_msg(BROADCAST_DIR, msg_routing);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(1, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL(2, tramas_enviadas[0][0]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_routing, &tramas_enviadas[0][1], sizeof(msg_routing));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg_app, &tramas_enviadas[0][1 + sizeof(msg_routing)],
+                                sizeof(msg_app));
+}
+
+/** @test Un broadcast se encola en todas las conexiones compartiendo un único msg del pool */
+void test_broadcast_comparte_un_msg_entre_conexiones() {
+  uint8_t msg[MSG_TEST_MSG + 2];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_conectar_vecino(&conexion_b, 6);
+  aux_generar_msg(msg, BROADCAST_DIR, OPCODE_ROUTING_MIN, 2);
+
+  mesh_conn_send_msg(BROADCAST_DIR, msg);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE - 1, mesh_msg_available());
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(2, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg, &tramas_enviadas[1][1], sizeof(msg));
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Al eliminar una conexión se descartan sus msg encolados */
+void test_eliminar_conexion_libera_msg_encolados() {
+  uint8_t msg[MSG_TEST_MSG + 2];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, 40, 2);
+
+  mesh_conn_send_msg(5, msg);
+  mesh_conn_delete_per(&conexion_a);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Los msg de una trama recibida que no son de la capa conn se pasan juntos a la capa
+ * routing, sin copiarlos */
+void test_recibir_trama_con_varios_msg() {
+  uint8_t trama[] = {3,                                                      // cantidad de msg
+                     4, SRC_DIR, SRC_DIR, 40, 1, 0, 0, 'a',                  // msg para el nodo
+                     4, BROADCAST_DIR, BROADCAST_DIR, HELLO_OPCODE_TEST, 0, 0, 0, // hello
+                     4, 7, 7, 41, 2, 0, 0, 'b', 'c'};                        // msg para reenviar
+  mesh_conn_add_per(&conexion_a);
+
+  mesh_routing_send_msgs_StubWithCallback(aux_guardar_lote_recibido);
+  mesh_conn_rcv_ble_msg(&conexion_a, trama, sizeof(trama));
+
+  TEST_ASSERT_EQUAL(2, cantidad_lote_recibido);
+  TEST_ASSERT_EQUAL_PTR(&trama[1], lote_recibido[0]);
+  TEST_ASSERT_EQUAL_PTR(&trama[16], lote_recibido[1]);
+}
+
+/** @test Una trama que declara más msg de los que contiene se procesa hasta el último msg
+ * completo */
+void test_recibir_trama_truncada() {
+  uint8_t trama[] = {2, 4, SRC_DIR, SRC_DIR, 40, 1, 0, 0, 'a', 4, 7, 7, 41, 5, 0, 0, 'b'};
+
+  mesh_routing_send_msgs_StubWithCallback(aux_guardar_lote_recibido);
+  mesh_conn_rcv_ble_msg(&conexion_a, trama, sizeof(trama));
+
+  TEST_ASSERT_EQUAL(1, cantidad_lote_recibido);
+}
+
+/** @test El msg hello se envía por todas las conexiones */
+void test_enviar_hello_por_todas_las_conexiones() {
+  mesh_conn_add_per(&conexion_a);
+  mesh_conn_add_per(&conexion_b);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_send_hello();
+
+  TEST_ASSERT_EQUAL(2, cantidad_tramas_enviadas);
+  for (int i = 0; i < 2; i++) {
+    TEST_ASSERT_EQUAL(1 + MSG_TEST_MSG, largo_tramas_enviadas[i]);
+    TEST_ASSERT_EQUAL(SRC_DIR, tramas_enviadas[i][1 + SRC_TEST_MSG]);
+    TEST_ASSERT_EQUAL(HELLO_OPCODE_TEST, tramas_enviadas[i][1 + OPCODE_TEST_MSG]);
+  }
+}
+
+/** @test Si un vecino se reconecta por otra conexión los msg hacia él salen por la conexión nueva
+ */
+void test_reconexion_de_vecino_por_otra_conexion() {
+  uint8_t msg[MSG_TEST_MSG + 1];
+  struct mesh_conn_state estado;
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_conectar_vecino(&conexion_b, 5);
+  aux_generar_msg(msg, 5, 40, 1);
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  mesh_conn_send_msg(5, msg);
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(1, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL_PTR(&conexion_b, conexion_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL_PTR(&conexion_b, mesh_conn_get_conn(5));
+  mesh_conn_get_state(&conexion_a, &estado);
+  TEST_ASSERT_EQUAL(NULL_DIR, estado.id_mesh);
+}
+
+/** @test Muchas conexiones y desconexiones seguidas no pierden la asociación entre cada conexión
+ * y su vecino */
+void test_conexiones_y_desconexiones_seguidas() {
+  uint8_t conexiones[MESH_CONN_MAX_CONN * 4];
+  mesh_routing_send_msgs_Ignore();
+
+  for (int ronda = 0; ronda < 50; ronda++) {
+    for (int i = 0; i < MESH_CONN_MAX_CONN; i++) {
+      uint8_t j = (ronda * 3 + i * 5) % sizeof(conexiones);
+      uint8_t hello[] = {1, j, BROADCAST_DIR, BROADCAST_DIR, HELLO_OPCODE_TEST, 0, 0, 0};
+      if (mesh_conn_add_per(&conexiones[j]) == 0) {
+        mesh_conn_rcv_ble_msg(&conexiones[j], hello, sizeof(hello));
+      }
+    }
+    for (uint8_t j = 0; j < sizeof(conexiones); j++) {
+      uint8_t * conexion = mesh_conn_get_conn(j);
+      if (conexion != NULL) {
+        TEST_ASSERT_EQUAL_PTR(&conexiones[j], conexion);
+      }
+    }
+    for (int i = 0; i < MESH_CONN_MAX_CONN; i = i + 2) {
+      uint8_t j = (ronda * 7 + i) % sizeof(conexiones);
+      if (mesh_conn_delete_per(&conexiones[j]) == 0) {
+        TEST_ASSERT_NULL(mesh_conn_get_conn(j));
+      }
+    }
+  }
+}
+
+/** @test Las tramas de una conexión no superan el MTU de la conexión */
+void test_tramas_limitadas_al_mtu_de_la_conexion() {
+  uint8_t msg[MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, 40, MAX_SIZE_MSG_TEST);
+
+  TEST_ASSERT_EQUAL(-1, mesh_conn_set_mtu(&conexion_a, sizeof(msg)));
+  TEST_ASSERT_EQUAL(0, mesh_conn_set_mtu(&conexion_a, 1 + 2 * sizeof(msg)));
+
+  mesh_send_StubWithCallback(aux_guardar_trama_enviada);
+  for (int i = 0; i < 3; i++) {
+    mesh_conn_send_msg(5, msg);
+  }
+  mesh_conn_flush();
+
+  TEST_ASSERT_EQUAL(2, cantidad_tramas_enviadas);
+  TEST_ASSERT_EQUAL(1 + 2 * sizeof(msg), largo_tramas_enviadas[0]);
+  TEST_ASSERT_EQUAL(1 + sizeof(msg), largo_tramas_enviadas[1]);
+}
+
+/** @test El estado de la conexión indica el vecino, los msg encolados y el tiempo desde la última
+ * trama recibida */
+void test_estado_de_la_conexion() {
+  uint8_t msg[MSG_TEST_MSG + 1];
+  struct mesh_conn_state estado;
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, 40, 1);
+
+  mesh_conn_send_msg(5, msg);
+  mesh_conn_send_msg(5, msg);
+  mesh_conn_handler_time_out();
+  mesh_conn_handler_time_out();
+
+  TEST_ASSERT_EQUAL(0, mesh_conn_get_state(&conexion_a, &estado));
+  TEST_ASSERT_EQUAL(5, estado.id_mesh);
+  TEST_ASSERT_EQUAL(MESH_CONN_MTU, estado.mtu);
+  TEST_ASSERT_EQUAL(2, estado.queue_depth);
+  TEST_ASSERT_EQUAL(2, estado.last_seen);
+  TEST_ASSERT_EQUAL(0, estado.dropped);
+
+  uint8_t trama[] = {1, 5, 7, 7, 41, 0, 0, 0};
+  mesh_routing_send_msgs_Ignore();
+  mesh_conn_rcv_ble_msg(&conexion_a, trama, sizeof(trama));
+  mesh_conn_get_state(&conexion_a, &estado);
+  TEST_ASSERT_EQUAL(0, estado.last_seen);
+  TEST_ASSERT_EQUAL(-1, mesh_conn_get_state(&conexion_b, &estado));
+}
+
+/** @test Un msg prestado que no se puede copiar porque el pool está agotado se descarta y se cuenta
+ * en el estado de la conexión */
+void test_contar_msg_descartados_con_el_pool_agotado() {
+  uint8_t msg[MSG_TEST_MSG + 1];
+  uint8_t * ocupados[MESH_MSG_POOL_SIZE];
+  struct mesh_conn_state estado;
+  aux_conectar_vecino(&conexion_a, 5);
+  aux_generar_msg(msg, 5, 40, 1);
+
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    ocupados[i] = mesh_msg_alloc();
+  }
+  mesh_conn_send_msg(5, msg);
+  mesh_conn_send_msg(BROADCAST_DIR, msg);
+
+  mesh_conn_get_state(&conexion_a, &estado);
+  TEST_ASSERT_EQUAL(2, estado.dropped);
+  TEST_ASSERT_EQUAL(0, estado.queue_depth);
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    mesh_msg_release(ocupados[i]);
+  }
+}
+
+/** @test Las muestras de calidad de enlace de una conexión se pasan a la capa routing con el id del
+ * vecino; las de una conexión sin msg hello se descartan */
+void test_muestras_de_calidad_del_enlace() {
+  aux_conectar_vecino(&conexion_a, 5);
+  TEST_ASSERT_EQUAL(0, mesh_conn_add_per(&conexion_b));
+
+  mesh_routing_link_tx_Expect(&nodo, 5, false);
+  TEST_ASSERT_EQUAL(0, mesh_conn_link_tx(&conexion_a, false));
+  mesh_routing_link_rssi_Expect(&nodo, 5, -70);
+  TEST_ASSERT_EQUAL(0, mesh_conn_link_rssi(&conexion_a, -70));
+
+  TEST_ASSERT_EQUAL(-1, mesh_conn_link_tx(&conexion_b, true));
+  TEST_ASSERT_EQUAL(-1, mesh_conn_link_rssi(&conexion_b, -70));
+  mesh_conn_delete_per(&conexion_a);
+  TEST_ASSERT_EQUAL(-1, mesh_conn_link_tx(&conexion_a, true));
+}
+/* === End of documentation
+ * ==================================================================== */
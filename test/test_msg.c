@@ -0,0 +1,131 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file
+ ** @brief Test del pool de msg mesh_msg.c
+ */
+
+/* === Headers files inclusions
+ * =============================================================== */
+
+#include "unity.h"
+#include <stdint.h>
+
+#include "mesh.h"
+#include "mesh_msg.h"
+
+/* === Macros definitions
+ * ====================================================================== */
+
+/* === Private data type declarations
+ * ========================================================== */
+
+/* === Private variable declarations
+ * =========================================================== */
+
+/* === Private function declarations
+ * =========================================================== */
+
+/* === Public variable definitions
+ * ============================================================= */
+
+/* === Private variable definitions
+ * ============================================================ */
+
+/* === Private function implementation
+ * ========================================================= */
+
+void setUp() {
+  mesh_msg_init();
+}
+
+/* === Public function implementation
+ * ========================================================== */
+
+/** @test Al inicializar el pool todos los msg están libres */
+void test_inicializo_pool_con_todos_los_msg_libres() {
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Se pueden tomar todos los msg del pool, todos distintos, y luego no quedan más */
+void test_agotar_el_pool() {
+  uint8_t * msgs[MESH_MSG_POOL_SIZE];
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    msgs[i] = mesh_msg_alloc();
+    TEST_ASSERT_NOT_NULL(msgs[i]);
+    TEST_ASSERT_TRUE(mesh_msg_is_pooled(msgs[i]));
+    for (int j = 0; j < i; j++) {
+      TEST_ASSERT_NOT_EQUAL(msgs[j], msgs[i]);
+    }
+  }
+  TEST_ASSERT_NULL(mesh_msg_alloc());
+  TEST_ASSERT_EQUAL(0, mesh_msg_available());
+
+  mesh_msg_release(msgs[3]);
+  TEST_ASSERT_EQUAL_PTR(msgs[3], mesh_msg_alloc());
+}
+
+/** @test Un msg retenido vuelve al pool recién cuando se liberan todas sus referencias */
+void test_retener_msg_del_pool_no_lo_copia() {
+  uint8_t * msg = mesh_msg_alloc();
+
+  TEST_ASSERT_EQUAL_PTR(msg, mesh_msg_hold(msg));
+  TEST_ASSERT_EQUAL_PTR(msg, mesh_msg_hold(msg));
+  mesh_msg_release(msg);
+  mesh_msg_release(msg);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE - 1, mesh_msg_available());
+  mesh_msg_release(msg);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Retener un msg que no es del pool lo copia en un msg del pool */
+void test_retener_msg_externo_lo_copia_en_el_pool() {
+  uint8_t msg[MSG + 2] = {3, 4, 5, 78, 2, 1, 8, 'h', 'i'}; // SEQ 1, TTL 8
+
+  uint8_t * copia = mesh_msg_hold(msg);
+
+  TEST_ASSERT_NOT_NULL(copia);
+  TEST_ASSERT_NOT_EQUAL(msg, copia);
+  TEST_ASSERT_TRUE(mesh_msg_is_pooled(copia));
+  TEST_ASSERT_FALSE(mesh_msg_is_pooled(msg));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(msg, copia, sizeof(msg));
+  TEST_ASSERT_EQUAL(2, copia[LENGHT]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("hi", &copia[MSG], 2);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE - 1, mesh_msg_available());
+}
+
+/** @test Liberar un msg que no es del pool o un msg libre no modifica el pool */
+void test_liberar_msg_externo_no_modifica_el_pool() {
+  uint8_t msg[MSG + 1] = {3, 4, 5, 78, 1, 1, 8, 'h'}; // SEQ 1, TTL 8
+  uint8_t * msg_pool = mesh_msg_alloc();
+
+  mesh_msg_release(msg);
+  mesh_msg_release(msg_pool + 1);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE - 1, mesh_msg_available());
+
+  mesh_msg_release(msg_pool);
+  mesh_msg_release(msg_pool);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+/* === End of documentation
+ * ==================================================================== */
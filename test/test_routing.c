@@ -30,12 +30,14 @@ SPDX-License-Identifier: MIT
 
 #include "unity.h"
 #include <stdint.h>
+#include <string.h>
 
 #include "Mockmesh_app.h"
 #include "Mockmesh_conn.h"
 #include "Mockmesh_port.h"
 
 #include "Mockmesh.h"
+#include "mesh_msg.h"
 #include "mesh_routing.h"
 
 /* === Macros definitions
@@ -45,11 +47,20 @@ SPDX-License-Identifier: MIT
 #define NEXT_HOP_TEST_MSG  2
 #define OPCODE_TEST_MSG    3
 #define LENGHT_TEST_MSG    4
-#define MSG_TEST_MSG       5
+#define SEQ_TEST_MSG       5
+#define TTL_TEST_MSG       6
+#define MSG_TEST_MSG       7
 
 #define SRC_DIR_TEST       10
 #define BROADCAST_DIR_TEST 0xFD
 
+#define MAX_SIZE_MSG_TEST  20
+#define ENCABEZADO_ANUNCIO_TEST  3 // {formato, número de fragmento, cantidad de fragmentos}
+#define RUTAS_POR_FRAGMENTO_TEST 4 // rutas de 4 bytes en formato plano luego del encabezado
+#define FORMATO_PLANO_TEST       1
+#define FORMATO_COMPACTO_TEST    2
+#define VIA_DIRECTA_TEST         0xFE
+
 /* === Private data type declarations
  * ========================================================== */
 
@@ -65,27 +76,121 @@ SPDX-License-Identifier: MIT
 /* === Private variable definitions
  * ============================================================ */
 
-uint8_t msg_send[50];
+uint8_t msg_send[MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+
+uint8_t fragmentos_enviados[MAX_NEIGHBOR][MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+
+int cantidad_fragmentos_enviados;
+
+struct mesh_routing_ctx nodo;
+
+uint32_t arena[MESH_ROUTING_ARENA_SIZE(MESH_ROUTING_MAX_CAPACITY) / sizeof(uint32_t) + 1];
 
 /* === Private function implementation
  * ========================================================= */
 
 void setUp() {
-  mesh_routing_init();
+  mesh_port_routing_lock_Ignore();
+  mesh_port_routing_unlock_Ignore();
+  mesh_port_cycles_IgnoreAndReturn(0);
+  mesh_msg_init();
+  mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
 }
 
-/** @test Función auxiliar para generar mensajes para agregar elementos a la tabla de ruta con su
- * correspondiente formato*/
+/** @test Función auxiliar para generar mensajes para agregar elementos a la tabla de ruta en
+ * formato plano. Las rutas se indican como {destino, próximo salto, métrica} y todas deben tener el
+ * mismo próximo salto, que es el vecino que envía el anuncio. Se anuncian con número de secuencia
+ * 0*/
 
 void aux_generar_msg_para_agregar_tablas_de_ruta(uint8_t * rutas, uint8_t len) {
 
-  msg_send[SRC_TEST_MSG] = 2;
+  msg_send[SRC_TEST_MSG] = len > 0 ? rutas[1] : 2;
   msg_send[DST_TEST_MSG] = 4;
   msg_send[OPCODE_TEST_MSG] = 21; // opcode send neighbor
-  msg_send[LENGHT_TEST_MSG] = len;
-  for (size_t i = 0; i < len; i++) { // agrego las rutas al msg
-    msg_send[MSG_TEST_MSG + i] = rutas[i];
+  msg_send[LENGHT_TEST_MSG] = len / 3 * 4 + ENCABEZADO_ANUNCIO_TEST;
+  msg_send[MSG_TEST_MSG] = FORMATO_PLANO_TEST;
+  msg_send[MSG_TEST_MSG + 1] = 0; // número de fragmento
+  msg_send[MSG_TEST_MSG + 2] = 1; // cantidad de fragmentos
+  for (size_t i = 0; i < len / 3; i++) { // agrego las rutas al msg
+    uint8_t * ruta = &msg_send[MSG_TEST_MSG + ENCABEZADO_ANUNCIO_TEST + i * 4];
+    ruta[0] = rutas[i * 3];
+    ruta[1] = rutas[i * 3 + 1]; // el vecino no pasa por este nodo
+    ruta[2] = rutas[i * 3 + 2];
+    ruta[3] = 0;
+  }
+}
+
+/** @test Función auxiliar que agrega rutas de distintos vecinos, enviando un anuncio por cada grupo
+ * de rutas seguidas con el mismo próximo salto */
+
+void aux_recibir_rutas(uint8_t * rutas, uint8_t len) {
+  uint8_t inicio = 0;
+
+  for (uint8_t i = 3; i <= len; i = i + 3) {
+    if (i == len || rutas[i + 1] != rutas[inicio + 1]) {
+      aux_generar_msg_para_agregar_tablas_de_ruta(&rutas[inicio], i - inicio);
+      mesh_routing_send_msg(&nodo, msg_send);
+      inicio = i;
+    }
+  }
+}
+
+/** @test Función auxiliar para agregar muchas rutas a la tabla de ruta enviándolas en varios
+ * fragmentos */
+
+void aux_agregar_rutas_en_fragmentos(uint8_t * rutas, uint16_t len) {
+
+  for (uint16_t i = 0; i < len; i = i + RUTAS_POR_FRAGMENTO_TEST * 3) {
+    uint16_t len_fragmento = len - i;
+    if (len_fragmento > RUTAS_POR_FRAGMENTO_TEST * 3) {
+      len_fragmento = RUTAS_POR_FRAGMENTO_TEST * 3;
+    }
+    aux_generar_msg_para_agregar_tablas_de_ruta(&rutas[i], len_fragmento);
+    mesh_routing_send_msg(&nodo, msg_send);
+  }
+}
+
+/** @test Función auxiliar que decodifica un fragmento enviado en formato compacto. Guarda cada ruta
+ * como {destino, próximo salto del nodo, métrica, secuencia} y devuelve la cantidad de rutas */
+
+int aux_decodificar_fragmento(uint8_t * fragmento, uint8_t rutas[][4]) {
+  int cantidad = 0;
+  int i = MSG_TEST_MSG + ENCABEZADO_ANUNCIO_TEST;
+
+  TEST_ASSERT_EQUAL(FORMATO_COMPACTO_TEST, fragmento[MSG_TEST_MSG]);
+  while (i < MSG_TEST_MSG + fragmento[LENGHT_TEST_MSG]) {
+    uint8_t via = fragmento[i];
+    uint8_t rutas_grupo = fragmento[i + 1];
+    int dst = -1;
+    uint8_t seq = 0;
+    i = i + 2;
+    for (uint8_t k = 0; k < rutas_grupo; k++) {
+      uint8_t ruta = fragmento[i++];
+      dst = (ruta >> 4) == 0 ? fragmento[i++] : dst + (ruta >> 4);
+      if ((ruta & 0x08) != 0) {
+        seq = fragmento[i++];
+      }
+      rutas[cantidad][0] = dst;
+      rutas[cantidad][1] = via == VIA_DIRECTA_TEST ? dst : via;
+      rutas[cantidad][2] = (ruta & 0x07) == 0x07 ? fragmento[i++] : (ruta & 0x07);
+      rutas[cantidad][3] = seq;
+      cantidad++;
+    }
   }
+  TEST_ASSERT_EQUAL(MSG_TEST_MSG + fragmento[LENGHT_TEST_MSG], i);
+  return cantidad;
+}
+
+/** @test Función auxiliar que guarda los fragmentos enviados por la capa routing a la capa conn */
+
+void aux_guardar_fragmento_enviado(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+
+  TEST_ASSERT_EQUAL(BROADCAST_DIR_TEST, id_mesh);
+  TEST_ASSERT_LESS_OR_EQUAL(MAX_SIZE_MSG_TEST, msg[LENGHT_TEST_MSG]);
+  memcpy(fragmentos_enviados[cantidad_fragmentos_enviados], msg,
+         MSG_TEST_MSG + msg[LENGHT_TEST_MSG]);
+  cantidad_fragmentos_enviados++;
 }
 
 /* === Public function implementation
@@ -96,7 +201,7 @@ void aux_generar_msg_para_agregar_tablas_de_ruta(uint8_t * rutas, uint8_t len) {
 void test_inicializo_tabla_ruteo_vacia_menos_con_el_mismo() {
   uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
   mesh_print_Expect(msg);
-  mesh_routing_display_routing_table();
+  mesh_routing_display_routing_table(&nodo);
 }
 
 /** @test Con la tabla de rutas vacía agregar una ruta */
@@ -107,14 +212,14 @@ void test_agrego_un_elemento_tabla_ruteo() {
   mesh_print_Expect(msg);
   uint8_t msg2[] = "DST: 1,NEXT HOP: 9, METRIC: 4\r\n";
   mesh_print_Expect(msg2);
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_display_routing_table();
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_display_routing_table(&nodo);
 }
 
 /** @test Con la tabla de rutas vacía agregar varias rutas */
 void test_agrego_varios_elementos_tabla_ruteo() {
   uint8_t routes[] = {1, 9, 3, 2, 8, 2, 13, 11, 7};
-  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  aux_recibir_rutas(routes, sizeof(routes));
   uint8_t msg0[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
   mesh_print_Expect(msg0);
   uint8_t msg1[] = "DST: 1,NEXT HOP: 9, METRIC: 4\r\n";
@@ -123,8 +228,7 @@ void test_agrego_varios_elementos_tabla_ruteo() {
   mesh_print_Expect(msg2);
   uint8_t msg3[] = "DST: 13,NEXT HOP: 11, METRIC: 8\r\n";
   mesh_print_Expect(msg3);
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_display_routing_table();
+  mesh_routing_display_routing_table(&nodo);
 }
 
 /** @test enviar un mensaje para el mismo y ver que el mensaje es pasado a la capa de aplicación*/
@@ -132,10 +236,11 @@ void test_rutear_mensaje_para_el_mismo() {
   msg_send[SRC_TEST_MSG] = 3;
   msg_send[DST_TEST_MSG] = SRC_DIR_TEST;
   msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_send[LENGHT_TEST_MSG] = 1;
   msg_send[MSG_TEST_MSG] = '1';
   mesh_app_process_msg_Expect((uint8_t *)&msg_send[0]);
-  mesh_routing_send_msg((uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
 }
 
 /** @test enviar un mensaje para broadcast y ver que el mensaje es pasado a la capa de aplicación*/
@@ -143,10 +248,11 @@ void test_rutear_mensaje_para_broadcast() {
   msg_send[SRC_TEST_MSG] = 2;
   msg_send[DST_TEST_MSG] = BROADCAST_DIR_TEST;
   msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_send[LENGHT_TEST_MSG] = 1;
   msg_send[MSG_TEST_MSG] = '1';
   mesh_app_process_msg_Expect((uint8_t *)&msg_send[0]);
-  mesh_routing_send_msg((uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
 }
 
 /** @test enviar un mensaje para una ruta que no está definida en la tabla y ver que no se pasa a
@@ -155,9 +261,10 @@ void test_rutear_mensaje_para_una_ruta_no_alcanzable() {
   msg_send[SRC_TEST_MSG] = 2;
   msg_send[DST_TEST_MSG] = 4;
   msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_send[LENGHT_TEST_MSG] = 1;
   msg_send[MSG_TEST_MSG] = '1';
-  mesh_routing_send_msg((uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
 }
 
 /** @test enviar un mensaje para una ruta definida en la tabla y ver que se pasa a la capa de conn
@@ -168,14 +275,15 @@ void test_rutear_mensaje_para_una_ruta_alcanzable() {
   uint8_t proxsalto = 9;
   uint8_t routes[] = {dst, proxsalto, 3};
   aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
-  mesh_routing_send_msg(msg_send);
+  mesh_routing_send_msg(&nodo, msg_send);
   msg_send[SRC_TEST_MSG] = 4;
   msg_send[DST_TEST_MSG] = dst;
   msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_send[LENGHT_TEST_MSG] = 1;
   msg_send[MSG_TEST_MSG] = '1';
   mesh_conn_send_msg_Expect(proxsalto, (uint8_t *)&msg_send[0]);
-  mesh_routing_send_msg((uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
 }
 
 /** @test enviar varios mensaje para una rutas definida en la tabla y ver que cada msj se pasa a la
@@ -191,36 +299,38 @@ void test_rutear_mensaje_para_varias_rutas_alcanzable() {
   uint8_t proxsalto3 = 11;
 
   uint8_t routes[] = {dst1, proxsalto1, 3, dst2, proxsalto2, 2, dst3, proxsalto3, 7};
-  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  aux_recibir_rutas(routes, sizeof(routes));
 
-  uint8_t msg_rcv1[7];
+  uint8_t msg_rcv1[MSG_TEST_MSG + 1];
   msg_rcv1[SRC_TEST_MSG] = 4;
   msg_rcv1[DST_TEST_MSG] = dst1;
   msg_rcv1[OPCODE_TEST_MSG] = 58;
+  msg_rcv1[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_rcv1[LENGHT_TEST_MSG] = 1;
   msg_rcv1[MSG_TEST_MSG] = '4';
 
-  uint8_t msg_rcv2[7];
+  uint8_t msg_rcv2[MSG_TEST_MSG + 1];
   msg_rcv2[SRC_TEST_MSG] = 4;
   msg_rcv2[DST_TEST_MSG] = dst2;
   msg_rcv2[OPCODE_TEST_MSG] = 48;
+  msg_rcv2[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_rcv2[LENGHT_TEST_MSG] = 1;
   msg_rcv2[MSG_TEST_MSG] = '1';
 
-  uint8_t msg_rcv3[7];
+  uint8_t msg_rcv3[MSG_TEST_MSG + 1];
   msg_rcv3[SRC_TEST_MSG] = 4;
   msg_rcv3[DST_TEST_MSG] = dst3;
   msg_rcv3[OPCODE_TEST_MSG] = 48;
+  msg_rcv3[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
   msg_rcv3[LENGHT_TEST_MSG] = 1;
   msg_rcv3[MSG_TEST_MSG] = '7';
 
   mesh_conn_send_msg_Expect(proxsalto1, (uint8_t *)&msg_rcv1[0]);
   mesh_conn_send_msg_Expect(proxsalto2, (uint8_t *)&msg_rcv2[0]);
   mesh_conn_send_msg_Expect(proxsalto3, (uint8_t *)&msg_rcv3[0]);
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_send_msg((uint8_t *)&msg_rcv1[0]);
-  mesh_routing_send_msg((uint8_t *)&msg_rcv2[0]);
-  mesh_routing_send_msg((uint8_t *)&msg_rcv3[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_rcv1[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_rcv2[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_rcv3[0]);
 }
 
 /** @test Agregar y eliminar una ruta en la tabla de rutas */
@@ -232,36 +342,1520 @@ void test_eliminar_elemento_tabla_ruteo_time_out() {
   mesh_conn_send_msg_Ignore();
   mesh_print_Expect(msg);
 
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_handler_time_out();
-  mesh_routing_handler_time_out();
-  mesh_routing_handler_time_out();
-  mesh_routing_handler_time_out();
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
 
-  mesh_routing_display_routing_table();
+  mesh_routing_display_routing_table(&nodo);
 }
 
 /** @test Agregar dos posibles rutas a un mismo destino. Eliminar la primera ruta por timeout y ver
  * que la segunda ruta pasa a la primera */
 void test_eliminar_elemento_tabla_ruteo_y_quedarme_con_la_segunda_ruta() {
   uint8_t routes[] = {1, 11, 7, 1, 9, 3};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
+  uint8_t msg2[] = "DST: 1,NEXT HOP: 11, METRIC: 8\r\n";
+  mesh_conn_send_msg_Ignore();
+  mesh_print_Expect(msg);
+  mesh_print_Expect(msg2);
+
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  uint8_t routes2[] = {1, 11, 7};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Eliminar una ruta por timeout y volver a agregarla, la posición liberada se reutiliza y el
+ * destino vuelve a ser alcanzable */
+void test_reutilizar_elemento_eliminado_tabla_ruteo() {
+  uint8_t routes[] = {1, 9, 3};
   aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
 
+  uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
+  uint8_t msg2[] = "DST: 5,NEXT HOP: 8, METRIC: 2\r\n";
+  mesh_conn_send_msg_Ignore();
+  mesh_print_Expect(msg);
+  mesh_print_Expect(msg2);
+
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+
+  uint8_t routes2[] = {5, 8, 1};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Con la tabla de rutas llena, una ruta nueva que no mejora a ninguna se descarta y una
+ * ruta nueva con mejor métrica reemplaza a la de peor métrica */
+void test_agregar_ruta_con_tabla_llena() {
+  uint8_t routes[(MAX_NEIGHBOR - 1) * 3];
+  for (uint8_t i = 0; i < MAX_NEIGHBOR - 1; i++) { // la tabla queda llena con el propio nodo
+    routes[i * 3] = 30 + i;
+    routes[i * 3 + 1] = 9;
+    routes[i * 3 + 2] = 1;
+  }
+  routes[2] = 2; // el destino 30 tiene la peor métrica
+  aux_agregar_rutas_en_fragmentos(routes, sizeof(routes));
+
+  uint8_t routes1[] = {30 + MAX_NEIGHBOR - 1, 9, 2};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes1, sizeof(routes1));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  uint8_t routes2[] = {60, 8, 0};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  msg_send[SRC_TEST_MSG] = 4;
+  msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+  msg_send[LENGHT_TEST_MSG] = 1;
+  msg_send[MSG_TEST_MSG] = '1';
+
+  msg_send[DST_TEST_MSG] = 30 + MAX_NEIGHBOR - 1; // no entró en la tabla
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
+
+  msg_send[DST_TEST_MSG] = 30; // reemplazada por el destino 60
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
+
+  msg_send[DST_TEST_MSG] = 60;
+  mesh_conn_send_msg_Expect(8, (uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
+}
+
+/** @test La inicialización falla si la arena no alcanza para la capacidad pedida */
+void test_inicializar_con_arena_insuficiente() {
+  TEST_ASSERT_EQUAL(-1, mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                                          MESH_ROUTING_ARENA_SIZE(10)));
+  TEST_ASSERT_EQUAL(-1, mesh_routing_init(&nodo, SRC_DIR_TEST, 0, arena, sizeof(arena)));
+  TEST_ASSERT_EQUAL(-1, mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, NULL, sizeof(arena)));
+  TEST_ASSERT_EQUAL(-1, mesh_routing_init(&nodo, BROADCAST_DIR_TEST, MAX_NEIGHBOR, arena,
+                                          sizeof(arena)));
+}
+
+/** @test Con una tabla de capacidad máxima se pueden alcanzar todas las direcciones unicast */
+void test_tabla_de_capacidad_maxima() {
+  TEST_ASSERT_EQUAL(0, mesh_routing_init(&nodo, SRC_DIR_TEST, MESH_ROUTING_MAX_CAPACITY, arena,
+                                         sizeof(arena)));
+
+  uint8_t routes[3];
+  for (uint8_t dst = 0; dst < MESH_ROUTING_MAX_CAPACITY; dst++) {
+    routes[0] = dst;
+    routes[1] = 9;
+    routes[2] = 1;
+    aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+    mesh_routing_send_msg(&nodo, msg_send);
+  }
+
+  msg_send[SRC_TEST_MSG] = 4;
+  msg_send[DST_TEST_MSG] = MESH_ROUTING_MAX_CAPACITY - 1;
+  msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+  msg_send[LENGHT_TEST_MSG] = 1;
+  msg_send[MSG_TEST_MSG] = '1';
+  mesh_conn_send_msg_Expect(9, (uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
+}
+
+/** @test Una tabla que no entra en un solo msg se envía en varios fragmentos numerados, cada uno
+ * dentro del tamaño máximo de msg, y otro nodo puede aprender todas las rutas a partir de ellos */
+void test_enviar_tabla_de_rutas_en_fragmentos() {
+  uint8_t routes[(MAX_NEIGHBOR - 1) * 3];
+  for (uint8_t i = 0; i < MAX_NEIGHBOR - 1; i++) {
+    routes[i * 3] = 30 + i;
+    routes[i * 3 + 1] = 9;
+    routes[i * 3 + 2] = i;
+  }
+  aux_agregar_rutas_en_fragmentos(routes, sizeof(routes));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  // el primer anuncio lleva toda la tabla: 20 rutas, que en formato plano ocuparían 5 fragmentos
+  uint8_t rutas[MAX_NEIGHBOR][4];
+  int cantidad = 0;
+  TEST_ASSERT_EQUAL(3, cantidad_fragmentos_enviados);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(i, fragmentos_enviados[i][MSG_TEST_MSG + 1]);
+    TEST_ASSERT_EQUAL(3, fragmentos_enviados[i][MSG_TEST_MSG + 2]);
+    TEST_ASSERT_EQUAL(SRC_DIR_TEST, fragmentos_enviados[i][SRC_TEST_MSG]);
+    cantidad = cantidad + aux_decodificar_fragmento(fragmentos_enviados[i], &rutas[cantidad]);
+  }
+  TEST_ASSERT_EQUAL(MAX_NEIGHBOR, cantidad);
+  for (int i = 0; i < MAX_NEIGHBOR - 1; i++) {
+    TEST_ASSERT_EQUAL(30 + i, rutas[i][0]);
+    TEST_ASSERT_EQUAL(9, rutas[i][1]); // su próximo salto
+    TEST_ASSERT_EQUAL(i + 1, rutas[i][2]);
+  }
+  TEST_ASSERT_EQUAL(SRC_DIR_TEST, rutas[MAX_NEIGHBOR - 1][0]);
+  TEST_ASSERT_EQUAL(0, rutas[MAX_NEIGHBOR - 1][2]);
+
+  // otro nodo procesa los fragmentos y alcanza el destino 48 a través de este nodo
+  mesh_routing_init(&nodo, 11, MAX_NEIGHBOR + 1, arena, sizeof(arena)); // lugar para el anunciante
+  for (int i = 0; i < 3; i++) {
+    mesh_routing_send_msg(&nodo, fragmentos_enviados[i]);
+  }
+
+  msg_send[SRC_TEST_MSG] = 4;
+  msg_send[DST_TEST_MSG] = 48;
+  msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+  msg_send[LENGHT_TEST_MSG] = 1;
+  msg_send[MSG_TEST_MSG] = '1';
+  mesh_conn_send_msg_Expect(SRC_DIR_TEST, (uint8_t *)&msg_send[0]);
+  mesh_routing_send_msg(&nodo, (uint8_t *)&msg_send[0]);
+}
+
+/** @test En formato compacto las rutas se agrupan por próximo salto: {via, cantidad, rutas...}, y
+ * cada ruta ocupa un byte con la diferencia de destino y la métrica. El grupo de los vecinos
+ * directos, cuyo próximo salto es el propio destino, va con via VIA_DIRECTA_TEST */
+void test_anuncio_en_formato_compacto() {
+  uint8_t routes[] = {1, 9, 3, 2, 9, 2, 9, 9, 0};
+  uint8_t esperado[] = {FORMATO_COMPACTO_TEST, 0, 1,     // encabezado
+                        9, 2, 0x24, 0x13,                // destinos 1 y 2 a través de 9
+                        VIA_DIRECTA_TEST, 2, 0xA1, 0x10}; // vecino 9 y el propio nodo
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(sizeof(esperado), fragmentos_enviados[0][LENGHT_TEST_MSG]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(esperado, &fragmentos_enviados[0][MSG_TEST_MSG], sizeof(esperado));
+}
+
+/** @test En formato compacto el destino, el número de secuencia y la métrica que no entran en el
+ * primer byte de la ruta van a continuación; una ruta sin número de secuencia usa el de la anterior
+ */
+void test_recibir_anuncio_en_formato_compacto() {
+  uint8_t next_hop, metric;
+  uint8_t anuncio[] = {FORMATO_COMPACTO_TEST, 0, 1, 9, 2, 0x0F, 40, 4, 20, 0x12};
+  msg_send[SRC_TEST_MSG] = 9;
+  msg_send[OPCODE_TEST_MSG] = 21; // opcode send neighbor
+  msg_send[LENGHT_TEST_MSG] = sizeof(anuncio);
+  memcpy(&msg_send[MSG_TEST_MSG], anuncio, sizeof(anuncio));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 40, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(9, next_hop);
+  TEST_ASSERT_EQUAL(21, metric);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 41, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(3, metric);
+
+  uint8_t routes[] = {41, 9, 0}; // secuencia 0, más vieja que la 4 del anuncio compacto
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 41, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(3, metric);
+}
+
+/** @test Un fragmento más largo que el tamaño máximo de msg se descarta */
+void test_descartar_fragmento_invalido() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  msg_send[LENGHT_TEST_MSG] = MAX_SIZE_MSG_TEST + 1;
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
+  mesh_print_Expect(msg);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Función auxiliar que busca una ruta en los fragmentos enviados y devuelve la métrica
+ * anunciada, o -1 si la ruta no se anunció */
+
+int aux_metrica_anunciada(uint8_t dst) {
+  uint8_t rutas[MAX_NEIGHBOR][4];
+  for (int i = 0; i < cantidad_fragmentos_enviados; i++) {
+    int cantidad = aux_decodificar_fragmento(fragmentos_enviados[i], rutas);
+    for (int j = 0; j < cantidad; j++) {
+      if (rutas[j][0] == dst) {
+        return rutas[j][2];
+      }
+    }
+  }
+  return -1;
+}
+
+/** @test Si no cambió ninguna ruta el anuncio periódico siguiente al anuncio completo no lleva
+ * rutas */
+void test_anuncio_periodico_sin_cambios_no_lleva_rutas() {
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo); // anuncio completo
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo); // anuncio periódico
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(2, cantidad_fragmentos_enviados);
+  uint8_t rutas[MAX_NEIGHBOR][4];
+  TEST_ASSERT_EQUAL(3, aux_decodificar_fragmento(fragmentos_enviados[0], rutas));
+  TEST_ASSERT_EQUAL(ENCABEZADO_ANUNCIO_TEST, fragmentos_enviados[1][LENGHT_TEST_MSG]);
+}
+
+/** @test Cuando mejora la métrica de una ruta se anuncia solo esa ruta en el paso siguiente del
+ * handler, sin esperar al anuncio periódico */
+void test_cambio_de_metrica_dispara_anuncio() {
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo); // anuncio completo
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+
+  uint8_t routes2[] = {1, 7, 1};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  uint8_t rutas[MAX_NEIGHBOR][4];
+  TEST_ASSERT_EQUAL(1, aux_decodificar_fragmento(fragmentos_enviados[0], rutas));
+  TEST_ASSERT_EQUAL(2, aux_metrica_anunciada(1));
+}
+
+/** @test Cuando una ruta expira se anuncia como perdida, con métrica infinita, en el mismo paso */
+void test_ruta_perdida_se_anuncia() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(0xFF, aux_metrica_anunciada(1));
+}
+
+/** @test Si un vecino anuncia como perdida la ruta principal, el segundo camino pasa a ser el
+ * principal. Si no hay segundo camino el destino deja de ser alcanzable */
+void test_recibir_ruta_perdida() {
+  uint8_t routes[] = {1, 9, 3, 1, 11, 7, 2, 9, 1};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  uint8_t routes2[] = {1, 9, 0xFF, 2, 9, 0xFF};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+
   uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
   uint8_t msg2[] = "DST: 1,NEXT HOP: 11, METRIC: 8\r\n";
+  mesh_print_Expect(msg);
+  mesh_print_Expect(msg2);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Un anuncio sin rutas de un vecino mantiene vigentes las rutas que pasan por él */
+void test_anuncio_vacio_mantiene_rutas_del_vecino() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  msg_send[SRC_TEST_MSG] = 9;
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, 0);
+  msg_send[SRC_TEST_MSG] = 9;
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+
+  uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
+  uint8_t msg2[] = "DST: 1,NEXT HOP: 9, METRIC: 4\r\n";
+  mesh_print_Expect(msg);
+  mesh_print_Expect(msg2);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Función auxiliar que cuenta los msg enviados por la capa routing a la capa conn */
+
+void aux_contar_anuncio(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  cantidad_fragmentos_enviados++;
+}
+
+/** @test En modo adaptativo, con la tabla sin cambios, el intervalo entre anuncios crece y se
+ * envían muchos menos anuncios que en el modo fijo */
+void test_modo_adaptativo_reduce_anuncios_con_tabla_estable() {
+  mesh_routing_set_trickle(&nodo, true);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_anuncio);
+  for (int i = 0; i < 200; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_GREATER_THAN(3, cantidad_fragmentos_enviados);
+  TEST_ASSERT_LESS_THAN(12, cantidad_fragmentos_enviados);
+}
+
+/** @test En modo adaptativo, escuchar anuncios de vecinos que no cambian la tabla suprime el
+ * anuncio propio */
+void test_modo_adaptativo_suprime_anuncios_redundantes() {
+  uint8_t routes[] = {9, 9, 0};
+  mesh_routing_set_trickle(&nodo, true);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  msg_send[SRC_TEST_MSG] = 9;
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_anuncio);
+  for (int i = 0; i < 200; i++) {
+    aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+    msg_send[SRC_TEST_MSG] = 9;
+    mesh_routing_send_msg(&nodo, msg_send);
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_GREATER_THAN(0, cantidad_fragmentos_enviados);
+  TEST_ASSERT_LESS_THAN(5, cantidad_fragmentos_enviados);
+}
+
+/** @test En modo adaptativo, un cambio en la tabla vuelve el intervalo al mínimo y se anuncia
+ * enseguida */
+void test_modo_adaptativo_anuncia_enseguida_ante_un_cambio() {
+  mesh_routing_set_trickle(&nodo, true);
   mesh_conn_send_msg_Ignore();
+  for (int i = 0; i < 200; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(4, aux_metrica_anunciada(1));
+}
+
+/** @test Función auxiliar que cuenta los msg enviados por cada próximo salto */
+
+int msg_por_proximo_salto[256];
+
+void aux_contar_msg_por_proximo_salto(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  TEST_ASSERT_EQUAL(id_mesh, msg[NEXT_HOP_TEST_MSG]);
+  msg_por_proximo_salto[id_mesh]++;
+}
+
+/** @test Con dos caminos de igual métrica el tráfico se reparte entre ambos según el flujo, y los
+ * msg de un mismo flujo siguen siempre el mismo camino */
+void test_repartir_trafico_entre_caminos_de_igual_metrica() {
+  uint8_t routes[] = {1, 9, 3, 1, 11, 3};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  memset(msg_por_proximo_salto, 0, sizeof(msg_por_proximo_salto));
+  mesh_conn_send_msg_StubWithCallback(aux_contar_msg_por_proximo_salto);
+  for (uint8_t src = 0; src < 50; src++) {
+    msg_send[SRC_TEST_MSG] = src;
+    msg_send[DST_TEST_MSG] = 1;
+    msg_send[OPCODE_TEST_MSG] = 78;
+    msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+    msg_send[LENGHT_TEST_MSG] = 1;
+    mesh_routing_send_msg(&nodo, msg_send);
+  }
+  TEST_ASSERT_GREATER_THAN(0, msg_por_proximo_salto[9]);
+  TEST_ASSERT_GREATER_THAN(0, msg_por_proximo_salto[11]);
+  TEST_ASSERT_EQUAL(50, msg_por_proximo_salto[9] + msg_por_proximo_salto[11]);
+
+  memset(msg_por_proximo_salto, 0, sizeof(msg_por_proximo_salto));
+  for (int i = 0; i < 10; i++) {
+    msg_send[SRC_TEST_MSG] = 7;
+    msg_send[DST_TEST_MSG] = 1;
+    msg_send[OPCODE_TEST_MSG] = 78;
+    msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+    mesh_routing_send_msg(&nodo, msg_send);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_TRUE(msg_por_proximo_salto[9] == 10 || msg_por_proximo_salto[11] == 10);
+}
+
+/** @test Si los caminos tienen distinta métrica todo el tráfico va por el mejor */
+void test_no_repartir_trafico_con_caminos_de_distinta_metrica() {
+  uint8_t routes[] = {1, 9, 3, 1, 11, 4};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  memset(msg_por_proximo_salto, 0, sizeof(msg_por_proximo_salto));
+  mesh_conn_send_msg_StubWithCallback(aux_contar_msg_por_proximo_salto);
+  for (uint8_t src = 0; src < 50; src++) {
+    msg_send[SRC_TEST_MSG] = src;
+    msg_send[DST_TEST_MSG] = 1;
+    msg_send[OPCODE_TEST_MSG] = 78;
+    msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+    msg_send[LENGHT_TEST_MSG] = 1;
+    mesh_routing_send_msg(&nodo, msg_send);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_EQUAL(50, msg_por_proximo_salto[9]);
+}
+
+/** @test Un vecino que ya es camino hacia un destino y anuncia una nueva métrica actualiza su
+ * camino en lugar de agregar otro */
+void test_actualizar_metrica_de_un_camino_existente() {
+  uint8_t routes[] = {1, 9, 3, 1, 11, 5, 1, 9, 6};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  uint8_t msg[] = "DST: 10,NEXT HOP: 10, METRIC: 0\r\n";
+  uint8_t msg2[] = "DST: 1,NEXT HOP: 11, METRIC: 6\r\n";
   mesh_print_Expect(msg);
   mesh_print_Expect(msg2);
+  mesh_routing_display_routing_table(&nodo);
+}
+
+/** @test Función auxiliar que guarda el lote de msg entregado a la capa conn */
+
+uint8_t * lote_enviado[MAX_NEIGHBOR];
+
+int cantidad_lote_enviado;
+
+void aux_guardar_lote_enviado(uint8_t ** msgs, uint8_t count, int num_calls) {
+  TEST_ASSERT_EQUAL(0, num_calls);
+  memcpy(lote_enviado, msgs, count * sizeof(uint8_t *));
+  cantidad_lote_enviado = count;
+}
+
+/** @test Función auxiliar para generar un msg de aplicación */
+
+void aux_generar_msg_de_aplicacion(uint8_t * msg, uint8_t dst) {
+  msg[SRC_TEST_MSG] = 4;
+  msg[DST_TEST_MSG] = dst;
+  msg[NEXT_HOP_TEST_MSG] = 0;
+  msg[OPCODE_TEST_MSG] = 78;
+  msg[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+  msg[LENGHT_TEST_MSG] = 1;
+  msg[MSG_TEST_MSG] = '1';
+}
+
+/** @test Un lote de msg se procesa en orden: los msg de la capa routing actualizan la tabla, los
+ * msg para él mismo pasan a la capa de aplicación y el resto se entrega a la capa conn en una sola
+ * llamada, agrupado por próximo salto */
+void test_rutear_lote_de_mensajes() {
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2, 13, 9, 5};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  uint8_t msg_1[MSG_TEST_MSG + 1], msg_2[MSG_TEST_MSG + 1], msg_propio[MSG_TEST_MSG + 1];
+  uint8_t msg_13[MSG_TEST_MSG + 1], msg_20[MSG_TEST_MSG + 1], msg_50[MSG_TEST_MSG + 1];
+  aux_generar_msg_de_aplicacion(msg_1, 1);
+  aux_generar_msg_de_aplicacion(msg_2, 2);
+  aux_generar_msg_de_aplicacion(msg_propio, SRC_DIR_TEST);
+  aux_generar_msg_de_aplicacion(msg_13, 13);
+  aux_generar_msg_de_aplicacion(msg_20, 20);
+  aux_generar_msg_de_aplicacion(msg_50, 50);
+  uint8_t routes2[] = {20, 8, 1};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+
+  uint8_t * lote[] = {msg_1, msg_2, msg_propio, msg_send, msg_13, msg_20, msg_50};
+
+  mesh_app_process_msg_Expect(msg_propio);
+  mesh_conn_send_msgs_StubWithCallback(aux_guardar_lote_enviado);
+  mesh_routing_send_msgs(&nodo, lote, sizeof(lote) / sizeof(lote[0]));
+
+  TEST_ASSERT_EQUAL(4, cantidad_lote_enviado);
+  TEST_ASSERT_EQUAL_PTR(msg_2, lote_enviado[0]);
+  TEST_ASSERT_EQUAL_PTR(msg_20, lote_enviado[1]);
+  TEST_ASSERT_EQUAL_PTR(msg_1, lote_enviado[2]);
+  TEST_ASSERT_EQUAL_PTR(msg_13, lote_enviado[3]);
+  TEST_ASSERT_EQUAL(8, msg_20[NEXT_HOP_TEST_MSG]);
+  TEST_ASSERT_EQUAL(9, msg_13[NEXT_HOP_TEST_MSG]);
+}
+
+/** @test Función auxiliar que guarda el msg entregado a la capa conn sin copiarlo */
+
+uint8_t * msg_entregado;
+
+void aux_guardar_msg_entregado(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  msg_entregado = msg;
+  TEST_ASSERT_TRUE(id_mesh == BROADCAST_DIR_TEST || id_mesh == msg[NEXT_HOP_TEST_MSG]);
+}
+
+/** @test Un msg que no es para él mismo se entrega a la capa conn en el mismo buffer, con el
+ * próximo salto escrito en el campo NEXT_HOP */
+void test_reenviar_mensaje_sin_copiarlo() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  uint8_t msg[MSG_TEST_MSG + 1];
+  aux_generar_msg_de_aplicacion(msg, 1);
+  msg_entregado = NULL;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_msg_entregado);
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL_PTR(msg, msg_entregado);
+  TEST_ASSERT_EQUAL(9, msg[NEXT_HOP_TEST_MSG]);
+}
+
+/** @test Los fragmentos del anuncio de rutas se arman en msg del pool y vuelven al pool luego de
+ * entregarse a la capa conn */
+void test_anuncio_de_rutas_usa_el_pool_de_msg() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  msg_entregado = NULL;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_msg_entregado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_TRUE(mesh_msg_is_pooled(msg_entregado));
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Con el pool de msg agotado no se anuncian rutas y las rutas modificadas se anuncian en el
+ * paso siguiente a que se libere un msg */
+void test_anunciar_rutas_con_el_pool_agotado() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  uint8_t * ocupados[MESH_MSG_POOL_SIZE];
+  for (int i = 0; i < MESH_MSG_POOL_SIZE; i++) {
+    ocupados[i] = mesh_msg_alloc();
+  }
+  mesh_routing_handler_time_out(&nodo); // sin msg libres no llama a la capa conn
+  mesh_msg_release(ocupados[0]);
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(4, aux_metrica_anunciada(1));
+}
+
+/** @test Función auxiliar que guarda los fragmentos enviados y los retiene, como la capa conn
+ * cuando los encola */
+
+uint8_t * fragmentos_retenidos[MESH_MSG_POOL_SIZE];
+
+int cantidad_retenidos;
+
+void aux_retener_fragmento_enviado(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  aux_guardar_fragmento_enviado(id_mesh, msg, num_calls);
+  fragmentos_retenidos[cantidad_retenidos++] = mesh_msg_hold(msg);
+}
+
+/** @test Función auxiliar que libera los fragmentos retenidos, como la capa conn al enviarlos */
+void aux_liberar_fragmentos_retenidos() {
+  for (int i = 0; i < cantidad_retenidos; i++) {
+    mesh_msg_release(fragmentos_retenidos[i]);
+  }
+  cantidad_retenidos = 0;
+}
 
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_handler_time_out();
-  mesh_routing_handler_time_out();
+/** @test Si el pool no tiene lugar para todos los fragmentos del anuncio completo se envían los que
+ * entran y el resto en el paso siguiente, numerados a continuación */
+void test_anuncio_completo_con_el_pool_casi_agotado() {
+  uint8_t routes[(MAX_NEIGHBOR - 1) * 3];
+  for (uint8_t i = 0; i < MAX_NEIGHBOR - 1; i++) {
+    routes[i * 3] = 30 + i;
+    routes[i * 3 + 1] = 9;
+    routes[i * 3 + 2] = i;
+  }
+  aux_agregar_rutas_en_fragmentos(routes, sizeof(routes));
+
+  uint8_t * ocupados[MESH_MSG_POOL_SIZE - 2];
+  for (int i = 0; i < MESH_MSG_POOL_SIZE - 2; i++) {
+    ocupados[i] = mesh_msg_alloc();
+  }
+  cantidad_fragmentos_enviados = 0;
+  cantidad_retenidos = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_retener_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo); // el anuncio completo necesita 3 fragmentos
+  TEST_ASSERT_EQUAL(2, cantidad_fragmentos_enviados);
+
+  for (int i = 0; i < MESH_MSG_POOL_SIZE - 2; i++) {
+    mesh_msg_release(ocupados[i]);
+  }
+  aux_liberar_fragmentos_retenidos();
+  mesh_routing_handler_time_out(&nodo);
+  aux_liberar_fragmentos_retenidos();
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  uint8_t rutas[MAX_NEIGHBOR][4];
+  int cantidad = 0;
+  TEST_ASSERT_EQUAL(3, cantidad_fragmentos_enviados);
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(i, fragmentos_enviados[i][MSG_TEST_MSG + 1]);
+    TEST_ASSERT_EQUAL(3, fragmentos_enviados[i][MSG_TEST_MSG + 2]);
+    cantidad = cantidad + aux_decodificar_fragmento(fragmentos_enviados[i], &rutas[cantidad]);
+  }
+  TEST_ASSERT_EQUAL(MAX_NEIGHBOR, cantidad);
+}
+
+/** @test Un anuncio completo que necesita más fragmentos que el pool, con la capa conn reteniendo
+ * cada fragmento hasta el paso siguiente, sale entero en dos pasos y recién entonces el anuncio
+ * periódico siguiente es incremental */
+void test_anuncio_completo_mas_grande_que_el_pool() {
+  uint8_t routes[60 * 3];
+  mesh_routing_init(&nodo, SRC_DIR_TEST, 64, arena, sizeof(arena));
+  for (uint8_t i = 0; i < 60; i++) {
+    routes[i * 3] = 100 + i;
+    routes[i * 3 + 1] = 9;
+    routes[i * 3 + 2] = 10; // métrica que no entra en 3 bits, dos bytes por ruta
+  }
+  aux_agregar_rutas_en_fragmentos(routes, sizeof(routes));
+
+  cantidad_fragmentos_enviados = 0;
+  cantidad_retenidos = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_retener_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(0, mesh_routing_idle_ticks(&nodo));
+  aux_liberar_fragmentos_retenidos();
+  mesh_routing_handler_time_out(&nodo);
+  aux_liberar_fragmentos_retenidos();
+
+  uint8_t fragmentos = fragmentos_enviados[0][MSG_TEST_MSG + 2];
+  uint8_t rutas[64][4];
+  int cantidad = 0;
+  TEST_ASSERT_GREATER_THAN(MESH_MSG_POOL_SIZE, fragmentos);
+  TEST_ASSERT_EQUAL(fragmentos, cantidad_fragmentos_enviados);
+  for (int i = 0; i < fragmentos; i++) {
+    TEST_ASSERT_EQUAL(i, fragmentos_enviados[i][MSG_TEST_MSG + 1]);
+    TEST_ASSERT_EQUAL(fragmentos, fragmentos_enviados[i][MSG_TEST_MSG + 2]);
+    cantidad = cantidad + aux_decodificar_fragmento(fragmentos_enviados[i], &rutas[cantidad]);
+  }
+  TEST_ASSERT_EQUAL(61, cantidad); // las 60 rutas y el propio nodo
+  for (int i = 0; i < 60; i++) {
+    TEST_ASSERT_EQUAL(100 + i, rutas[i][0]);
+  }
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_routing_handler_time_out(&nodo); // anuncio periódico incremental, sin rutas modificadas
+  aux_liberar_fragmentos_retenidos();
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_EQUAL(1, cantidad_fragmentos_enviados);
+  TEST_ASSERT_EQUAL(ENCABEZADO_ANUNCIO_TEST, fragmentos_enviados[0][LENGHT_TEST_MSG]);
+}
+
+/** @test Variables y funciones auxiliares para simular una red de varios nodos en línea en un
+ * mismo proceso. Cada nodo tiene su propio contexto y su propia arena; la capa conn simulada
+ * entrega los anuncios del nodo que está ejecutando su handler a sus vecinos inmediatos. */
+
+#define NODOS_SIMULADOS_TEST 5
+
+struct mesh_routing_ctx nodos[NODOS_SIMULADOS_TEST];
+
+uint32_t arenas[NODOS_SIMULADOS_TEST][MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR) / sizeof(uint32_t) + 1];
+
+int nodo_actual;
+
+void aux_entregar_anuncio_a_vecinos(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  TEST_ASSERT_EQUAL(BROADCAST_DIR_TEST, id_mesh);
+  TEST_ASSERT_EQUAL(mesh_routing_get_id(&nodos[nodo_actual]), msg[SRC_TEST_MSG]);
+  if (nodo_actual > 0) {
+    mesh_routing_send_msg(&nodos[nodo_actual - 1], msg);
+  }
+  if (nodo_actual < NODOS_SIMULADOS_TEST - 1) {
+    mesh_routing_send_msg(&nodos[nodo_actual + 1], msg);
+  }
+}
+
+/** @test Varios nodos con su propio contexto conviven en un mismo proceso y cada uno aprende las
+ * rutas hacia el resto a través de sus vecinos */
+void test_simular_red_de_varios_nodos() {
+  for (int i = 0; i < NODOS_SIMULADOS_TEST; i++) {
+    TEST_ASSERT_EQUAL(0, mesh_routing_init(&nodos[i], 20 + i, MAX_NEIGHBOR, arenas[i],
+                                           MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR)));
+  }
+
+  mesh_conn_send_msg_StubWithCallback(aux_entregar_anuncio_a_vecinos);
+  for (int paso = 0; paso < 4 * NODOS_SIMULADOS_TEST; paso++) {
+    for (nodo_actual = 0; nodo_actual < NODOS_SIMULADOS_TEST; nodo_actual++) {
+      mesh_routing_handler_time_out(&nodos[nodo_actual]);
+    }
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  uint8_t next_hop, metric;
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodos[0], 20 + NODOS_SIMULADOS_TEST - 1, &next_hop,
+                                          &metric));
+  TEST_ASSERT_EQUAL(21, next_hop);
+  TEST_ASSERT_EQUAL(NODOS_SIMULADOS_TEST - 1, metric);
+  TEST_ASSERT_TRUE(
+      mesh_routing_get_route(&nodos[NODOS_SIMULADOS_TEST - 1], 20, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(20 + NODOS_SIMULADOS_TEST - 2, next_hop);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodos[2], SRC_DIR_TEST, &next_hop, &metric));
+}
+/** @test Los contadores registran los msg reenviados, los entregados al propio nodo y los
+ * descartados por no tener ruta */
+void test_contadores_de_msg_ruteados() {
+  struct mesh_routing_stats stats;
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  msg_send[SRC_TEST_MSG] = 4;
+  msg_send[OPCODE_TEST_MSG] = 78;
+  msg_send[TTL_TEST_MSG] = MESH_ROUTING_DEFAULT_TTL;
+  msg_send[LENGHT_TEST_MSG] = 1;
+  msg_send[DST_TEST_MSG] = 1;
+  mesh_conn_send_msg_Expect(9, msg_send);
+  mesh_routing_send_msg(&nodo, msg_send);
+  msg_send[DST_TEST_MSG] = SRC_DIR_TEST;
+  mesh_app_process_msg_Expect(msg_send);
+  mesh_routing_send_msg(&nodo, msg_send);
+  msg_send[DST_TEST_MSG] = 77;
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_FORWARDED]);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_DELIVERED]);
+  TEST_ASSERT_EQUAL(2, stats.counters[MESH_ROUTING_STAT_DROPPED_UNREACHABLE]);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_ROUTES_ADDED]);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_ADV_RECEIVED]);
+
+  mesh_routing_reset_stats(&nodo);
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(0, stats.counters[MESH_ROUTING_STAT_DROPPED_UNREACHABLE]);
+}
+
+/** @test Los contadores registran el cambio al segundo camino cuando expira el mejor, la ruta
+ * perdida cuando expiran todos y los anuncios enviados con sus bytes */
+void test_contadores_de_caminos_y_anuncios() {
+  struct mesh_routing_stats stats;
+  uint8_t routes[] = {1, 11, 7, 1, 9, 3};
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
   uint8_t routes2[] = {1, 11, 7};
   aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
-  mesh_routing_send_msg(msg_send);
-  mesh_routing_handler_time_out();
-  mesh_routing_handler_time_out();
-  mesh_routing_display_routing_table();
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_handler_time_out(&nodo);
+  mesh_routing_handler_time_out(&nodo);
+
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_PATH_SWAPS]);
+  TEST_ASSERT_EQUAL(0, stats.counters[MESH_ROUTING_STAT_ROUTES_EXPIRED]);
+
+  for (int i = 0; i < 4; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  uint32_t bytes = 0;
+  for (int i = 0; i < cantidad_fragmentos_enviados; i++) {
+    bytes = bytes + MSG_TEST_MSG + fragmentos_enviados[i][LENGHT_TEST_MSG];
+  }
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_ROUTES_EXPIRED]);
+  TEST_ASSERT_EQUAL(cantidad_fragmentos_enviados, stats.counters[MESH_ROUTING_STAT_ADV_SENT]);
+  TEST_ASSERT_EQUAL(bytes, stats.counters[MESH_ROUTING_STAT_BYTES_SENT]);
+}
+
+/** @test Función auxiliar que simula un contador de ciclos que avanza 100 ciclos por lectura */
+
+uint32_t aux_ciclos(int num_calls) {
+  static uint32_t ciclos = 0;
+  ciclos = ciclos + 100;
+  return ciclos;
+}
+
+/** @test Cada búsqueda de ruta se registra en el intervalo del histograma que corresponde a su
+ * duración */
+void test_histograma_de_latencia_de_busqueda() {
+  struct mesh_routing_stats stats;
+  uint8_t next_hop, metric;
+
+  mesh_routing_get_route(&nodo, 1, &next_hop, &metric);
+  mesh_port_cycles_StubWithCallback(aux_ciclos);
+  mesh_routing_get_route(&nodo, 1, &next_hop, &metric);
+
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.lookup_latency[0]);
+  TEST_ASSERT_EQUAL(1, stats.lookup_latency[3]); // 100 ciclos: entre 64 y 128
+}
+/** @test Un camino vence exactamente MESH_ROUTING_ROUTE_LIFETIME pasos después de su último
+ * anuncio, sin importar en qué paso del handler se recibió */
+void test_camino_vence_a_los_pasos_de_vida() {
+  uint8_t routes[] = {1, 9, 3};
+  uint8_t next_hop, metric;
+
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_handler_time_out(&nodo);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  for (int i = 0; i < MESH_ROUTING_ROUTE_LIFETIME - 1; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  mesh_routing_handler_time_out(&nodo);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+}
+
+/** @test En modo adaptativo la vida de un camino supera lo que abarca la rueda de tiempos; el
+ * camino se vuelve a ubicar en la rueda y vence en el paso que corresponde */
+void test_camino_con_vencimiento_lejano() {
+  uint8_t routes[] = {1, 9, 3, 2, 8, 1};
+  uint8_t next_hop, metric;
+  int pasos = 0;
+
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_set_trickle(&nodo, true);
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  while (mesh_routing_get_route(&nodo, 1, &next_hop, &metric) && pasos < 1000) {
+    mesh_routing_handler_time_out(&nodo);
+    pasos++;
+  }
+  TEST_ASSERT_GREATER_THAN(MESH_ROUTING_WHEEL_SLOTS * MESH_ROUTING_WHEEL_SLOTS - 1, pasos);
+  TEST_ASSERT_LESS_THAN(1000, pasos);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+}
+
+/** @test Al acortar la vida de los caminos, un camino que ya superaba la nueva vida vence
+ * exactamente MESH_ROUTING_ROUTE_LIFETIME pasos después del cambio y no una vuelta de la rueda
+ * más tarde */
+void test_camino_vence_al_acortar_la_vida() {
+  uint8_t routes[] = {1, 9, 3};
+  uint8_t next_hop, metric;
+
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_set_trickle(&nodo, true);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  for (int i = 0; i < 21; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+
+  mesh_routing_set_trickle(&nodo, false);
+  for (int i = 0; i < MESH_ROUTING_ROUTE_LIFETIME - 1; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  mesh_routing_handler_time_out(&nodo);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+}
+
+/** @test Durante los pasos que informa mesh_routing_idle_ticks() el handler no envía anuncios */
+void test_pasos_ociosos_no_envian_anuncios() {
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_EQUAL(0, mesh_routing_idle_ticks(&nodo)); // el próximo paso anuncia
+
+  mesh_conn_send_msg_StubWithCallback(aux_contar_anuncio);
+  mesh_routing_set_trickle(&nodo, true);
+  int ociosos = 0;
+  for (int i = 0; i < 20; i++) {
+    uint16_t idle = mesh_routing_idle_ticks(&nodo);
+    cantidad_fragmentos_enviados = 0;
+    for (uint16_t j = 0; j < idle; j++) {
+      mesh_routing_handler_time_out(&nodo);
+    }
+    TEST_ASSERT_EQUAL(0, cantidad_fragmentos_enviados);
+    ociosos = ociosos + idle;
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_GREATER_THAN(20, ociosos);
+}
+
+/** @test Función auxiliar que cuenta los msg de aplicación que se envían a todos los vecinos y
+ * guarda el número de secuencia del último */
+
+int broadcast_enviados;
+
+uint8_t seq_enviado;
+
+void aux_contar_broadcast(uint8_t id_mesh, uint8_t * msg, int num_calls) {
+  if (msg[OPCODE_TEST_MSG] == 78) {
+    TEST_ASSERT_EQUAL(BROADCAST_DIR_TEST, id_mesh);
+    TEST_ASSERT_EQUAL(BROADCAST_DIR_TEST, msg[NEXT_HOP_TEST_MSG]);
+    seq_enviado = msg[SEQ_TEST_MSG];
+    broadcast_enviados++;
+  }
+}
+
+/** @test Sin el modo inundación un broadcast propio se envía una vez a todos los vecinos sin
+ * numerarse, y uno recibido solo se entrega a la capa de aplicación */
+void test_broadcast_propio_sin_inundacion() {
+  uint8_t msg[MSG_TEST_MSG + 1];
+  broadcast_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_broadcast);
+
+  aux_generar_msg_de_aplicacion(msg, BROADCAST_DIR_TEST);
+  msg[SRC_TEST_MSG] = SRC_DIR_TEST;
+  msg[SEQ_TEST_MSG] = 0;
+  mesh_routing_send_msg(&nodo, msg);
+  TEST_ASSERT_EQUAL(1, broadcast_enviados);
+  TEST_ASSERT_EQUAL(0, seq_enviado);
+
+  aux_generar_msg_de_aplicacion(msg, BROADCAST_DIR_TEST);
+  mesh_app_process_msg_Expect(msg);
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_EQUAL(1, broadcast_enviados);
+}
+
+/** @test En modo inundación un broadcast propio se numera y se envía a todos los vecinos sin
+ * entregarse al propio nodo, y las copias que vuelven se descartan */
+void test_inundar_broadcast_propio() {
+  uint8_t msg[MSG_TEST_MSG + 1];
+  mesh_routing_set_flooding(&nodo, true);
+  broadcast_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_broadcast);
+
+  aux_generar_msg_de_aplicacion(msg, BROADCAST_DIR_TEST);
+  msg[SRC_TEST_MSG] = SRC_DIR_TEST;
+  msg[SEQ_TEST_MSG] = 0;
+  mesh_routing_send_msg(&nodo, msg);
+  TEST_ASSERT_EQUAL(1, broadcast_enviados);
+  TEST_ASSERT_EQUAL(1, msg[SEQ_TEST_MSG]);
+
+  mesh_routing_send_msg(&nodo, msg); // la copia que retransmite un vecino
+  TEST_ASSERT_EQUAL(1, broadcast_enviados);
+
+  msg[SEQ_TEST_MSG] = 0;
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+  TEST_ASSERT_EQUAL(2, broadcast_enviados);
+  TEST_ASSERT_EQUAL(2, msg[SEQ_TEST_MSG]);
+}
+
+/** @test En modo inundación un broadcast recibido se entrega a la capa de aplicación y se
+ * retransmite una sola vez, en alguno de los pasos siguientes del handler */
+void test_inundar_broadcast_recibido_una_sola_vez() {
+  struct mesh_routing_stats stats;
+  uint8_t msg[MSG_TEST_MSG + 1];
+  mesh_routing_set_flooding(&nodo, true);
+  aux_generar_msg_de_aplicacion(msg, BROADCAST_DIR_TEST);
+  msg[SEQ_TEST_MSG] = 7;
+
+  mesh_app_process_msg_Expect(msg);
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_routing_send_msg(&nodo, msg); // copia del mismo broadcast, no se vuelve a entregar
+
+  broadcast_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_broadcast);
+  for (int i = 0; i < MESH_ROUTING_FLOOD_JITTER + 4; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(1, broadcast_enviados);
+  TEST_ASSERT_EQUAL(7, seq_enviado);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_FLOOD_RELAYED]);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_FLOOD_DUPLICATES]);
+}
+
+/** @test En modo inundación no se retransmite un broadcast del que ya se escucharon suficientes
+ * copias mientras esperaba */
+void test_suprimir_retransmision_de_broadcast_escuchado() {
+  struct mesh_routing_stats stats;
+  uint8_t msg[MSG_TEST_MSG + 1];
+  mesh_routing_set_flooding(&nodo, true);
+  aux_generar_msg_de_aplicacion(msg, BROADCAST_DIR_TEST);
+  msg[SEQ_TEST_MSG] = 3;
+
+  mesh_app_process_msg_Expect(msg);
+  for (int i = 0; i <= MESH_ROUTING_FLOOD_SUPPRESS; i++) {
+    mesh_routing_send_msg(&nodo, msg);
+  }
+
+  broadcast_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_contar_broadcast);
+  for (int i = 0; i < MESH_ROUTING_FLOOD_JITTER + 4; i++) {
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(0, broadcast_enviados);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_FLOOD_SUPPRESSED]);
+}
+
+/** @test Una ruta que el vecino alcanza a través de este nodo se toma como perdida, así no se forma
+ * un lazo entre los dos */
+void test_ignorar_ruta_que_pasa_por_el_propio_nodo() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  msg_send[MSG_TEST_MSG + 4] = SRC_DIR_TEST; // el vecino ahora llega a 1 a través de este nodo
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+}
+
+/** @test Un anuncio con un número de secuencia más viejo que el conocido se descarta, aunque tenga
+ * mejor métrica; uno más nuevo reemplaza los caminos conocidos */
+void test_descartar_anuncio_con_secuencia_vieja() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  msg_send[MSG_TEST_MSG + 6] = 2;
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  uint8_t routes2[] = {1, 11, 1};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(9, next_hop);
+
+  uint8_t routes3[] = {1, 11, 5};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes3, sizeof(routes3));
+  msg_send[MSG_TEST_MSG + 6] = 4;
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(11, next_hop);
+  TEST_ASSERT_EQUAL(6, metric);
+}
+
+/** @test Al reenviar un msg se le descuenta un salto y si ya no le quedan saltos se descarta */
+void test_descartar_msg_sin_saltos_restantes() {
+  struct mesh_routing_stats stats;
+  uint8_t msg[MSG_TEST_MSG + 1];
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  aux_generar_msg_de_aplicacion(msg, 1);
+  msg[TTL_TEST_MSG] = 1;
+  mesh_conn_send_msg_Expect(9, msg);
+  mesh_routing_send_msg(&nodo, msg);
+  TEST_ASSERT_EQUAL(0, msg[TTL_TEST_MSG]);
+
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_FORWARDED]);
+  TEST_ASSERT_EQUAL(1, stats.counters[MESH_ROUTING_STAT_DROPPED_TTL]);
+}
+
+/** @test Con la métrica ETX cada ruta suma el costo del enlace con el vecino que la anuncia, que
+ * sin pérdidas es MESH_ROUTING_LINK_UNIT */
+void test_metrica_etx_suma_el_costo_del_enlace() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3};
+  mesh_routing_set_metric(&nodo, mesh_routing_metric_etx);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(9, next_hop);
+  TEST_ASSERT_EQUAL(3 + MESH_ROUTING_LINK_UNIT, metric);
+}
+
+/** @test Las pérdidas en el enlace con un vecino encarecen las rutas que pasan por él, pero solo
+ * cuando el costo cambia al menos MESH_ROUTING_LINK_HYSTERESIS */
+void test_enlace_con_perdidas_cambia_el_mejor_camino() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3, 1, 11, 4};
+  mesh_routing_set_metric(&nodo, mesh_routing_metric_etx);
+  aux_recibir_rutas(routes, sizeof(routes));
+
+  mesh_routing_link_tx(&nodo, 9, false);
+  mesh_routing_link_tx(&nodo, 9, false);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(9, next_hop);
+  TEST_ASSERT_EQUAL(3 + MESH_ROUTING_LINK_UNIT, metric);
+
+  mesh_routing_link_tx(&nodo, 9, false);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(11, next_hop);
+  TEST_ASSERT_EQUAL(4 + MESH_ROUTING_LINK_UNIT, metric);
+}
+
+/** @test Con la métrica por RSSI un enlace débil suma 1 cada MESH_ROUTING_RSSI_STEP dB por debajo
+ * de MESH_ROUTING_RSSI_GOOD; con la cantidad de saltos las muestras no cambian las rutas */
+void test_metrica_rssi() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3};
+  mesh_routing_link_rssi(&nodo, 9, MESH_ROUTING_RSSI_GOOD - 4 * MESH_ROUTING_RSSI_STEP);
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(4, metric);
+
+  mesh_routing_set_metric(&nodo, mesh_routing_metric_rssi);
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(3 + MESH_ROUTING_LINK_UNIT + 4, metric);
+}
+/** @test Memoria que hace de medio para la copia de la tabla de rutas. Solo se pueden leer los
+ * bytes escritos, para simular una copia truncada */
+
+uint8_t copia[MESH_ROUTING_SNAPSHOT_MAX_SIZE(MAX_NEIGHBOR)];
+
+uint16_t largo_copia;
+
+int aux_escribir_copia(void * user, uint16_t offset, const uint8_t * data, uint16_t len) {
+  if (offset + len > sizeof(copia)) {
+    return -1;
+  }
+  memcpy(&copia[offset], data, len);
+  if (offset + len > largo_copia) {
+    largo_copia = offset + len;
+  }
+  return 0;
+}
+
+int aux_leer_copia(void * user, uint16_t offset, uint8_t * data, uint16_t len) {
+  if (offset + len > largo_copia) {
+    return -1;
+  }
+  memcpy(data, &copia[offset], len);
+  return 0;
+}
+
+const struct mesh_routing_storage medio_copia = {.write = aux_escribir_copia,
+                                                 .read = aux_leer_copia};
+
+/** @test Medio que cambia un byte de la copia la segunda vez que se lee el encabezado, como si
+ * otro proceso la reescribiera entre las dos pasadas de la restauración */
+
+int lecturas_del_encabezado;
+
+int aux_leer_copia_que_cambia(void * user, uint16_t offset, uint8_t * data, uint16_t len) {
+  if (offset == 0 && ++lecturas_del_encabezado == 2) {
+    copia[10] ^= 0x01; // métrica del primer camino
+  }
+  return aux_leer_copia(user, offset, data, len);
+}
+
+const struct mesh_routing_storage medio_que_cambia = {.write = aux_escribir_copia,
+                                                      .read = aux_leer_copia_que_cambia};
+
+/** @test Medio que registra si se escribe con el lock de la tabla tomado */
+
+bool lock_tomado;
+
+int escrituras_con_lock;
+
+void aux_tomar_lock(int num_calls) {
+  lock_tomado = true;
+}
+
+void aux_liberar_lock(int num_calls) {
+  lock_tomado = false;
+}
+
+int aux_escribir_copia_sin_lock(void * user, uint16_t offset, const uint8_t * data, uint16_t len) {
+  if (lock_tomado == true) {
+    escrituras_con_lock++;
+  }
+  return aux_escribir_copia(user, offset, data, len);
+}
+
+const struct mesh_routing_storage medio_sin_lock = {.write = aux_escribir_copia_sin_lock,
+                                                    .read = aux_leer_copia};
+
+/** @test Función auxiliar que guarda la tabla de rutas y reinicia el nodo con la tabla vacía */
+
+void aux_guardar_y_reiniciar() {
+  largo_copia = 0;
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_save(&nodo, &medio_copia));
+  mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
+}
+
+/** @test Luego de restaurar la copia de la tabla el nodo reenvía por las rutas guardadas sin
+ * esperar ningún anuncio; las rutas perdidas no se guardan */
+void test_restaurar_copia_permite_reenviar() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3, 2, 9, 2, 1, 11, 5};
+  uint8_t perdida[] = {2, 9, 0xFF};
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_generar_msg_para_agregar_tablas_de_ruta(perdida, sizeof(perdida));
+  mesh_routing_send_msg(&nodo, msg_send);
+
+  aux_guardar_y_reiniciar();
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(9, next_hop);
+  TEST_ASSERT_EQUAL(4, metric);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+
+  uint8_t routes2[] = {1, 9, 0xFF};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(11, next_hop); // el segundo camino también se guardó
+  TEST_ASSERT_EQUAL(6, metric);
+}
+
+/** @test Una ruta restaurada no se anuncia hasta que un vecino la vuelve a anunciar */
+void test_ruta_restaurada_se_anuncia_al_confirmarse() {
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2};
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_guardar_y_reiniciar();
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  mesh_routing_handler_time_out(&nodo); // anuncio completo
+  TEST_ASSERT_EQUAL(-1, aux_metrica_anunciada(1));
+  TEST_ASSERT_EQUAL(-1, aux_metrica_anunciada(2));
+
+  uint8_t routes2[] = {1, 9, 2};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes2, sizeof(routes2));
+  mesh_routing_send_msg(&nodo, msg_send);
+  cantidad_fragmentos_enviados = 0;
+  mesh_routing_handler_time_out(&nodo);
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_EQUAL(3, aux_metrica_anunciada(1));
+  TEST_ASSERT_EQUAL(-1, aux_metrica_anunciada(2));
+}
+
+/** @test Una ruta restaurada que ningún vecino confirma se elimina sin anunciarse como perdida:
+ * cuando vencen sus caminos si el vecino no anuncia, o luego de MESH_ROUTING_FULL_SYNC_PERIOD vidas
+ * de camino si el vecino sigue anunciando sin incluirla */
+void test_ruta_restaurada_sin_confirmar_se_elimina_sin_anunciarse() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3, 2, 11, 3};
+  struct mesh_routing_stats stats;
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_guardar_y_reiniciar();
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+
+  cantidad_fragmentos_enviados = 0;
+  mesh_conn_send_msg_StubWithCallback(aux_guardar_fragmento_enviado);
+  for (int i = 0; i < MESH_ROUTING_ROUTE_LIFETIME; i++) {
+    aux_generar_msg_para_agregar_tablas_de_ruta(routes, 0);
+    msg_send[SRC_TEST_MSG] = 9;
+    mesh_routing_send_msg(&nodo, msg_send);
+    mesh_routing_handler_time_out(&nodo);
+  }
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+
+  for (int i = MESH_ROUTING_ROUTE_LIFETIME;
+       i < MESH_ROUTING_ROUTE_LIFETIME * (MESH_ROUTING_FULL_SYNC_PERIOD + 1); i++) {
+    aux_generar_msg_para_agregar_tablas_de_ruta(routes, 0);
+    msg_send[SRC_TEST_MSG] = 9;
+    mesh_routing_send_msg(&nodo, msg_send);
+    mesh_routing_handler_time_out(&nodo);
+  }
+  mesh_conn_send_msg_StubWithCallback(NULL);
+
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_EQUAL(-1, aux_metrica_anunciada(1));
+  TEST_ASSERT_EQUAL(-1, aux_metrica_anunciada(2));
+  mesh_routing_get_stats(&nodo, &stats);
+  TEST_ASSERT_EQUAL(2, stats.counters[MESH_ROUTING_STAT_ROUTES_EXPIRED]);
+}
+
+/** @test Una copia dañada, truncada, de otra versión o de otro nodo no se restaura y la tabla queda
+ * vacía */
+void test_copia_invalida_no_se_restaura() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2};
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_guardar_y_reiniciar();
+
+  copia[8] ^= 0x01; // un bit de la primera ruta
+  TEST_ASSERT_EQUAL(-1, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+  copia[8] ^= 0x01;
+
+  copia[2]++; // versión
+  TEST_ASSERT_EQUAL(-1, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+  copia[2]--;
+
+  largo_copia--;
+  TEST_ASSERT_EQUAL(-1, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+  largo_copia++;
+
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+
+  mesh_routing_init(&nodo, SRC_DIR_TEST + 1, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
+  TEST_ASSERT_EQUAL(-1, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+
+  mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+  TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+}
+/** @test Si la copia cambia entre la validación y la carga no se restaura y la tabla queda vacía */
+void test_copia_que_cambia_durante_la_restauracion() {
+  uint8_t next_hop, metric;
+  uint8_t routes[] = {1, 9, 3, 2, 8, 2};
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_guardar_y_reiniciar();
+
+  lecturas_del_encabezado = 0;
+  TEST_ASSERT_EQUAL(-1, mesh_routing_snapshot_restore(&nodo, &medio_que_cambia));
+  TEST_ASSERT_EQUAL(2, lecturas_del_encabezado);
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 1, &next_hop, &metric));
+  TEST_ASSERT_FALSE(mesh_routing_get_route(&nodo, 2, &next_hop, &metric));
+}
+
+/** @test La copia se escribe en el medio con el lock de la tabla liberado, aunque las rutas no
+ * entren en un solo bloque */
+void test_guardar_copia_sin_el_lock_tomado() {
+  uint8_t next_hop, metric;
+  uint8_t routes[(MAX_NEIGHBOR - 1) * 3];
+  for (uint8_t i = 0; i < MAX_NEIGHBOR - 1; i++) {
+    routes[i * 3] = 30 + i;
+    routes[i * 3 + 1] = 9;
+    routes[i * 3 + 2] = i;
+  }
+  aux_agregar_rutas_en_fragmentos(routes, sizeof(routes));
+
+  lock_tomado = false;
+  escrituras_con_lock = 0;
+  largo_copia = 0;
+  mesh_port_routing_lock_StubWithCallback(aux_tomar_lock);
+  mesh_port_routing_unlock_StubWithCallback(aux_liberar_lock);
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_save(&nodo, &medio_sin_lock));
+  TEST_ASSERT_EQUAL(0, escrituras_con_lock);
+
+  mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
+  TEST_ASSERT_EQUAL(0, mesh_routing_snapshot_restore(&nodo, &medio_copia));
+  for (uint8_t i = 0; i < MAX_NEIGHBOR - 1; i++) {
+    TEST_ASSERT_TRUE(mesh_routing_get_route(&nodo, 30 + i, &next_hop, &metric));
+  }
+}
+
+/** @test Función auxiliar que verifica un evento de un volcado del registro de trazas */
+
+void aux_verificar_evento(uint8_t * volcado, int i, uint8_t type, uint8_t dst, uint8_t next_hop,
+                          uint8_t metric, uint8_t extra) {
+  uint8_t * evento = &volcado[MESH_ROUTING_TRACE_HEADER_SIZE + i * MESH_ROUTING_TRACE_EVENT_SIZE];
+  TEST_ASSERT_EQUAL(type, evento[2]);
+  TEST_ASSERT_EQUAL(dst, evento[3]);
+  TEST_ASSERT_EQUAL(next_hop, evento[4]);
+  TEST_ASSERT_EQUAL(metric, evento[5]);
+  TEST_ASSERT_EQUAL(extra, evento[6]);
+}
+
+/** @test El registro de trazas guarda el alta de una ruta, el cambio de su mejor camino y su
+ * pérdida, con el número de secuencia del destino */
+void test_trazas_de_cambios_de_rutas() {
+  uint8_t volcado[MESH_ROUTING_TRACE_DUMP_SIZE];
+  uint8_t routes[] = {1, 9, 3, 1, 11, 5};
+  uint8_t perdida[] = {1, 9, 0xFF, 1, 11, 0xFF};
+  mesh_routing_set_trace(&nodo, true);
+  aux_recibir_rutas(routes, sizeof(routes));
+  aux_recibir_rutas(perdida, sizeof(perdida));
+
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_HEADER_SIZE + 3 * MESH_ROUTING_TRACE_EVENT_SIZE,
+                    mesh_routing_trace_dump(&nodo, volcado, sizeof(volcado)));
+  uint8_t encabezado[] = {'M', 'T', 1, SRC_DIR_TEST, 0, 3, 0, 0};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(encabezado, volcado, sizeof(encabezado));
+  aux_verificar_evento(volcado, 0, MESH_ROUTING_TRACE_ROUTE_ADD, 1, 9, 4, 0);
+  aux_verificar_evento(volcado, 1, MESH_ROUTING_TRACE_PATH_SWAP, 1, 11, 6, 0);
+  aux_verificar_evento(volcado, 2, MESH_ROUTING_TRACE_ROUTE_EXPIRE, 1, 0, 0, 1);
+}
+
+/** @test El registro de trazas guarda los msg reenviados y descartados, con su origen, y los
+ * fragmentos de anuncio enviados, con el paso del handler en que ocurrió cada evento */
+void test_trazas_de_msg_y_anuncios() {
+  uint8_t volcado[MESH_ROUTING_TRACE_DUMP_SIZE];
+  uint8_t msg[MSG_TEST_MSG + 1];
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  mesh_routing_set_trace(&nodo, true);
+
+  aux_generar_msg_de_aplicacion(msg, 1);
+  mesh_conn_send_msg_Expect(9, msg);
+  mesh_routing_send_msg(&nodo, msg);
+  aux_generar_msg_de_aplicacion(msg, 50);
+  mesh_routing_send_msg(&nodo, msg);
+  aux_generar_msg_de_aplicacion(msg, 1);
+  msg[TTL_TEST_MSG] = 0;
+  mesh_routing_send_msg(&nodo, msg);
+  mesh_conn_send_msg_Ignore();
+  mesh_routing_handler_time_out(&nodo);
+
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_HEADER_SIZE + 4 * MESH_ROUTING_TRACE_EVENT_SIZE,
+                    mesh_routing_trace_dump(&nodo, volcado, sizeof(volcado)));
+  aux_verificar_evento(volcado, 0, MESH_ROUTING_TRACE_FORWARD, 1, 9, 4, 4);
+  aux_verificar_evento(volcado, 1, MESH_ROUTING_TRACE_DROP_UNREACHABLE, 50, 0, 0, 4);
+  aux_verificar_evento(volcado, 2, MESH_ROUTING_TRACE_DROP_TTL, 1, 0, 0, 4);
+  uint8_t * anuncio = &volcado[MESH_ROUTING_TRACE_HEADER_SIZE + 3 * MESH_ROUTING_TRACE_EVENT_SIZE];
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_ADV_SENT, anuncio[2]);
+  TEST_ASSERT_EQUAL(0, anuncio[6]); // primer fragmento
+  TEST_ASSERT_EQUAL(0, volcado[MESH_ROUTING_TRACE_HEADER_SIZE + 1]); // antes del primer paso
+  TEST_ASSERT_EQUAL(1, anuncio[1]);
+}
+
+/** @test El registro de trazas empieza desactivado. Activo, cuando se llena cada evento reemplaza
+ * al más antiguo y el volcado informa cuántos eventos ya no están; si el buffer del volcado es
+ * chico se vuelcan los más nuevos */
+void test_trazas_buffer_circular() {
+  uint8_t volcado[MESH_ROUTING_TRACE_DUMP_SIZE];
+  uint8_t msg[MSG_TEST_MSG + 1];
+  uint8_t routes[] = {1, 9, 3};
+  aux_generar_msg_para_agregar_tablas_de_ruta(routes, sizeof(routes));
+  mesh_routing_send_msg(&nodo, msg_send);
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_HEADER_SIZE,
+                    mesh_routing_trace_dump(&nodo, volcado, sizeof(volcado)));
+
+  mesh_routing_set_trace(&nodo, true);
+  mesh_conn_send_msg_Ignore();
+  for (int i = 0; i < MESH_ROUTING_TRACE_SIZE + 5; i++) {
+    aux_generar_msg_de_aplicacion(msg, 1);
+    msg[SRC_TEST_MSG] = i;
+    mesh_routing_send_msg(&nodo, msg);
+  }
+
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_DUMP_SIZE,
+                    mesh_routing_trace_dump(&nodo, volcado, sizeof(volcado)));
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_SIZE, volcado[4] << 8 | volcado[5]);
+  TEST_ASSERT_EQUAL(5, volcado[6] << 8 | volcado[7]);
+  aux_verificar_evento(volcado, 0, MESH_ROUTING_TRACE_FORWARD, 1, 9, 4, 5);
+
+  uint16_t largo = MESH_ROUTING_TRACE_HEADER_SIZE + 2 * MESH_ROUTING_TRACE_EVENT_SIZE + 3;
+  TEST_ASSERT_EQUAL(largo - 3, mesh_routing_trace_dump(&nodo, volcado, largo));
+  TEST_ASSERT_EQUAL(2, volcado[4] << 8 | volcado[5]);
+  TEST_ASSERT_EQUAL(MESH_ROUTING_TRACE_SIZE + 3, volcado[6] << 8 | volcado[7]);
+  aux_verificar_evento(volcado, 1, MESH_ROUTING_TRACE_FORWARD, 1, 9, 4,
+                       MESH_ROUTING_TRACE_SIZE + 4);
 }
 /* === End of documentation
  * ==================================================================== */
@@ -0,0 +1,230 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file
+ ** @brief Test de mesh_routing.c con varios hilos leyendo la tabla de rutas mientras otro la
+ ** modifica
+ */
+
+/* === Headers files inclusions
+ * =============================================================== */
+
+#include "unity.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "Mockmesh_app.h"
+#include "Mockmesh_conn.h"
+#include "Mockmesh_port.h"
+
+#include "Mockmesh.h"
+#include "mesh_msg.h"
+#include "mesh_routing.h"
+
+/* === Macros definitions
+ * ====================================================================== */
+#define SRC_TEST_MSG       0
+#define DST_TEST_MSG       1
+#define NEXT_HOP_TEST_MSG  2
+#define OPCODE_TEST_MSG    3
+#define LENGHT_TEST_MSG    4
+#define MSG_TEST_MSG       7
+
+#define SRC_DIR_TEST       10
+
+#define MAX_SIZE_MSG_TEST  20
+
+#define ESCRITURAS_TEST    20000
+#define LECTORES_TEST      3
+#define RUTEADORES_TEST    3
+
+/* === Private data type declarations
+ * ========================================================== */
+
+/* === Private variable declarations
+ * =========================================================== */
+
+/* === Private function declarations
+ * =========================================================== */
+
+/* === Public variable definitions
+ * ============================================================= */
+
+/* === Private variable definitions
+ * ============================================================ */
+
+struct mesh_routing_ctx nodo;
+
+uint32_t arena[MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR) / sizeof(uint32_t) + 1];
+
+uint8_t anuncio_a[MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+
+uint8_t anuncio_b[MSG_TEST_MSG + MAX_SIZE_MSG_TEST];
+
+atomic_bool escritura_terminada;
+
+atomic_int lecturas;
+
+atomic_int lecturas_inconsistentes;
+
+uint8_t volcado[MESH_ROUTING_TRACE_DUMP_SIZE];
+
+/* === Private function implementation
+ * ========================================================= */
+
+void setUp() {
+  mesh_port_routing_lock_Ignore();
+  mesh_port_routing_unlock_Ignore();
+  mesh_port_cycles_IgnoreAndReturn(0);
+  mesh_routing_init(&nodo, SRC_DIR_TEST, MAX_NEIGHBOR, arena,
+                    MESH_ROUTING_ARENA_SIZE(MAX_NEIGHBOR));
+}
+
+/** @test Función auxiliar para generar el anuncio de un vecino con dos rutas hacia el destino 1 en
+ * formato plano. Las rutas son {destino, próximo salto del vecino, métrica, número de secuencia} */
+
+void aux_generar_anuncio(uint8_t * msg, uint8_t vecino, uint8_t metrica_1, uint8_t metrica_2) {
+  uint8_t rutas[] = {1, 1, metrica_1, 0, 1, 1, metrica_2, 0};
+
+  msg[SRC_TEST_MSG] = vecino;
+  msg[DST_TEST_MSG] = 4;
+  msg[OPCODE_TEST_MSG] = 21; // opcode send neighbor
+  msg[LENGHT_TEST_MSG] = sizeof(rutas) + 3;
+  msg[MSG_TEST_MSG] = 1;     // formato plano
+  msg[MSG_TEST_MSG + 1] = 0; // número de fragmento
+  msg[MSG_TEST_MSG + 2] = 1; // cantidad de fragmentos
+  for (size_t i = 0; i < sizeof(rutas); i++) {
+    msg[MSG_TEST_MSG + 3 + i] = rutas[i];
+  }
+}
+
+/** @test Hilo que alterna entre dos anuncios del vecino 9. Luego del anuncio A el mejor camino es 9
+ * con métrica 4 y luego del anuncio B es 9 con métrica 2. Mientras se procesa cada anuncio el mejor
+ * camino pasa un instante por 11 con métrica 6. */
+
+void * aux_hilo_escritor(void * arg) {
+  for (int i = 0; i < ESCRITURAS_TEST; i++) {
+    mesh_routing_send_msg(&nodo, i % 2 == 0 ? anuncio_a : anuncio_b);
+  }
+  atomic_store(&escritura_terminada, true);
+  return NULL;
+}
+
+/** @test Hilo que lee la ruta hacia el destino 1 y cuenta las lecturas que no corresponden a
+ * ninguno de los dos estados estables de la tabla */
+
+void * aux_hilo_lector(void * arg) {
+  uint8_t next_hop, metric;
+
+  while (atomic_load(&escritura_terminada) == false) {
+    mesh_routing_get_route(&nodo, 1, &next_hop, &metric);
+    if (!((next_hop == 9 && metric == 4) || (next_hop == 9 && metric == 2))) {
+      atomic_fetch_add(&lecturas_inconsistentes, 1);
+    }
+    atomic_fetch_add(&lecturas, 1);
+  }
+  return NULL;
+}
+
+/** @test Hilo que rutea msg hacia un destino sin ruta, lo que registra un evento de descarte por
+ * msg. Cada hilo usa su propio origen y el destino es siempre el origen más 50 */
+
+void * aux_hilo_ruteador(void * arg) {
+  uint8_t origen = (uint8_t)(uintptr_t)arg;
+  uint8_t msg[MSG_TEST_MSG + MAX_SIZE_MSG_TEST] = {origen, origen + 50, SRC_DIR_TEST, 78, 0, 0, 8};
+
+  while (atomic_load(&escritura_terminada) == false) {
+    msg[6] = 8; // TTL
+    mesh_routing_send_msg(&nodo, msg);
+  }
+  return NULL;
+}
+
+/* === Public function implementation
+ * ========================================================== */
+
+/** @test Varios hilos consultan la tabla de rutas mientras otro la modifica y nunca leen un
+ * próximo salto y una métrica de estados distintos de la tabla, ni un estado intermedio de un
+ * anuncio */
+void test_lectura_sin_lock_mientras_se_modifica_la_tabla() {
+  pthread_t escritor, lectores[LECTORES_TEST];
+
+  aux_generar_anuncio(anuncio_a, 11, 5, 5); // camino estable por 11
+  mesh_routing_send_msg(&nodo, anuncio_a);
+  aux_generar_anuncio(anuncio_a, 9, 8, 3);
+  aux_generar_anuncio(anuncio_b, 9, 8, 1);
+  mesh_routing_send_msg(&nodo, anuncio_a);
+
+  atomic_store(&escritura_terminada, false);
+  atomic_store(&lecturas, 0);
+  atomic_store(&lecturas_inconsistentes, 0);
+
+  for (int i = 0; i < LECTORES_TEST; i++) {
+    pthread_create(&lectores[i], NULL, aux_hilo_lector, NULL);
+  }
+  pthread_create(&escritor, NULL, aux_hilo_escritor, NULL);
+
+  pthread_join(escritor, NULL);
+  for (int i = 0; i < LECTORES_TEST; i++) {
+    pthread_join(lectores[i], NULL);
+  }
+
+  TEST_ASSERT_GREATER_THAN(0, atomic_load(&lecturas));
+  TEST_ASSERT_EQUAL(0, atomic_load(&lecturas_inconsistentes));
+}
+
+/** @test Varios hilos registran eventos mientras otro vuelca el registro de trazas, y el volcado
+ * nunca entrega un evento con campos de dos eventos distintos */
+void test_volcado_de_trazas_mientras_se_registran_eventos() {
+  pthread_t ruteadores[RUTEADORES_TEST];
+
+  mesh_routing_set_trace(&nodo, true);
+  atomic_store(&escritura_terminada, false);
+  for (int i = 0; i < RUTEADORES_TEST; i++) {
+    pthread_create(&ruteadores[i], NULL, aux_hilo_ruteador, (void *)(uintptr_t)(100 + i));
+  }
+
+  int eventos = 0, inconsistentes = 0;
+  while (eventos < ESCRITURAS_TEST) {
+    mesh_routing_trace_dump(&nodo, volcado, sizeof(volcado));
+    int cantidad = volcado[4] << 8 | volcado[5];
+    uint8_t * evento = &volcado[MESH_ROUTING_TRACE_HEADER_SIZE];
+    for (int i = 0; i < cantidad; i++, evento = evento + MESH_ROUTING_TRACE_EVENT_SIZE) {
+      if (evento[2] != MESH_ROUTING_TRACE_DROP_UNREACHABLE || evento[3] != evento[6] + 50 ||
+          evento[6] < 100 || evento[6] >= 100 + RUTEADORES_TEST) {
+        inconsistentes++;
+      }
+      eventos++;
+    }
+  }
+  atomic_store(&escritura_terminada, true);
+  for (int i = 0; i < RUTEADORES_TEST; i++) {
+    pthread_join(ruteadores[i], NULL);
+  }
+
+  TEST_ASSERT_EQUAL(0, inconsistentes);
+}
+
+/* === End of documentation
+ * ==================================================================== */
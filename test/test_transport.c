@@ -0,0 +1,293 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file
+ ** @brief Test de mesh_transport.c
+ */
+
+/* === Headers files inclusions
+ * =============================================================== */
+
+#include "unity.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "Mockmesh_app.h"
+#include "Mockmesh_port.h"
+#include "Mockmesh_routing.h"
+
+#include "mesh.h"
+#include "mesh_msg.h"
+#include "mesh_transport.h"
+
+/* === Macros definitions
+ * ====================================================================== */
+#define OPCODE_TEST_MSG    3
+#define LENGHT_TEST_MSG    4
+#define MSG_TEST_MSG       7
+
+#define DATOS_FRAGMENTO    17 // MAX_SIZE_MSG menos el encabezado de transporte
+#define MAX_ENVIADOS       16
+
+/* === Private data type declarations
+ * ========================================================== */
+
+/* === Private variable declarations
+ * =========================================================== */
+
+/* === Private function declarations
+ * =========================================================== */
+
+/* === Public variable definitions
+ * ============================================================= */
+
+/* === Private variable definitions
+ * ============================================================ */
+
+struct mesh_routing_ctx nodo;
+
+uint8_t enviados[MAX_ENVIADOS][MSG_TEST_MSG + MAX_SIZE_MSG];
+
+int cantidad_enviados, llamadas_a_routing;
+
+uint8_t entregado[MSG_TEST_MSG + MESH_TRANSPORT_MAX_PAYLOAD];
+
+uint8_t * buffer_entregado;
+
+int entregas;
+
+uint8_t datos[MESH_TRANSPORT_MAX_PAYLOAD];
+
+/* === Private function implementation
+ * ========================================================= */
+
+/** @test Guarda una copia de los msg que se entregan a routing, que los libera al volver */
+void aux_capturar_envio(struct mesh_routing_ctx * ctx, uint8_t ** msgs, uint16_t count,
+                        int num_calls) {
+  TEST_ASSERT_EQUAL_PTR(&nodo, ctx);
+  llamadas_a_routing++;
+  for (uint16_t i = 0; i < count && cantidad_enviados < MAX_ENVIADOS; i++) {
+    memcpy(enviados[cantidad_enviados++], msgs[i], MSG_TEST_MSG + MAX_SIZE_MSG);
+  }
+}
+
+/** @test Guarda el datagrama que se entrega a la aplicación */
+void aux_capturar_entrega(uint8_t * data, int num_calls) {
+  entregas++;
+  buffer_entregado = data;
+  memcpy(entregado, data, MSG_TEST_MSG + data[LENGHT_TEST_MSG]);
+}
+
+void setUp() {
+  mesh_port_transport_lock_Ignore();
+  mesh_port_transport_unlock_Ignore();
+  mesh_routing_get_id_IgnoreAndReturn(SRC_DIR);
+  mesh_routing_send_msgs_StubWithCallback(aux_capturar_envio);
+  mesh_app_process_msg_StubWithCallback(aux_capturar_entrega);
+  mesh_msg_init();
+  mesh_transport_init(&nodo);
+  cantidad_enviados = 0;
+  llamadas_a_routing = 0;
+  entregas = 0;
+  buffer_entregado = NULL;
+  for (int i = 0; i < MESH_TRANSPORT_MAX_PAYLOAD; i++) {
+    datos[i] = i + 1;
+  }
+}
+
+/* === Public function implementation
+ * ========================================================== */
+
+/** @test Los datos que entran en un msg salen como un msg de aplicación común */
+void test_enviar_datos_que_entran_en_un_msg() {
+  TEST_ASSERT_EQUAL(0, mesh_transport_send(7, 40, datos, MAX_SIZE_MSG));
+
+  TEST_ASSERT_EQUAL(1, cantidad_enviados);
+  TEST_ASSERT_EQUAL(SRC_DIR, enviados[0][SRC]);
+  TEST_ASSERT_EQUAL(7, enviados[0][DST]);
+  TEST_ASSERT_EQUAL(40, enviados[0][OPCODE_TEST_MSG]);
+  TEST_ASSERT_EQUAL(MAX_SIZE_MSG, enviados[0][LENGHT_TEST_MSG]);
+  TEST_ASSERT_EQUAL(MESH_ROUTING_DEFAULT_TTL, enviados[0][TTL]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(datos, &enviados[0][MSG_TEST_MSG], MAX_SIZE_MSG);
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+}
+
+/** @test Los datos largos se parten en fragmentos con el opcode de aplicación, el id del
+ * datagrama y el índice de cada fragmento, que se entregan juntos a routing */
+void test_fragmentar_datos_largos() {
+  TEST_ASSERT_EQUAL(0, mesh_transport_send(7, 40, datos, 40));
+
+  TEST_ASSERT_EQUAL(1, llamadas_a_routing);
+  TEST_ASSERT_EQUAL(3, cantidad_enviados);
+  for (int i = 0; i < 3; i++) {
+    uint8_t largo = i < 2 ? DATOS_FRAGMENTO : 40 - 2 * DATOS_FRAGMENTO;
+    TEST_ASSERT_EQUAL(SRC_DIR, enviados[i][SRC]);
+    TEST_ASSERT_EQUAL(7, enviados[i][DST]);
+    TEST_ASSERT_EQUAL(OPCODE_TRANSPORT, enviados[i][OPCODE_TEST_MSG]);
+    TEST_ASSERT_EQUAL(3 + largo, enviados[i][LENGHT_TEST_MSG]);
+    TEST_ASSERT_EQUAL(40, enviados[i][MSG_TEST_MSG]);
+    TEST_ASSERT_EQUAL(0, enviados[i][MSG_TEST_MSG + 1]);
+    TEST_ASSERT_EQUAL(i << 4 | 2, enviados[i][MSG_TEST_MSG + 2]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&datos[i * DATOS_FRAGMENTO], &enviados[i][MSG_TEST_MSG + 3],
+                                  largo);
+  }
+  TEST_ASSERT_EQUAL(MESH_MSG_POOL_SIZE, mesh_msg_available());
+
+  // el siguiente datagrama tiene otro id y se entrega a routing de a MESH_TRANSPORT_BATCH
+  cantidad_enviados = 0;
+  llamadas_a_routing = 0;
+  TEST_ASSERT_EQUAL(0, mesh_transport_send(7, 40, datos, 6 * DATOS_FRAGMENTO));
+  TEST_ASSERT_EQUAL(6, cantidad_enviados);
+  TEST_ASSERT_EQUAL((6 + MESH_TRANSPORT_BATCH - 1) / MESH_TRANSPORT_BATCH, llamadas_a_routing);
+  TEST_ASSERT_EQUAL(1, enviados[5][MSG_TEST_MSG + 1]);
+  TEST_ASSERT_EQUAL(5 << 4 | 5, enviados[5][MSG_TEST_MSG + 2]);
+}
+
+/** @test No se envían datos con un opcode que no es de aplicación, más largos que el máximo o si
+ * el pool de msg está agotado */
+void test_envios_invalidos() {
+  TEST_ASSERT_EQUAL(-1, mesh_transport_send(7, OPCODE_ROUTING_MAX, datos, 4));
+  TEST_ASSERT_EQUAL(-1, mesh_transport_send(7, 40, datos, MESH_TRANSPORT_MAX_PAYLOAD + 1));
+
+  while (mesh_msg_alloc() != NULL) {
+  }
+  TEST_ASSERT_EQUAL(-1, mesh_transport_send(7, 40, datos, 4));
+  TEST_ASSERT_EQUAL(-1, mesh_transport_send(7, 40, datos, 40));
+  TEST_ASSERT_EQUAL(0, llamadas_a_routing);
+}
+
+/** @test Los fragmentos se rearman aunque lleguen desordenados y el datagrama se entrega una sola
+ * vez con el opcode de aplicación y el largo total */
+void test_rearmar_datagrama() {
+  mesh_transport_send(SRC_DIR, 40, datos, 40);
+
+  mesh_transport_process_msg(enviados[2]);
+  mesh_transport_process_msg(enviados[0]);
+  TEST_ASSERT_EQUAL(0, entregas);
+  TEST_ASSERT_EQUAL(1, mesh_transport_pending());
+  mesh_transport_process_msg(enviados[1]);
+
+  TEST_ASSERT_EQUAL(1, entregas);
+  TEST_ASSERT_EQUAL(SRC_DIR, entregado[SRC]);
+  TEST_ASSERT_EQUAL(SRC_DIR, entregado[DST]);
+  TEST_ASSERT_EQUAL(40, entregado[OPCODE_TEST_MSG]);
+  TEST_ASSERT_EQUAL(40, entregado[LENGHT_TEST_MSG]);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(datos, &entregado[MSG_TEST_MSG], 40);
+  TEST_ASSERT_EQUAL(0, mesh_transport_pending());
+}
+
+/** @test Los fragmentos repetidos, también los que llegan después de entregar el datagrama, no
+ * vuelven a entregarlo */
+void test_fragmentos_repetidos() {
+  mesh_transport_send(SRC_DIR, 40, datos, 40);
+
+  mesh_transport_process_msg(enviados[0]);
+  mesh_transport_process_msg(enviados[0]);
+  mesh_transport_process_msg(enviados[1]);
+  mesh_transport_process_msg(enviados[2]);
+  mesh_transport_process_msg(enviados[1]);
+  for (int i = 0; i < 3; i++) {
+    mesh_transport_process_msg(enviados[i]);
+  }
+
+  TEST_ASSERT_EQUAL(1, entregas);
+  TEST_ASSERT_EQUAL(0, mesh_transport_pending());
+}
+
+/** @test Un fragmento retransmitido que llega después de entregarse otros datagramas se sigue
+ * descartando y no ocupa un buffer de rearmado */
+void test_fragmento_repetido_despues_de_otras_entregas() {
+  uint8_t primero[MSG_TEST_MSG + MAX_SIZE_MSG];
+
+  mesh_transport_send(SRC_DIR, 40, datos, 40);
+  memcpy(primero, enviados[0], sizeof(primero));
+  for (int i = 0; i < 3; i++) {
+    mesh_transport_process_msg(enviados[i]);
+  }
+
+  for (int d = 0; d < MESH_TRANSPORT_REASSEMBLY_SLOTS + 1; d++) {
+    cantidad_enviados = 0;
+    mesh_transport_send(SRC_DIR, 40, datos, 40);
+    for (int i = 0; i < 3; i++) {
+      mesh_transport_process_msg(enviados[i]);
+    }
+  }
+  TEST_ASSERT_EQUAL(MESH_TRANSPORT_REASSEMBLY_SLOTS + 2, entregas);
+
+  mesh_transport_process_msg(primero);
+  TEST_ASSERT_EQUAL(0, mesh_transport_pending());
+}
+
+/** @test Un datagrama que no termina de llegar se descarta por time out y libera su buffer */
+void test_descartar_datagrama_incompleto() {
+  mesh_transport_send(SRC_DIR, 40, datos, 40);
+
+  mesh_transport_process_msg(enviados[0]);
+  for (int i = 0; i < MESH_TRANSPORT_TIMEOUT - 1; i++) {
+    mesh_transport_handler_time_out();
+  }
+  TEST_ASSERT_EQUAL(1, mesh_transport_pending());
+  mesh_transport_handler_time_out();
+  TEST_ASSERT_EQUAL(0, mesh_transport_pending());
+
+  mesh_transport_process_msg(enviados[1]);
+  mesh_transport_process_msg(enviados[2]);
+  TEST_ASSERT_EQUAL(0, entregas);
+}
+
+/** @test Si todos los buffers de rearmado están ocupados los fragmentos de otros datagramas se
+ * descartan */
+void test_sin_buffers_de_rearmado() {
+  mesh_transport_send(SRC_DIR, 40, datos, 40);
+
+  for (int i = 0; i < MESH_TRANSPORT_REASSEMBLY_SLOTS; i++) {
+    enviados[0][SRC] = SRC_DIR + i + 1;
+    mesh_transport_process_msg(enviados[0]);
+  }
+  TEST_ASSERT_EQUAL(MESH_TRANSPORT_REASSEMBLY_SLOTS, mesh_transport_pending());
+
+  for (int i = 0; i < 3; i++) {
+    mesh_transport_process_msg(enviados[i]);
+  }
+  TEST_ASSERT_EQUAL(0, entregas);
+}
+
+/** @test Se descartan los fragmentos con un índice fuera de rango, un opcode que no es de
+ * aplicación o datos incompletos antes del último fragmento */
+void test_descartar_fragmentos_invalidos() {
+  uint8_t fragmento[MSG_TEST_MSG + MAX_SIZE_MSG] = {9, SRC_DIR, SRC_DIR, OPCODE_TRANSPORT, 4, 0, 0,
+                                                    40, 0, 0x21, 'h'};
+  mesh_transport_process_msg(fragmento);
+
+  fragmento[MSG_TEST_MSG + 2] = 0x01;
+  mesh_transport_process_msg(fragmento);
+
+  fragmento[MSG_TEST_MSG + 2] = 0x00;
+  fragmento[MSG_TEST_MSG] = OPCODE_ROUTING_MAX;
+  mesh_transport_process_msg(fragmento);
+
+  TEST_ASSERT_EQUAL(0, mesh_transport_pending());
+}
+
+/* === End of documentation
+ * ==================================================================== */
@@ -0,0 +1,222 @@
+/************************************************************************************************
+Copyright (c) 2023, Leandro Diaz <diazleandro1012@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+SPDX-License-Identifier: MIT
+*************************************************************************************************/
+
+/** @file mesh_trace_decode.c
+ ** @brief Decodificador en la PC de los volcados del registro de trazas de la capa routing,
+ *         generados con mesh_routing_trace_dump(). Lee uno o más volcados, de los archivos
+ *         indicados o de la entrada estándar, y escribe una línea por evento ordenada por paso
+ *         del handler. Los volcados de varios nodos se intercalan en una sola línea de tiempo;
+ *         como cada nodo cuenta sus pasos desde su inicialización, entre nodos el orden es
+ *         aproximado. Se compila con `make tools`.
+ */
+
+/* === Headers files inclusions =============================================================== */
+#include "mesh.h"
+#include "mesh_routing.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+/* === Macros definitions ====================================================================== */
+
+#define DECODE_MAX_EVENTS 65536 // eventos que se pueden decodificar en total
+#define DECODE_MAGIC_0    'M'   // primer byte de un volcado
+#define DECODE_MAGIC_1    'T'   // segundo byte de un volcado
+#define DECODE_VERSION    1     // versión del formato de volcado que se entiende
+
+/* === Private data type declarations ========================================================== */
+
+/**
+ * @brief Evento decodificado de un volcado
+ *
+ */
+struct decode_event {
+  uint32_t time;  // paso del handler, con las vueltas del contador de 16 bits sumadas
+  uint32_t order; // posición de lectura, para mantener el orden de un nodo dentro de un paso
+  uint8_t node;
+  struct mesh_routing_trace_event event;
+};
+
+/* === Private variable declarations =========================================================== */
+
+/* === Private function declarations =========================================================== */
+
+/* === Public variable definitions ============================================================= */
+
+/* === Private variable definitions ============================================================ */
+
+static struct decode_event events[DECODE_MAX_EVENTS];
+
+static uint32_t event_count = 0;
+
+static const char * const type_names[MESH_ROUTING_TRACE_TYPE_COUNT] = {
+    [MESH_ROUTING_TRACE_ROUTE_ADD] = "route_add",
+    [MESH_ROUTING_TRACE_PATH_SWAP] = "path_swap",
+    [MESH_ROUTING_TRACE_ROUTE_EXPIRE] = "route_expire",
+    [MESH_ROUTING_TRACE_FORWARD] = "forward",
+    [MESH_ROUTING_TRACE_DROP_UNREACHABLE] = "drop_unreachable",
+    [MESH_ROUTING_TRACE_DROP_TTL] = "drop_ttl",
+    [MESH_ROUTING_TRACE_ADV_SENT] = "adv_sent",
+};
+
+/* === Private function implementation ========================================================= */
+
+/**
+ * @brief Lee los volcados de un archivo y agrega sus eventos. Los tiempos de cada volcado se
+ * desenvuelven suponiendo que entre dos eventos seguidos pasan menos de 65536 pasos.
+ *
+ * @param file archivo abierto
+ * @param name nombre del archivo, para los mensajes de error
+ * @return int 0 si se leyó completo, -1 si hay un volcado inválido
+ */
+static int decode_file(FILE * file, const char * name) {
+  uint8_t header[MESH_ROUTING_TRACE_HEADER_SIZE];
+  size_t read;
+
+  while ((read = fread(header, 1, sizeof(header), file)) > 0) {
+    if (read != sizeof(header) || header[0] != DECODE_MAGIC_0 || header[1] != DECODE_MAGIC_1) {
+      fprintf(stderr, "%s: no es un volcado de trazas\n", name);
+      return -1;
+    }
+    if (header[2] != DECODE_VERSION) {
+      fprintf(stderr, "%s: versión de volcado %u desconocida\n", name, header[2]);
+      return -1;
+    }
+
+    uint8_t node = header[3];
+    uint16_t count = (uint16_t)(header[4] << 8 | header[5]);
+    uint16_t lost = (uint16_t)(header[6] << 8 | header[7]);
+    uint32_t time = 0;
+    uint16_t previous = 0;
+
+    if (lost > 0) {
+      printf("# nodo %u: %u%s eventos anteriores perdidos\n", node, lost,
+             lost == UINT16_MAX ? " o más" : "");
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+      uint8_t data[MESH_ROUTING_TRACE_EVENT_SIZE];
+      if (fread(data, 1, sizeof(data), file) != sizeof(data)) {
+        fprintf(stderr, "%s: volcado del nodo %u truncado\n", name, node);
+        return -1;
+      }
+      if (event_count == DECODE_MAX_EVENTS) {
+        fprintf(stderr, "%s: demasiados eventos\n", name);
+        return -1;
+      }
+
+      struct decode_event * decoded = &events[event_count];
+      decoded->event.time = (uint16_t)(data[0] << 8 | data[1]);
+      decoded->event.type = data[2];
+      decoded->event.dst = data[3];
+      decoded->event.next_hop = data[4];
+      decoded->event.metric = data[5];
+      decoded->event.extra = data[6];
+      time = i == 0 ? decoded->event.time : time + (uint16_t)(decoded->event.time - previous);
+      previous = decoded->event.time;
+      decoded->time = time;
+      decoded->order = event_count;
+      decoded->node = node;
+      event_count++;
+    }
+  }
+  return 0;
+}
+
+static int decode_compare(const void * a, const void * b) {
+  const struct decode_event * first = a;
+  const struct decode_event * second = b;
+
+  if (first->time != second->time) {
+    return first->time < second->time ? -1 : 1;
+  }
+  return first->order < second->order ? -1 : 1;
+}
+
+/**
+ * @brief Escribe una línea de la línea de tiempo con los campos que usa cada tipo de evento
+ *
+ * @param decoded evento decodificado
+ */
+static void decode_print(const struct decode_event * decoded) {
+  const struct mesh_routing_trace_event * event = &decoded->event;
+
+  printf("%8u  nodo %3u  ", decoded->time, decoded->node);
+  if (event->type >= MESH_ROUTING_TRACE_TYPE_COUNT) {
+    printf("tipo %u desconocido\n", event->type);
+    return;
+  }
+  printf("%-16s  ", type_names[event->type]);
+
+  switch (event->type) {
+  case MESH_ROUTING_TRACE_ROUTE_ADD:
+  case MESH_ROUTING_TRACE_PATH_SWAP:
+    printf("dst %u next_hop %u metric %u seq %u\n", event->dst, event->next_hop, event->metric,
+           event->extra);
+    break;
+  case MESH_ROUTING_TRACE_ROUTE_EXPIRE:
+    printf("dst %u seq %u\n", event->dst, event->extra);
+    break;
+  case MESH_ROUTING_TRACE_FORWARD:
+    printf("src %u dst %u next_hop %u metric %u\n", event->extra, event->dst, event->next_hop,
+           event->metric);
+    break;
+  case MESH_ROUTING_TRACE_DROP_UNREACHABLE:
+  case MESH_ROUTING_TRACE_DROP_TTL:
+    printf("src %u dst %u\n", event->extra, event->dst);
+    break;
+  case MESH_ROUTING_TRACE_ADV_SENT:
+    printf("fragmento %u largo %u\n", event->extra, event->metric);
+    break;
+  default:
+    printf("\n");
+    break;
+  }
+}
+
+/* === Public function implementation ========================================================== */
+
+int main(int argc, char * argv[]) {
+  int result = 0;
+
+  if (argc < 2) {
+    result = decode_file(stdin, "stdin");
+  }
+  for (int i = 1; i < argc && result == 0; i++) {
+    FILE * file = fopen(argv[i], "rb");
+    if (file == NULL) {
+      fprintf(stderr, "%s: no se pudo abrir\n", argv[i]);
+      return 1;
+    }
+    result = decode_file(file, argv[i]);
+    fclose(file);
+  }
+
+  qsort(events, event_count, sizeof(events[0]), decode_compare);
+  for (uint32_t i = 0; i < event_count; i++) {
+    decode_print(&events[i]);
+  }
+  return result == 0 ? 0 : 1;
+}
+
+/* === End of documentation ==================================================================== */